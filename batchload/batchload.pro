@@ -0,0 +1,19 @@
+QT      *= core gui widgets network
+
+TEMPLATE = app
+TARGET   = nativebrowser_batchload
+DESTDIR  = $$PWD/../bin
+CONFIG  += C++11 console
+CONFIG  -= app_bundle
+
+include(../nativebrowser.pri)
+
+INCLUDEPATH += $$PWD/..
+
+SOURCES += main.cpp \
+    batchloader.cpp \
+    statichttpserver.cpp
+
+HEADERS += \
+    batchloader.h \
+    statichttpserver.h
@@ -0,0 +1,341 @@
+#include "batchloader.h"
+
+#include <QJsonArray>
+#include <QTimer>
+
+#include <algorithm>
+
+#if defined(Q_OS_WIN)
+#include <Windows.h>
+#include <Psapi.h>
+#elif defined(Q_OS_MAC)
+#include <mach/mach.h>
+#else
+#include <QFile>
+#endif
+
+#include "nativebrowsergovernor.h"
+#include "nativebrowserpool.h"
+
+namespace {
+
+// failures listed in the report at most, the counters cover all of them
+static const int MAX_REPORTED_FAILURES = 100;
+
+static const char *ResultName(NavigationReply::Result result)
+{
+    switch (result)
+    {
+    case NavigationReply::Succeeded: return "succeeded";
+    case NavigationReply::Failed: return "failed";
+    case NavigationReply::Cancelled: return "cancelled";
+    case NavigationReply::TimedOut: return "timed-out";
+    default: return "pending";
+    }
+}
+
+static QJsonObject Latency(QVector<qint64> samples)
+{
+    QJsonObject result;
+    result["count"] = samples.size();
+    if (samples.isEmpty())
+        return result;
+    std::sort(samples.begin(), samples.end());
+    double sum = 0;
+    for (int i = 0; i < samples.size(); ++i)
+        sum += samples.at(i);
+    result["min"] = double(samples.first());
+    result["mean"] = sum / samples.size();
+    for (int percent : { 50, 95, 99 })
+    {
+        int index = int((qint64(samples.size()) - 1) * percent / 100);
+        result[QString("p%1").arg(percent)] = double(samples.at(index));
+    }
+    result["max"] = double(samples.last());
+    return result;
+}
+
+} // anonymous
+
+BatchLoader::BatchLoader(QObject *parent)
+    : QObject(parent)
+    , parallel(4)
+    , reuse(ReuseBrowser)
+    , timeout(30000)
+    , browser_size(1024, 768)
+    , load_profile(NativeBrowser::Full)
+    , next_page(0)
+    , running(0)
+    , wall_time(0)
+    , succeeded(0)
+    , failed(0)
+    , timed_out(0)
+    , memory_before(0)
+{
+}
+
+BatchLoader::~BatchLoader()
+{
+    clearWorkers();
+}
+
+void BatchLoader::setUrls(const QStringList &urls)
+{
+    this->urls = urls;
+}
+
+void BatchLoader::setParallel(int count)
+{
+    parallel = qMax(1, count);
+}
+
+void BatchLoader::setReuse(Reuse reuse)
+{
+    this->reuse = reuse;
+}
+
+void BatchLoader::setTimeout(int msecs)
+{
+    timeout = qMax(0, msecs);
+}
+
+void BatchLoader::setBrowserSize(const QSize &size)
+{
+    browser_size = size;
+}
+
+void BatchLoader::setLoadProfile(NativeBrowser::LoadProfile profile)
+{
+    load_profile = profile;
+}
+
+void BatchLoader::start()
+{
+    if (isRunning())
+        return;
+    // a repeated run starts with fresh workers, not on top of the last ones
+    clearWorkers();
+    memory_before = NativeBrowserGovernor::processMemory();
+    if (reuse == ReusePool)
+    {
+        NativeBrowserPool::instance()->setMaximumSize(parallel);
+        NativeBrowserPool::instance()->setWarmCount(parallel);
+    }
+
+    next_page = 0;
+    latencies.clear();
+    latencies.reserve(urls.size());
+    succeeded = failed = timed_out = 0;
+    failures.clear();
+    clock.start();
+
+    int count = qMin(parallel, urls.size());
+    for (int i = 0; i < count; ++i)
+    {
+        Worker worker;
+        worker.browser = reuse == ReuseBrowser ? createBrowser() : 0;
+        worker.page = -1;
+        workers << worker;
+    }
+    if (count == 0)
+    {
+        QTimer::singleShot(0, this, SIGNAL(finished()));
+        return;
+    }
+    for (int i = 0; i < count; ++i)
+        startNext(i);
+}
+
+bool BatchLoader::isRunning() const
+{
+    return running > 0;
+}
+
+void BatchLoader::startNext(int index)
+{
+    Worker &worker = workers[index];
+    if (next_page == urls.size())
+    {
+        if (running == 0)
+        {
+            wall_time = clock.nsecsElapsed();
+            emit finished();
+        }
+        return;
+    }
+    worker.page = next_page++;
+    if (!worker.browser)
+        worker.browser = createBrowser();
+
+    NavigationOptions options;
+    options.timeout = timeout;
+    NavigationReply *reply = worker.browser->navigate(urls.at(worker.page), options);
+    ++running;
+    // queued, the browser may be deleted and it is the one emitting; the
+    // call is posted before the reply's own deletion
+    connect(reply, &NavigationReply::finished, this, [this, index, reply]() {
+        pageFinished(index, reply);
+    }, Qt::QueuedConnection);
+}
+
+void BatchLoader::pageFinished(int index, NavigationReply *reply)
+{
+    Worker &worker = workers[index];
+    --running;
+    NavigationTiming timing = reply->timing();
+    switch (reply->result())
+    {
+    case NavigationReply::Succeeded:
+        ++succeeded;
+        latencies.append(timing.finished - timing.load_called);
+        break;
+    case NavigationReply::TimedOut:
+        ++timed_out;
+        break;
+    default:
+        ++failed;
+        break;
+    }
+    if (reply->result() != NavigationReply::Succeeded && failures.size() < MAX_REPORTED_FAILURES)
+    {
+        QJsonObject failure;
+        failure["url"] = urls.at(worker.page);
+        failure["result"] = ResultName(reply->result());
+        if (reply->redirectedExternally())
+            failure["external_url"] = reply->externalUrl();
+        failures << failure;
+    }
+    worker.page = -1;
+
+    if (reuse != ReuseBrowser)
+    {
+        // the engine goes to the pool or away with it
+        delete worker.browser;
+        worker.browser = 0;
+    }
+    startNext(index);
+}
+
+void BatchLoader::clearWorkers()
+{
+    for (const Worker &worker : workers)
+        delete worker.browser;
+    workers.clear();
+}
+
+NativeBrowser *BatchLoader::createBrowser()
+{
+    NativeBrowser *browser = new NativeBrowser();
+    browser->resize(browser_size);
+    browser->setLoadProfile(load_profile);
+    return browser;
+}
+
+QJsonObject BatchLoader::report() const
+{
+    QJsonObject result;
+    result["pages"] = urls.size();
+    result["parallel"] = parallel;
+    result["reuse"] = reuseName(reuse);
+    result["profile"] = profileName(load_profile);
+    result["timeout_ms"] = timeout;
+    result["succeeded"] = succeeded;
+    result["failed"] = failed;
+    result["timed_out"] = timed_out;
+    result["wall_time_ns"] = double(wall_time);
+    result["pages_per_second"] = wall_time > 0 ? (succeeded + failed + timed_out) * 1e9 / wall_time : 0.0;
+    result["load_latency_ns"] = Latency(latencies);
+    result["memory_before_bytes"] = double(memory_before);
+    result["peak_memory_bytes"] = double(peakProcessMemory());
+    if (reuse == ReusePool)
+    {
+        result["pool_hits"] = double(NativeBrowserPool::instance()->hits());
+        result["pool_misses"] = double(NativeBrowserPool::instance()->misses());
+    }
+    QJsonArray failure_list;
+    for (const QJsonObject &failure : failures)
+        failure_list.append(failure);
+    result["failures"] = failure_list;
+    return result;
+}
+
+BatchLoader::Reuse BatchLoader::reuseFromName(const QString &name, bool *ok)
+{
+    if (ok)
+        *ok = true;
+    if (name == "browser")
+        return ReuseBrowser;
+    if (name == "pool")
+        return ReusePool;
+    if (name == "none")
+        return ReuseNone;
+    if (ok)
+        *ok = false;
+    return ReuseBrowser;
+}
+
+QString BatchLoader::reuseName(Reuse reuse)
+{
+    switch (reuse)
+    {
+    case ReusePool: return "pool";
+    case ReuseNone: return "none";
+    default: return "browser";
+    }
+}
+
+NativeBrowser::LoadProfile BatchLoader::profileFromName(const QString &name, bool *ok)
+{
+    if (ok)
+        *ok = true;
+    if (name == "full")
+        return NativeBrowser::Full;
+    if (name == "no-images")
+        return NativeBrowser::NoImages;
+    if (name == "no-script")
+        return NativeBrowser::NoScript;
+    if (name == "static-snapshot")
+        return NativeBrowser::StaticSnapshot;
+    if (ok)
+        *ok = false;
+    return NativeBrowser::Full;
+}
+
+QString BatchLoader::profileName(NativeBrowser::LoadProfile profile)
+{
+    switch (profile)
+    {
+    case NativeBrowser::NoImages: return "no-images";
+    case NativeBrowser::NoScript: return "no-script";
+    case NativeBrowser::StaticSnapshot: return "static-snapshot";
+    default: return "full";
+    }
+}
+
+qint64 BatchLoader::peakProcessMemory()
+{
+#if defined(Q_OS_WIN)
+    PROCESS_MEMORY_COUNTERS counters;
+    if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+        return 0;
+    return qint64(counters.PeakWorkingSetSize);
+#elif defined(Q_OS_MAC)
+    mach_task_basic_info_data_t info;
+    mach_msg_type_number_t count = MACH_TASK_BASIC_INFO_COUNT;
+    if (task_info(mach_task_self(), MACH_TASK_BASIC_INFO, reinterpret_cast<task_info_t>(&info), &count) != KERN_SUCCESS)
+        return 0;
+    return qint64(info.resident_size_max);
+#else
+    // VmHWM: peak resident set size, in kB
+    QFile status("/proc/self/status");
+    if (!status.open(QIODevice::ReadOnly | QIODevice::Text))
+        return 0;
+    while (!status.atEnd())
+    {
+        QByteArray line = status.readLine();
+        if (line.startsWith("VmHWM:"))
+            return line.mid(6).trimmed().split(' ').first().toLongLong() * 1024;
+    }
+    return 0;
+#endif
+}
@@ -0,0 +1,92 @@
+#ifndef BATCHLOADER_H
+#define BATCHLOADER_H
+
+#include <QElapsedTimer>
+#include <QJsonObject>
+#include <QList>
+#include <QObject>
+#include <QSize>
+#include <QStringList>
+#include <QVector>
+
+#include "nativebrowser.h"
+#include "navigationreply.h"
+
+// Loads a list of URLs through a number of NativeBrowser instances running
+// side by side and collects what a pre-flight check needs: throughput, load
+// latency, failures and the process's peak memory.
+class BatchLoader : public QObject
+{
+    Q_OBJECT
+    Q_DISABLE_COPY(BatchLoader)
+public:
+    enum Reuse
+    {
+        ReuseBrowser, // every worker loads its pages into one browser
+        ReusePool,    // a new browser per page, engines from NativeBrowserPool
+        ReuseNone     // a new browser and a new engine per page
+    };
+
+    explicit BatchLoader(QObject *parent = 0);
+    virtual ~BatchLoader();
+
+    void setUrls(const QStringList &urls);
+    void setParallel(int count);
+    void setReuse(Reuse reuse);
+    // per page, pages taking longer count as failed
+    void setTimeout(int msecs);
+    void setBrowserSize(const QSize &size);
+    void setLoadProfile(NativeBrowser::LoadProfile profile);
+
+    // starts loading, finished() follows once every page was tried
+    void start();
+    bool isRunning() const;
+
+    QJsonObject report() const;
+
+    static Reuse reuseFromName(const QString &name, bool *ok = 0);
+    static QString reuseName(Reuse reuse);
+    static NativeBrowser::LoadProfile profileFromName(const QString &name, bool *ok = 0);
+    static QString profileName(NativeBrowser::LoadProfile profile);
+
+    // highest working set / resident size of the process so far, in bytes
+    static qint64 peakProcessMemory();
+
+signals:
+    void finished();
+
+private:
+    struct Worker
+    {
+        NativeBrowser *browser;
+        int page; // index into urls, -1 while idle
+    };
+
+    void startNext(int worker);
+    void pageFinished(int worker, NavigationReply *reply);
+    NativeBrowser *createBrowser();
+    // deletes the browsers of the last run
+    void clearWorkers();
+
+    QStringList urls;
+    int parallel;
+    Reuse reuse;
+    int timeout;
+    QSize browser_size;
+    NativeBrowser::LoadProfile load_profile;
+
+    QList<Worker> workers;
+    int next_page;
+    int running;
+    QElapsedTimer clock;
+    qint64 wall_time;
+
+    QVector<qint64> latencies;
+    int succeeded;
+    int failed;
+    int timed_out;
+    QList<QJsonObject> failures;
+    qint64 memory_before;
+};
+
+#endif // BATCHLOADER_H
@@ -0,0 +1,147 @@
+#include <QApplication>
+#include <QCommandLineParser>
+#include <QFile>
+#include <QJsonDocument>
+#include <QStringList>
+#include <QSysInfo>
+#include <QTextStream>
+#include <QUrl>
+
+#include "batchloader.h"
+#include "statichttpserver.h"
+
+namespace {
+
+// one URL per line, blank lines and # comments skipped; with a server,
+// relative ones are resolved against it
+static bool ReadUrls(const QString &path, const QUrl &base, QStringList &urls)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly | QIODevice::Text))
+        return false;
+    QTextStream stream(&file);
+    while (!stream.atEnd())
+    {
+        QString line = stream.readLine().trimmed();
+        if (line.isEmpty() || line.startsWith('#'))
+            continue;
+        QUrl url(line);
+        if (url.isRelative() && base.isValid())
+            urls << base.resolved(url).toString();
+        else
+            urls << line;
+    }
+    return true;
+}
+
+} // anonymous
+
+int main(int argc, char* argv[])
+{
+#if defined(Q_OS_UNIX) && !defined(Q_OS_MAC)
+    // pre-flight checks run on machines without a display
+    if (qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM"))
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+#endif
+    QApplication app(argc, argv);
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Loads a list of URLs through parallel NativeBrowser instances and reports throughput, latency, failures and peak memory as JSON.");
+    parser.addHelpOption();
+    parser.addPositionalArgument("urls", "File with one URL per line.", "urls");
+    QCommandLineOption parallel_option(QStringList() << "j" << "parallel", "Browsers loading at once (default: 4).", "count", "4");
+    QCommandLineOption reuse_option("reuse", "browser: one browser per worker, pool: a new browser per page with pooled engines, none: a new browser and engine per page (default: browser).", "mode", "browser");
+    QCommandLineOption profile_option("profile", "Load profile: full, no-images, no-script or static-snapshot (default: full).", "profile", "full");
+    QCommandLineOption repeat_option("repeat", "Passes over the list (default: 1).", "count", "1");
+    QCommandLineOption timeout_option("timeout", "Per page in ms, slower pages count as timed out (default: 30000).", "ms", "30000");
+    QCommandLineOption serve_option("serve", "Serve <dir> on a loopback port and resolve relative URLs against it.", "dir");
+    QCommandLineOption port_option("port", "Port for --serve (default: any free one).", "port", "0");
+    QCommandLineOption output_option(QStringList() << "o" << "output", "Write the report to <file> instead of stdout.", "file");
+    parser.addOption(parallel_option);
+    parser.addOption(reuse_option);
+    parser.addOption(profile_option);
+    parser.addOption(repeat_option);
+    parser.addOption(timeout_option);
+    parser.addOption(serve_option);
+    parser.addOption(port_option);
+    parser.addOption(output_option);
+    parser.process(app);
+
+    if (parser.positionalArguments().size() != 1)
+        parser.showHelp(1);
+
+    bool reuse_ok = false;
+    BatchLoader::Reuse reuse = BatchLoader::reuseFromName(parser.value(reuse_option), &reuse_ok);
+    if (!reuse_ok)
+    {
+        QTextStream(stderr) << "unknown reuse mode: " << parser.value(reuse_option) << endl;
+        return 1;
+    }
+
+    bool profile_ok = false;
+    NativeBrowser::LoadProfile profile = BatchLoader::profileFromName(parser.value(profile_option), &profile_ok);
+    if (!profile_ok)
+    {
+        QTextStream(stderr) << "unknown load profile: " << parser.value(profile_option) << endl;
+        return 1;
+    }
+
+    StaticHttpServer *server = 0;
+    QUrl base;
+    if (parser.isSet(serve_option))
+    {
+        server = new StaticHttpServer(parser.value(serve_option), &app);
+        if (!server->start(quint16(parser.value(port_option).toUInt())))
+        {
+            QTextStream(stderr) << "cannot listen: " << server->errorString() << endl;
+            return 1;
+        }
+        base = server->baseUrl();
+    }
+
+    QStringList list;
+    if (!ReadUrls(parser.positionalArguments().first(), base, list))
+    {
+        QTextStream(stderr) << "cannot read " << parser.positionalArguments().first() << endl;
+        return 1;
+    }
+    QStringList urls;
+    for (int pass = qMax(1, parser.value(repeat_option).toInt()); pass > 0; --pass)
+        urls << list;
+
+    BatchLoader loader;
+    loader.setUrls(urls);
+    loader.setParallel(parser.value(parallel_option).toInt());
+    loader.setReuse(reuse);
+    loader.setLoadProfile(profile);
+    loader.setTimeout(parser.value(timeout_option).toInt());
+    QObject::connect(&loader, &BatchLoader::finished, &app, &QCoreApplication::quit, Qt::QueuedConnection);
+    loader.start();
+    app.exec();
+
+    QJsonObject report = loader.report();
+    report["qt_version"] = qVersion();
+    report["platform"] = QSysInfo::prettyProductName();
+    if (server)
+        report["served_requests"] = double(server->servedRequests());
+    QByteArray json = QJsonDocument(report).toJson();
+
+    if (parser.isSet(output_option))
+    {
+        QFile file(parser.value(output_option));
+        if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+        {
+            QTextStream(stderr) << "cannot write " << file.fileName() << endl;
+            return 1;
+        }
+        file.write(json);
+    }
+    else
+    {
+        QFile out;
+        out.open(stdout, QIODevice::WriteOnly);
+        out.write(json);
+    }
+    // pages that did not load are what a pre-flight check is for
+    return report["succeeded"].toInt() == urls.size() ? 0 : 2;
+}
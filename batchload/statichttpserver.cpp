@@ -0,0 +1,122 @@
+#include "statichttpserver.h"
+
+#include <QFile>
+#include <QFileInfo>
+#include <QHostAddress>
+#include <QTcpSocket>
+
+namespace {
+
+// a request line and headers larger than this are not a browser's
+static const int MAX_REQUEST_SIZE = 64 * 1024;
+
+} // anonymous
+
+StaticHttpServer::StaticHttpServer(const QString &root, QObject *parent)
+    : QTcpServer(parent)
+    , root(root)
+    , served_requests(0)
+{
+    connect(this, SIGNAL(newConnection()), this, SLOT(acceptConnections()));
+}
+
+bool StaticHttpServer::start(quint16 port)
+{
+    return listen(QHostAddress::LocalHost, port);
+}
+
+QUrl StaticHttpServer::baseUrl() const
+{
+    return QUrl(QString("http://127.0.0.1:%1/").arg(serverPort()));
+}
+
+quint64 StaticHttpServer::servedRequests() const
+{
+    return served_requests;
+}
+
+void StaticHttpServer::acceptConnections()
+{
+    while (hasPendingConnections())
+    {
+        QTcpSocket *socket = nextPendingConnection();
+        connect(socket, SIGNAL(readyRead()), this, SLOT(readRequest()));
+        connect(socket, SIGNAL(disconnected()), socket, SLOT(deleteLater()));
+    }
+}
+
+void StaticHttpServer::readRequest()
+{
+    QTcpSocket *socket = qobject_cast<QTcpSocket *>(sender());
+    if (!socket || socket->property("answered").toBool())
+        return;
+    QByteArray head = socket->peek(MAX_REQUEST_SIZE);
+    if (!head.contains("\r\n\r\n"))
+    {
+        if (head.size() >= MAX_REQUEST_SIZE)
+            reply(socket, 400, "Bad Request", "text/plain", "request too large\n");
+        return;
+    }
+    socket->setProperty("answered", true);
+
+    QList<QByteArray> request_line = head.left(head.indexOf("\r\n")).split(' ');
+    if (request_line.size() < 2 || (request_line.at(0) != "GET" && request_line.at(0) != "HEAD"))
+    {
+        reply(socket, 405, "Method Not Allowed", "text/plain", "only GET is served\n");
+        return;
+    }
+
+    QString path = QUrl::fromPercentEncoding(request_line.at(1).split('?').first());
+    if (path.endsWith('/'))
+        path += "index.html";
+    // clean and still below the root, nothing outside it is served
+    QString file_path = QDir::cleanPath(root.absoluteFilePath(path.mid(1)));
+    if (!file_path.startsWith(root.absolutePath() + '/'))
+    {
+        reply(socket, 403, "Forbidden", "text/plain", "outside the served directory\n");
+        return;
+    }
+    QFile file(file_path);
+    if (!QFileInfo(file_path).isFile() || !file.open(QIODevice::ReadOnly))
+    {
+        reply(socket, 404, "Not Found", "text/plain", "not found\n");
+        return;
+    }
+    ++served_requests;
+    reply(socket, 200, "OK", contentType(file_path), request_line.at(0) == "HEAD" ? QByteArray() : file.readAll());
+}
+
+void StaticHttpServer::reply(QTcpSocket *socket, int status, const QByteArray &reason, const QByteArray &type, const QByteArray &body)
+{
+    QByteArray head = "HTTP/1.0 " + QByteArray::number(status) + ' ' + reason + "\r\n"
+            + "Content-Type: " + type + "\r\n"
+            + "Content-Length: " + QByteArray::number(body.size()) + "\r\n"
+            + "Connection: close\r\n\r\n";
+    socket->write(head);
+    socket->write(body);
+    socket->disconnectFromHost();
+}
+
+QByteArray StaticHttpServer::contentType(const QString &path)
+{
+    QString suffix = QFileInfo(path).suffix().toLower();
+    if (suffix == "html" || suffix == "htm")
+        return "text/html; charset=utf-8";
+    if (suffix == "css")
+        return "text/css";
+    if (suffix == "js")
+        return "application/javascript";
+    if (suffix == "json")
+        return "application/json";
+    if (suffix == "png")
+        return "image/png";
+    if (suffix == "jpg" || suffix == "jpeg")
+        return "image/jpeg";
+    if (suffix == "gif")
+        return "image/gif";
+    if (suffix == "svg")
+        return "image/svg+xml";
+    if (suffix == "txt")
+        return "text/plain; charset=utf-8";
+    return "application/octet-stream";
+}
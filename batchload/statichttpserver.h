@@ -0,0 +1,39 @@
+#ifndef STATICHTTPSERVER_H
+#define STATICHTTPSERVER_H
+
+#include <QDir>
+#include <QTcpServer>
+#include <QUrl>
+
+class QTcpSocket;
+
+// Serves the files below a directory over HTTP/1.0 on the loopback
+// interface, GET only, one request per connection. A stand-in for the real
+// servers so that batch runs measure the browser and not the network.
+class StaticHttpServer : public QTcpServer
+{
+    Q_OBJECT
+    Q_DISABLE_COPY(StaticHttpServer)
+public:
+    explicit StaticHttpServer(const QString &root, QObject *parent = 0);
+
+    // port 0 picks a free one
+    bool start(quint16 port = 0);
+    // http://127.0.0.1:<port>/
+    QUrl baseUrl() const;
+
+    quint64 servedRequests() const;
+
+private slots:
+    void acceptConnections();
+    void readRequest();
+
+private:
+    void reply(QTcpSocket *socket, int status, const QByteArray &reason, const QByteArray &type, const QByteArray &body);
+    static QByteArray contentType(const QString &path);
+
+    QDir root;
+    quint64 served_requests;
+};
+
+#endif // STATICHTTPSERVER_H
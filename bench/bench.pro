@@ -0,0 +1,35 @@
+QT      *= core gui widgets
+
+TEMPLATE = app
+TARGET   = nativebrowser_bench
+DESTDIR  = $$PWD/../bin
+CONFIG  += C++11 console
+CONFIG  -= app_bundle
+
+include(../nativebrowser.pri)
+
+INCLUDEPATH += $$PWD/..
+
+SOURCES += main.cpp \
+    benchutil.cpp \
+    blocklistbench.cpp \
+    eventlogbench.cpp \
+    navigationbench.cpp \
+    policybench.cpp \
+    replaybench.cpp \
+    resizebench.cpp \
+    schedulerbench.cpp \
+    scriptednativebrowserimpl.cpp \
+    sethtmlbench.cpp
+
+HEADERS += \
+    benchutil.h \
+    blocklistbench.h \
+    eventlogbench.h \
+    navigationbench.h \
+    policybench.h \
+    replaybench.h \
+    resizebench.h \
+    schedulerbench.h \
+    scriptednativebrowserimpl.h \
+    sethtmlbench.h
@@ -0,0 +1,111 @@
+#include "benchutil.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+namespace {
+
+static std::atomic<unsigned long long> allocations(0);
+
+static qint64 percentile(const QVector<qint64> &sorted, int percent)
+{
+    int index = int((qint64(sorted.size()) - 1) * percent / 100);
+    return sorted.at(index);
+}
+
+} // anonymous
+
+#if defined(__GLIBC__)
+
+// Qt containers allocate with malloc() directly, so on glibc the allocator
+// itself is interposed to count every allocation, not only operator new.
+extern "C" {
+void *__libc_malloc(size_t size);
+void *__libc_calloc(size_t count, size_t size);
+void *__libc_realloc(void *ptr, size_t size);
+
+void *malloc(size_t size)
+{
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    return __libc_malloc(size);
+}
+
+void *calloc(size_t count, size_t size)
+{
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    return __libc_calloc(count, size);
+}
+
+void *realloc(void *ptr, size_t size)
+{
+    if (!ptr)
+        allocations.fetch_add(1, std::memory_order_relaxed);
+    return __libc_realloc(ptr, size);
+}
+}
+
+const char *allocationCounterKind()
+{
+    return "malloc";
+}
+
+#else
+
+void *operator new(std::size_t size)
+{
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    void *result = std::malloc(size ? size : 1);
+    if (!result)
+        throw std::bad_alloc();
+    return result;
+}
+
+void *operator new[](std::size_t size)
+{
+    return operator new(size);
+}
+
+void operator delete(void *ptr) noexcept
+{
+    std::free(ptr);
+}
+
+void operator delete[](void *ptr) noexcept
+{
+    std::free(ptr);
+}
+
+const char *allocationCounterKind()
+{
+    return "operator new";
+}
+
+#endif
+
+quint64 allocationCount()
+{
+    return allocations.load(std::memory_order_relaxed);
+}
+
+QJsonObject summarize(QVector<qint64> samples)
+{
+    QJsonObject result;
+    result["count"] = samples.size();
+    if (samples.isEmpty())
+        return result;
+
+    std::sort(samples.begin(), samples.end());
+    double sum = 0;
+    for (int i = 0; i < samples.size(); ++i)
+        sum += samples.at(i);
+
+    result["min"] = double(samples.first());
+    result["mean"] = sum / samples.size();
+    result["p50"] = double(percentile(samples, 50));
+    result["p95"] = double(percentile(samples, 95));
+    result["p99"] = double(percentile(samples, 99));
+    result["max"] = double(samples.last());
+    return result;
+}
@@ -0,0 +1,28 @@
+#ifndef BENCHUTIL_H
+#define BENCHUTIL_H
+
+#include <QJsonObject>
+#include <QString>
+#include <QVector>
+
+struct BenchOptions
+{
+    BenchOptions()
+        : iterations(0)
+        , progress_steps(0)
+    {}
+
+    int iterations;     // 0 means the suite default
+    int progress_steps;
+    QString trace_file; // engine trace to replay instead of a synthetic one
+};
+
+// min/mean/p50/p95/p99/max of the samples, in the samples' unit
+QJsonObject summarize(QVector<qint64> samples);
+
+// number of heap allocations made by the process so far
+quint64 allocationCount();
+// what allocationCount() counts: "malloc" or "operator new"
+const char *allocationCounterKind();
+
+#endif // BENCHUTIL_H
@@ -0,0 +1,134 @@
+#include "blocklistbench.h"
+
+#include <QElapsedTimer>
+#include <QStringList>
+#include <QTemporaryFile>
+
+#include "navigationpolicy.h"
+#include "requestblocklist.h"
+
+namespace {
+
+static const int RULE_COUNT = 100000;
+static const int URL_COUNT = 8192;
+
+static QStringList Rules()
+{
+    // 90% hosts in the usual syntaxes, 10% paths
+    QStringList rules;
+    rules.reserve(RULE_COUNT + 1);
+    rules << "# generated by the blocklist bench";
+    for (int i = 0; i < RULE_COUNT; ++i)
+    {
+        switch (i % 10)
+        {
+        case 0:
+            rules << QString("cdn%1.media%2.com/ads/").arg(i).arg(i % 500);
+            break;
+        case 1:
+            rules << QString("||tracker%1.net^").arg(i);
+            break;
+        case 2:
+            rules << QString("0.0.0.0 telemetry%1.io").arg(i);
+            break;
+        default:
+            rules << QString("ads%1.adnetwork%2.com").arg(i).arg(i % 1000);
+            break;
+        }
+    }
+    return rules;
+}
+
+static QStringList Urls(int &expected_blocked)
+{
+    // a page's subresources: mostly the dashboard's own, then blocked ones
+    QStringList urls;
+    expected_blocked = 0;
+    for (int i = 0; i < URL_COUNT; ++i)
+    {
+        int rule = (i * 7919) % RULE_COUNT;
+        switch (i % 8)
+        {
+        case 0:
+            urls << QString("https://x.ads%1.adnetwork%2.com/banner.js").arg(rule - rule % 10 + 3).arg((rule - rule % 10 + 3) % 1000);
+            ++expected_blocked;
+            break;
+        case 1:
+            urls << QString("https://cdn%1.media%2.com/ads/slot?id=%3").arg(rule - rule % 10).arg((rule - rule % 10) % 500).arg(i);
+            ++expected_blocked;
+            break;
+        case 2:
+            urls << QString("https://cdn%1.media%2.com/img/logo.png").arg(rule - rule % 10).arg((rule - rule % 10) % 500);
+            break;
+        default:
+            urls << QString("https://static.dashboard.local/asset/%1.css").arg(i);
+            break;
+        }
+    }
+    return urls;
+}
+
+} // anonymous
+
+QJsonObject runBlocklistBench(const BenchOptions &options)
+{
+    int lookups = options.iterations > 0 ? options.iterations : 2000000;
+    QJsonObject result;
+    result["suite"] = "blocklist";
+
+    QElapsedTimer clock;
+    QTemporaryFile file;
+    if (!file.open())
+    {
+        result["error"] = "cannot create a temporary file";
+        return result;
+    }
+    QStringList rules = Rules();
+    clock.start();
+    int rule_count = RequestBlocklist::compile(rules, &file);
+    qint64 compile_ns = clock.nsecsElapsed();
+    file.close();
+
+    RequestBlocklist blocklist;
+    clock.restart();
+    bool opened = blocklist.open(file.fileName());
+    qint64 open_ns = clock.nsecsElapsed();
+    if (rule_count < 0 || !opened)
+    {
+        result["error"] = "cannot compile or map the blocklist";
+        return result;
+    }
+
+    int expected_blocked = 0;
+    QStringList urls = Urls(expected_blocked);
+    int blocked = 0;
+    for (const QString &url : urls)
+        blocked += blocklist.isBlocked(url) ? 1 : 0;
+
+    int blocked_lookups = 0;
+    quint64 allocations_before = allocationCount();
+    clock.restart();
+    for (int i = 0; i < lookups; ++i)
+        blocked_lookups += blocklist.isBlocked(urls.at(i % URL_COUNT)) ? 1 : 0;
+    qint64 lookup_ns = clock.nsecsElapsed();
+    quint64 allocations = allocationCount() - allocations_before;
+
+    int prefiltered = 0;
+    for (const QString &url : urls)
+        prefiltered += blocklist.mayBlockHost(NavigationPolicy::hostOf(url)) ? 0 : 1;
+
+    result["rules"] = rule_count;
+    result["file_bytes"] = double(file.size());
+    result["compile_ns"] = double(compile_ns);
+    result["open_ns"] = double(open_ns);
+    result["lookups"] = lookups;
+    result["lookups_per_second"] = lookup_ns ? double(lookups) * 1e9 / lookup_ns : 0.0;
+    result["ns_per_lookup"] = double(lookup_ns) / lookups;
+    result["allocations_per_lookup"] = double(allocations) / lookups;
+    result["blocked_fraction"] = double(blocked_lookups) / lookups;
+    result["blocked_urls"] = blocked;
+    result["expected_blocked_urls"] = expected_blocked;
+    result["bloom_rejected_urls"] = prefiltered;
+    result["allocation_counter"] = allocationCounterKind();
+    return result;
+}
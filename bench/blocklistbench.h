@@ -0,0 +1,12 @@
+#ifndef BLOCKLISTBENCH_H
+#define BLOCKLISTBENCH_H
+
+#include <QJsonObject>
+
+#include "benchutil.h"
+
+// Compiles a 100k rule request blocklist, maps it and measures lookups per
+// second for a mix of blocked and clean subresource URLs.
+QJsonObject runBlocklistBench(const BenchOptions &options);
+
+#endif // BLOCKLISTBENCH_H
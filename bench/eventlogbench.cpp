@@ -0,0 +1,89 @@
+#include "eventlogbench.h"
+
+#include <QElapsedTimer>
+#include <QStringList>
+
+#include <thread>
+#include <vector>
+
+#include "eventlog.h"
+
+namespace {
+
+static const int BATCH_SIZE = 1000;
+static const int THREAD_COUNT = 4;
+
+// ns per event of each batch of BATCH_SIZE records
+static QVector<qint64> RecordBatches(int events, quint64 instance)
+{
+    QVector<qint64> samples;
+    samples.reserve(events / BATCH_SIZE);
+    QElapsedTimer clock;
+    for (int done = 0; done + BATCH_SIZE <= events; done += BATCH_SIZE)
+    {
+        clock.start();
+        for (int i = 0; i < BATCH_SIZE; ++i)
+            EventLog::record(EventLog::NavigationStarted, instance, i);
+        samples.append(clock.nsecsElapsed() / BATCH_SIZE);
+    }
+    return samples;
+}
+
+} // anonymous
+
+QJsonObject runEventLogBench(const BenchOptions &options)
+{
+    int events = options.iterations > 0 ? options.iterations : 1000000;
+    events = qMax(events, BATCH_SIZE);
+
+    // warm the slots and the clock
+    RecordBatches(EventLog::Capacity, 1);
+
+    QVector<qint64> single = RecordBatches(events, 1);
+
+    // a typical URL, hashed on every record like the navigation hooks do
+    QStringList urls;
+    for (int i = 0; i < 64; ++i)
+        urls << QString("https://dashboard.example.com/panel/%1?view=summary&range=24h").arg(i);
+    QVector<qint64> hashed;
+    hashed.reserve(events / BATCH_SIZE);
+    QElapsedTimer clock;
+    for (int done = 0; done + BATCH_SIZE <= events; done += BATCH_SIZE)
+    {
+        clock.start();
+        for (int i = 0; i < BATCH_SIZE; ++i)
+            EventLog::record(EventLog::NavigationRequested, 1, urls.at(i & 63));
+        hashed.append(clock.nsecsElapsed() / BATCH_SIZE);
+    }
+
+    // writers on other threads contend for the sequence counter only
+    std::vector<QVector<qint64> > per_thread(THREAD_COUNT);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < THREAD_COUNT; ++t)
+    {
+        threads.emplace_back([&per_thread, t, events]() {
+            per_thread[t] = RecordBatches(events / THREAD_COUNT, quint64(t + 2));
+        });
+    }
+    for (std::thread &thread : threads)
+        thread.join();
+    QVector<qint64> contended;
+    for (const QVector<qint64> &samples : per_thread)
+        contended += samples;
+
+    clock.start();
+    QByteArray dump = EventLog::dump();
+    qint64 dump_ns = clock.nsecsElapsed();
+
+    QJsonObject result;
+    result["suite"] = "event-log";
+    result["events"] = events;
+    result["capacity"] = EventLog::Capacity;
+    result["record_ns"] = summarize(single);
+    result["record_with_url_ns"] = summarize(hashed);
+    result["threads"] = THREAD_COUNT;
+    result["record_contended_ns"] = summarize(contended);
+    result["dump_ns"] = double(dump_ns);
+    result["dump_bytes"] = dump.size();
+    return result;
+}
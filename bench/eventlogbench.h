@@ -0,0 +1,13 @@
+#ifndef EVENTLOGBENCH_H
+#define EVENTLOGBENCH_H
+
+#include <QJsonObject>
+
+#include "benchutil.h"
+
+// Records events into the EventLog from one thread and from four at once,
+// with and without a URL hash, and reports the cost per event; the log is
+// meant to stay on in production, so this should stay in the nanoseconds.
+QJsonObject runEventLogBench(const BenchOptions &options);
+
+#endif // EVENTLOGBENCH_H
@@ -0,0 +1,115 @@
+#include <QApplication>
+#include <QCommandLineParser>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QStringList>
+#include <QSysInfo>
+#include <QTextStream>
+
+#include "benchutil.h"
+#include "blocklistbench.h"
+#include "eventlogbench.h"
+#include "navigationbench.h"
+#include "policybench.h"
+#include "replaybench.h"
+#include "resizebench.h"
+#include "schedulerbench.h"
+#include "sethtmlbench.h"
+
+namespace {
+
+typedef QJsonObject (*BenchSuite)(const BenchOptions &options);
+
+struct BenchSuiteEntry
+{
+    const char *name;
+    BenchSuite run;
+};
+
+static const BenchSuiteEntry suites[] = {
+    { "navigation", &runNavigationBench },
+    { "platform-navigation", &runPlatformNavigationBench },
+    { "replay", &runReplayBench },
+    { "navigation-policy", &runPolicyBench },
+    { "blocklist", &runBlocklistBench },
+    { "set-html", &runSetHtmlBench },
+    { "load-scheduler", &runSchedulerBench },
+    { "resize", &runResizeBench },
+    { "event-log", &runEventLogBench },
+};
+
+} // anonymous
+
+int main(int argc, char* argv[])
+{
+#if defined(Q_OS_UNIX) && !defined(Q_OS_MAC)
+    // the bench runs on build machines without a display
+    if (qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM"))
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+#endif
+    QApplication app(argc, argv);
+
+    QStringList suite_names;
+    for (const BenchSuiteEntry &suite : suites)
+        suite_names << suite.name;
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("NativeBrowser benchmarks, results are written as JSON.");
+    parser.addHelpOption();
+    parser.addPositionalArgument("suites", "Suites to run: " + suite_names.join(", ") + " (default: all).", "[suites...]");
+    QCommandLineOption iterations_option(QStringList() << "n" << "iterations", "Iterations per suite.", "count");
+    QCommandLineOption progress_option("progress-steps", "Progress events per scripted navigation.", "count");
+    QCommandLineOption trace_option("trace", "Engine trace for the replay suite (default: synthetic).", "file");
+    QCommandLineOption output_option(QStringList() << "o" << "output", "Write the results to <file> instead of stdout.", "file");
+    parser.addOption(iterations_option);
+    parser.addOption(progress_option);
+    parser.addOption(trace_option);
+    parser.addOption(output_option);
+    parser.process(app);
+
+    BenchOptions options;
+    options.iterations = parser.value(iterations_option).toInt();
+    options.progress_steps = parser.value(progress_option).toInt();
+    options.trace_file = parser.value(trace_option);
+
+    QStringList selected = parser.positionalArguments();
+    if (selected.isEmpty())
+        selected = suite_names;
+
+    QJsonArray results;
+    for (const QString &name : selected)
+    {
+        int index = suite_names.indexOf(name);
+        if (index < 0)
+        {
+            QTextStream(stderr) << "unknown suite: " << name << endl;
+            return 1;
+        }
+        results.append(suites[index].run(options));
+    }
+
+    QJsonObject report;
+    report["qt_version"] = qVersion();
+    report["platform"] = QSysInfo::prettyProductName();
+    report["results"] = results;
+    QByteArray json = QJsonDocument(report).toJson();
+
+    if (parser.isSet(output_option))
+    {
+        QFile file(parser.value(output_option));
+        if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+        {
+            QTextStream(stderr) << "cannot write " << file.fileName() << endl;
+            return 1;
+        }
+        file.write(json);
+    }
+    else
+    {
+        QFile out;
+        out.open(stdout, QIODevice::WriteOnly);
+        out.write(json);
+    }
+    return 0;
+}
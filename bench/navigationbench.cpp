@@ -0,0 +1,132 @@
+#include "navigationbench.h"
+
+#include <QMetaObject>
+
+#include "nativebrowser.h"
+#include "nativebrowserimpl.h"
+#include "scriptednativebrowserimpl.h"
+
+NavigationBench::NavigationBench(Backend backend, QObject *parent)
+    : QObject(parent)
+    , backend(backend)
+    , browser(0)
+    , navigate_time(0)
+    , navigations(0)
+    , current(0)
+    , failures(0)
+    , progress_signals(0)
+{
+}
+
+QJsonObject NavigationBench::run(const BenchOptions &options)
+{
+    navigations = options.iterations > 0 ? options.iterations : 5000;
+    current = 0;
+    failures = 0;
+    progress_signals = 0;
+    to_started.clear();
+    to_finished.clear();
+    to_started.reserve(navigations);
+    to_finished.reserve(navigations);
+
+    if (backend == ScriptedBackend)
+    {
+        ScriptedNativeBrowserImpl::setProgressSteps(options.progress_steps > 0 ? options.progress_steps : 10);
+        ScriptedNativeBrowserImpl::resetCounters();
+        NativeBrowserImpl::setInstanceFactory(&ScriptedNativeBrowserImpl::create);
+    }
+    else
+    {
+        NativeBrowserImpl::setInstanceFactory(0);
+    }
+
+    browser = new NativeBrowser();
+    browser->resize(800, 600);
+    // backends are created on show
+    browser->show();
+    connect(browser, SIGNAL(loadStarted()), this, SLOT(started()));
+    connect(browser, SIGNAL(loadProgress(int)), this, SLOT(progress(int)));
+    connect(browser, SIGNAL(loadFinished(bool)), this, SLOT(finished(bool)));
+
+    clock.start();
+    quint64 allocations_before = allocationCount();
+    QMetaObject::invokeMethod(this, "next", Qt::QueuedConnection);
+    loop.exec();
+    quint64 allocations = allocationCount() - allocations_before;
+    quint64 raw_progress_events = browser->rawProgressEvents();
+
+    delete browser;
+    browser = 0;
+    NativeBrowserImpl::setInstanceFactory(0);
+
+    QJsonObject result;
+    result["suite"] = "navigation";
+    result["backend"] = backend == ScriptedBackend ? "scripted" : "platform";
+    result["navigations"] = navigations;
+    result["failures"] = failures;
+    result["navigate_to_load_started_ns"] = summarize(to_started);
+    result["navigate_to_load_finished_ns"] = summarize(to_finished);
+    result["raw_progress_events"] = double(raw_progress_events);
+    result["load_progress_signals"] = double(progress_signals);
+    result["allocations_per_navigation"] = double(allocations) / navigations;
+    result["allocation_counter"] = allocationCounterKind();
+    if (backend == ScriptedBackend)
+    {
+        qint64 dispatched = ScriptedNativeBrowserImpl::progressDispatchCount();
+        result["progress_dispatch_ns"] = dispatched
+                ? double(ScriptedNativeBrowserImpl::progressDispatchNsecs()) / dispatched
+                : 0.0;
+    }
+    return result;
+}
+
+void NavigationBench::next()
+{
+    if (current == navigations)
+    {
+        loop.quit();
+        return;
+    }
+    QString url = urlFor(current++);
+    navigate_time = clock.nsecsElapsed();
+    browser->load(url);
+}
+
+void NavigationBench::started()
+{
+    to_started.append(clock.nsecsElapsed() - navigate_time);
+}
+
+void NavigationBench::progress(int)
+{
+    ++progress_signals;
+}
+
+void NavigationBench::finished(bool ok)
+{
+    to_finished.append(clock.nsecsElapsed() - navigate_time);
+    if (!ok)
+        ++failures;
+    // leave the backend's call stack before starting the next navigation
+    QMetaObject::invokeMethod(this, "next", Qt::QueuedConnection);
+}
+
+QString NavigationBench::urlFor(int index) const
+{
+    // every navigation gets a distinct URL so nothing can be served from a cache
+    if (backend == ScriptedBackend)
+        return QString("bench://page/%1").arg(index);
+    return QString("data:text/html,<p>navigation %1</p>").arg(index);
+}
+
+QJsonObject runNavigationBench(const BenchOptions &options)
+{
+    NavigationBench bench(NavigationBench::ScriptedBackend);
+    return bench.run(options);
+}
+
+QJsonObject runPlatformNavigationBench(const BenchOptions &options)
+{
+    NavigationBench bench(NavigationBench::PlatformBackend);
+    return bench.run(options);
+}
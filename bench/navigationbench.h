@@ -0,0 +1,55 @@
+#ifndef NAVIGATIONBENCH_H
+#define NAVIGATIONBENCH_H
+
+#include <QElapsedTimer>
+#include <QEventLoop>
+#include <QJsonObject>
+#include <QObject>
+#include <QVector>
+
+#include "benchutil.h"
+
+class NativeBrowser;
+
+// Drives one NativeBrowser through a series of load() calls, each started
+// when the previous one has finished, and measures the signal latencies.
+class NavigationBench : public QObject
+{
+    Q_OBJECT
+public:
+    enum Backend
+    {
+        ScriptedBackend, // engine-less backend, measures the shared pipeline only
+        PlatformBackend  // backend of the current platform loading data: URLs
+    };
+
+    explicit NavigationBench(Backend backend, QObject *parent = 0);
+
+    QJsonObject run(const BenchOptions &options);
+
+private slots:
+    void next();
+    void started();
+    void progress(int progress);
+    void finished(bool ok);
+
+private:
+    QString urlFor(int index) const;
+
+    Backend backend;
+    NativeBrowser *browser;
+    QEventLoop loop;
+    QElapsedTimer clock;
+    qint64 navigate_time;
+    int navigations;
+    int current;
+    int failures;
+    qint64 progress_signals;
+    QVector<qint64> to_started;
+    QVector<qint64> to_finished;
+};
+
+QJsonObject runNavigationBench(const BenchOptions &options);
+QJsonObject runPlatformNavigationBench(const BenchOptions &options);
+
+#endif // NAVIGATIONBENCH_H
@@ -0,0 +1,116 @@
+#include "policybench.h"
+
+#include <QElapsedTimer>
+#include <QStringList>
+#include <QUrl>
+
+#include "navigationpolicy.h"
+
+namespace {
+
+static const int RULE_COUNT = 10000;
+static const int URL_COUNT = 4096;
+
+static void AddRules(NavigationPolicy &policy)
+{
+    // 60% hosts, 20% subdomain wildcards, 20% path prefixes
+    for (int i = 0; i < RULE_COUNT; ++i)
+    {
+        switch (i % 5)
+        {
+        case 0:
+            policy.addRule(QString("*.zone%1.net").arg(i), NavigationPolicy::Block);
+            break;
+        case 1:
+            policy.addRule(QString("docs%1.org/section%2/").arg(i % 200).arg(i), NavigationPolicy::Allow);
+            break;
+        default:
+            policy.addRule(QString("host%1.example%2.com").arg(i).arg(i % 100), NavigationPolicy::External);
+            break;
+        }
+    }
+    policy.addRule("$site", NavigationPolicy::Allow);
+}
+
+static QStringList Urls()
+{
+    // a mix of every rule kind, the current site and misses
+    QStringList urls;
+    for (int i = 0; i < URL_COUNT; ++i)
+    {
+        int rule = (i * 7919) % RULE_COUNT;
+        switch (i % 6)
+        {
+        case 0:
+            urls << QString("http://a.b.zone%1.net/index.html").arg(rule - rule % 5);
+            break;
+        case 1:
+            urls << QString("https://docs%1.org/section%2/page?id=%3").arg(rule % 200).arg(rule).arg(i);
+            break;
+        case 2:
+            urls << QString("http://host%1.example%2.com/").arg(rule).arg(rule % 100);
+            break;
+        case 3:
+            urls << QString("http://www.dashboard.local/frame/%1").arg(i);
+            break;
+        case 4:
+            urls << QString("http://cdn.dashboard.local:8080/asset/%1.js").arg(i);
+            break;
+        default:
+            urls << QString("https://unknown%1.example.com/path").arg(i);
+            break;
+        }
+    }
+    return urls;
+}
+
+} // anonymous
+
+QJsonObject runPolicyBench(const BenchOptions &options)
+{
+    int decisions = options.iterations > 0 ? options.iterations : 1000000;
+    QStringList urls = Urls();
+    QString current_host("www.dashboard.local");
+
+    QElapsedTimer clock;
+    clock.start();
+    NavigationPolicy policy;
+    AddRules(policy);
+    qint64 compile_ns = clock.nsecsElapsed();
+
+    int counts[3] = { 0, 0, 0 };
+    quint64 allocations_before = allocationCount();
+    clock.restart();
+    for (int i = 0; i < decisions; ++i)
+        ++counts[policy.decide(urls.at(i % URL_COUNT), current_host)];
+    qint64 policy_ns = clock.nsecsElapsed();
+    quint64 policy_allocations = allocationCount() - allocations_before;
+
+    // what BEFORENAVIGATE2 did before: parse the URL, compare the hosts
+    int same_host = 0;
+    allocations_before = allocationCount();
+    clock.restart();
+    for (int i = 0; i < decisions; ++i)
+    {
+        if (QUrl::fromUserInput(urls.at(i % URL_COUNT)).host() == current_host)
+            ++same_host;
+    }
+    qint64 baseline_ns = clock.nsecsElapsed();
+    quint64 baseline_allocations = allocationCount() - allocations_before;
+
+    QJsonObject result;
+    result["suite"] = "navigation-policy";
+    result["rules"] = policy.ruleCount();
+    result["decisions"] = decisions;
+    result["compile_ns"] = double(compile_ns);
+    result["ns_per_decision"] = double(policy_ns) / decisions;
+    result["allocations_per_decision"] = double(policy_allocations) / decisions;
+    result["allowed"] = counts[NavigationPolicy::Allow];
+    result["external"] = counts[NavigationPolicy::External];
+    result["blocked"] = counts[NavigationPolicy::Block];
+    result["host_compare_ns_per_decision"] = double(baseline_ns) / decisions;
+    result["host_compare_allocations_per_decision"] = double(baseline_allocations) / decisions;
+    result["host_compare_same_host"] = same_host;
+    result["allocation_counter"] = allocationCounterKind();
+    return result;
+}
@@ -0,0 +1,12 @@
+#ifndef POLICYBENCH_H
+#define POLICYBENCH_H
+
+#include <QJsonObject>
+
+#include "benchutil.h"
+
+// Compiles a 10k rule NavigationPolicy and measures decisions per URL,
+// against the host comparison through QUrl it replaced.
+QJsonObject runPolicyBench(const BenchOptions &options);
+
+#endif // POLICYBENCH_H
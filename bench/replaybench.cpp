@@ -0,0 +1,131 @@
+#include "replaybench.h"
+
+#include <QBuffer>
+#include <QElapsedTimer>
+#include <QEventLoop>
+
+#include "enginetrace.h"
+#include "enginetracereplay.h"
+#include "nativebrowser.h"
+
+namespace {
+
+// what an engine reports for a page with a subframe: the top frame and the
+// frame are navigated, progress is reported, then both complete
+static QVector<EngineTraceEvent> SyntheticTrace(int navigations, int progress_steps)
+{
+    QVector<EngineTraceEvent> trace;
+    qint64 time = 0;
+    EngineTraceEvent event;
+    for (int i = 0; i < navigations; ++i)
+    {
+        QString url = QString("http://bench.local/page/%1").arg(i);
+
+        event = EngineTraceEvent();
+        event.time = time += 1000;
+        event.kind = EngineTraceEvent::Load;
+        event.url = url;
+        trace.append(event);
+
+        event.kind = EngineTraceEvent::BeforeNavigate;
+        event.time = time += 1000;
+        trace.append(event);
+
+        event.kind = EngineTraceEvent::BeforeNavigate;
+        event.url = QString("http://bench.local/frame/%1").arg(i);
+        event.top_frame = false;
+        trace.append(event);
+
+        event = EngineTraceEvent();
+        event.kind = EngineTraceEvent::Progress;
+        event.maximum = progress_steps;
+        for (int step = 1; step <= progress_steps; ++step)
+        {
+            event.time = time += 1000;
+            event.current = step;
+            trace.append(event);
+        }
+
+        event = EngineTraceEvent();
+        event.time = time += 1000;
+        event.kind = EngineTraceEvent::NavigateComplete;
+        trace.append(event);
+        event.kind = EngineTraceEvent::DocumentComplete;
+        event.top_frame = false;
+        trace.append(event);
+        event.kind = EngineTraceEvent::DocumentComplete;
+        event.top_frame = true;
+        trace.append(event);
+
+        // a link to another host, turned into an external navigation
+        event = EngineTraceEvent();
+        event.time = time += 1000;
+        event.kind = EngineTraceEvent::BeforeNavigate;
+        event.url = QString("http://elsewhere.local/%1").arg(i);
+        event.allowed = false;
+        trace.append(event);
+    }
+    return trace;
+}
+
+} // anonymous
+
+QJsonObject runReplayBench(const BenchOptions &options)
+{
+    EngineTraceReplay replay;
+    QString source = "synthetic";
+    if (!options.trace_file.isEmpty())
+    {
+        if (!replay.open(options.trace_file))
+        {
+            QJsonObject result;
+            result["suite"] = "replay";
+            result["error"] = QString("cannot read trace %1").arg(options.trace_file);
+            return result;
+        }
+        source = options.trace_file;
+    }
+    else
+    {
+        int navigations = options.iterations > 0 ? options.iterations : 5000;
+        int steps = options.progress_steps > 0 ? options.progress_steps : 10;
+        // round trip through the binary format, so decoding is covered too
+        QBuffer buffer;
+        buffer.open(QIODevice::ReadWrite);
+        EngineTraceWriter writer(&buffer);
+        for (const EngineTraceEvent &event : SyntheticTrace(navigations, steps))
+            writer.write(event);
+        buffer.seek(0);
+        replay.read(&buffer);
+    }
+
+    int load_finished = 0;
+    int external = 0;
+    QObject::connect(replay.browser(), &NativeBrowser::loadFinished, [&load_finished](bool) { ++load_finished; });
+    QObject::connect(replay.browser(), &NativeBrowser::externalNavigate, [&external](const QString &) { ++external; });
+
+    QEventLoop loop;
+    QObject::connect(&replay, SIGNAL(finished()), &loop, SLOT(quit()));
+    QElapsedTimer clock;
+    clock.start();
+    quint64 allocations_before = allocationCount();
+    replay.start(EngineTraceReplay::MaximumSpeed);
+    if (replay.isRunning())
+        loop.exec();
+    qint64 elapsed = clock.nsecsElapsed();
+    quint64 allocations = allocationCount() - allocations_before;
+
+    int events = replay.replayedEvents();
+    QJsonObject result;
+    result["suite"] = "replay";
+    result["trace"] = source;
+    result["events"] = events;
+    result["decision_mismatches"] = replay.decisionMismatches();
+    result["load_finished_signals"] = load_finished;
+    result["external_navigations"] = external;
+    result["total_ns"] = double(elapsed);
+    result["ns_per_event"] = events ? double(elapsed) / events : 0.0;
+    result["allocations_per_event"] = events ? double(allocations) / events : 0.0;
+    result["allocation_counter"] = allocationCounterKind();
+    return result;
+}
@@ -0,0 +1,12 @@
+#ifndef REPLAYBENCH_H
+#define REPLAYBENCH_H
+
+#include <QJsonObject>
+
+#include "benchutil.h"
+
+// Replays an engine trace (--trace, or a synthetic one) through the shared
+// event handling at maximum speed and measures the cost per event.
+QJsonObject runReplayBench(const BenchOptions &options);
+
+#endif // REPLAYBENCH_H
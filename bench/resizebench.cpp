@@ -0,0 +1,56 @@
+#include "resizebench.h"
+
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QEventLoop>
+#include <QTimer>
+
+#include "nativebrowser.h"
+#include "nativebrowserimpl.h"
+
+QJsonObject runResizeBench(const BenchOptions &options)
+{
+    int events = options.iterations > 0 ? options.iterations : 1000;
+
+    NativeBrowserImpl::setInstanceFactory(0);
+    NativeBrowser browser;
+    browser.resize(800, 600);
+    browser.show();
+    QCoreApplication::processEvents();
+    quint64 applied_before = browser.appliedResizes();
+    quint64 dropped_before = browser.droppedResizes();
+
+    // a drag delivers resize events at the mouse rate, far above the frame rate
+    QVector<qint64> samples;
+    samples.reserve(events);
+    QElapsedTimer clock;
+    QEventLoop loop;
+    int current = 0;
+    QTimer drag;
+    drag.setInterval(1);
+    QObject::connect(&drag, &QTimer::timeout, [&]() {
+        if (current == events)
+        {
+            drag.stop();
+            loop.quit();
+            return;
+        }
+        clock.start();
+        browser.resize(800 + current % 400, 600 + current % 200);
+        samples.append(clock.nsecsElapsed());
+        ++current;
+    });
+    drag.start();
+    loop.exec();
+    // the last size of the burst lands one frame later
+    QTimer::singleShot(100, &loop, SLOT(quit()));
+    loop.exec();
+
+    QJsonObject result;
+    result["suite"] = "resize";
+    result["resize_events"] = events;
+    result["applied_resizes"] = double(browser.appliedResizes() - applied_before);
+    result["dropped_resizes"] = double(browser.droppedResizes() - dropped_before);
+    result["resize_call_ns"] = summarize(samples);
+    return result;
+}
@@ -0,0 +1,13 @@
+#ifndef RESIZEBENCH_H
+#define RESIZEBENCH_H
+
+#include <QJsonObject>
+
+#include "benchutil.h"
+
+// Drags the size of a platform browser through a 1 second live resize, one
+// resize event per millisecond, and reports how many reached the engine and
+// what the resize events cost the GUI thread.
+QJsonObject runResizeBench(const BenchOptions &options);
+
+#endif // RESIZEBENCH_H
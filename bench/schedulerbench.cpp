@@ -0,0 +1,117 @@
+#include "schedulerbench.h"
+
+#include <QEventLoop>
+#include <QJsonArray>
+#include <QList>
+#include <QTimer>
+
+#include "loadscheduler.h"
+#include "nativebrowser.h"
+#include "nativebrowserimpl.h"
+
+namespace {
+
+static const int browser_count = 24;
+static const int shown_count = 4;
+static const int cap = 4;
+
+static QString Page(int round, int index)
+{
+    QString html = QString("<!DOCTYPE html><html><body><h1>panel %1 round %2</h1>").arg(index).arg(round);
+    for (int row = 0; row < 2000; ++row)
+        html += QString("<p>row %1: lorem ipsum dolor sit amet</p>").arg(row);
+    return "data:text/html," + html + "</body></html>";
+}
+
+// one round: every browser loads, hidden ones are asked first
+static bool Round(const QList<NativeBrowser *> &browsers, int round, QVector<qint64> &shown, QVector<qint64> &hidden, QVector<qint64> &waits)
+{
+    QEventLoop loop;
+    int pending = browsers.size();
+    QList<QMetaObject::Connection> connections;
+    for (NativeBrowser *browser : browsers)
+    {
+        bool is_shown = browser->isVisible();
+        connections << QObject::connect(browser, &NativeBrowser::navigationTimings, [&, is_shown](const NavigationTiming &timing) {
+            if (timing.finished < 0)
+                return; // superseded
+            (is_shown ? shown : hidden).append(timing.finished - timing.load_called);
+            waits.append(timing.navigate_issued - timing.load_called);
+            if (--pending == 0)
+                loop.quit();
+        });
+    }
+
+    for (int i = browsers.size() - 1; i >= 0; --i)
+        browsers.at(i)->load(Page(round, i));
+    QTimer::singleShot(60000, &loop, SLOT(quit()));
+    loop.exec();
+
+    for (const QMetaObject::Connection &connection : connections)
+        QObject::disconnect(connection);
+    return pending == 0;
+}
+
+static QJsonObject Run(int maximum_loads, int rounds)
+{
+    LoadScheduler *scheduler = LoadScheduler::instance();
+    scheduler->setMaximumConcurrentLoads(maximum_loads);
+    scheduler->resetStatistics();
+
+    QList<NativeBrowser *> browsers;
+    for (int i = 0; i < browser_count; ++i)
+    {
+        NativeBrowser *browser = new NativeBrowser();
+        browser->resize(400, 300);
+        // backends are created on show, the hidden ones are panels the
+        // user switched away from
+        browser->show();
+        browsers << browser;
+    }
+    for (int i = shown_count; i < browser_count; ++i)
+        browsers.at(i)->hide();
+    browsers.first()->activateWindow();
+    browsers.first()->setFocus();
+
+    QVector<qint64> shown;
+    QVector<qint64> hidden;
+    QVector<qint64> waits;
+    int timeouts = 0;
+    for (int round = 0; round < rounds; ++round)
+    {
+        if (!Round(browsers, round, shown, hidden, waits))
+            ++timeouts;
+    }
+    qDeleteAll(browsers);
+
+    QJsonObject run;
+    run["maximum_concurrent_loads"] = maximum_loads;
+    run["timeouts"] = timeouts;
+    run["shown_load_to_finished_ns"] = summarize(shown);
+    run["hidden_load_to_finished_ns"] = summarize(hidden);
+    run["queue_wait_ns"] = summarize(waits);
+    run["delayed_loads"] = double(scheduler->delayedLoads());
+    run["maximum_wait_ns"] = double(scheduler->maximumWaitTime());
+    scheduler->setMaximumConcurrentLoads(0);
+    return run;
+}
+
+} // anonymous
+
+QJsonObject runSchedulerBench(const BenchOptions &options)
+{
+    int rounds = options.iterations > 0 ? options.iterations : 5;
+    NativeBrowserImpl::setInstanceFactory(0);
+
+    QJsonArray runs;
+    runs.append(Run(0, rounds));
+    runs.append(Run(cap, rounds));
+
+    QJsonObject result;
+    result["suite"] = "load-scheduler";
+    result["browsers"] = browser_count;
+    result["shown"] = shown_count;
+    result["rounds"] = rounds;
+    result["runs"] = runs;
+    return result;
+}
@@ -0,0 +1,13 @@
+#ifndef SCHEDULERBENCH_H
+#define SCHEDULERBENCH_H
+
+#include <QJsonObject>
+
+#include "benchutil.h"
+
+// Loads a page in 24 platform browsers at once, 4 shown and 20 hidden, hidden
+// ones first, without a cap and with LoadScheduler capping at 4, and
+// measures load() to loadFinished for the shown and the hidden ones.
+QJsonObject runSchedulerBench(const BenchOptions &options);
+
+#endif // SCHEDULERBENCH_H
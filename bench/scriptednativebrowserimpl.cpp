@@ -0,0 +1,92 @@
+#include "scriptednativebrowserimpl.h"
+
+#include <QElapsedTimer>
+#include <QMetaObject>
+
+namespace {
+
+static int progress_steps = 10;
+static qint64 progress_dispatch_count = 0;
+static qint64 progress_dispatch_nsecs = 0;
+
+} // anonymous
+
+ScriptedNativeBrowserImpl::ScriptedNativeBrowserImpl()
+    : pending(false)
+{
+}
+
+NativeBrowserImpl *ScriptedNativeBrowserImpl::create(WId)
+{
+    return new ScriptedNativeBrowserImpl();
+}
+
+void ScriptedNativeBrowserImpl::setProgressSteps(int steps)
+{
+    progress_steps = steps;
+}
+
+void ScriptedNativeBrowserImpl::resetCounters()
+{
+    progress_dispatch_count = 0;
+    progress_dispatch_nsecs = 0;
+}
+
+qint64 ScriptedNativeBrowserImpl::progressDispatchCount()
+{
+    return progress_dispatch_count;
+}
+
+qint64 ScriptedNativeBrowserImpl::progressDispatchNsecs()
+{
+    return progress_dispatch_nsecs;
+}
+
+void ScriptedNativeBrowserImpl::navigate(const QString &url)
+{
+    current_url = url;
+    if (!pending)
+    {
+        pending = true;
+        QMetaObject::invokeMethod(this, "runScript", Qt::QueuedConnection);
+    }
+}
+
+QString ScriptedNativeBrowserImpl::location() const
+{
+    return current_url;
+}
+
+void ScriptedNativeBrowserImpl::stop()
+{
+    pending = false;
+}
+
+void ScriptedNativeBrowserImpl::setSize(const QSize &)
+{
+}
+
+QSize ScriptedNativeBrowserImpl::contentSize() const
+{
+    return QSize(800, 600);
+}
+
+void ScriptedNativeBrowserImpl::runScript()
+{
+    if (!pending)
+        return;
+    pending = false;
+
+    onLoadStart();
+
+    QElapsedTimer clock;
+    clock.start();
+    for (int i = 1; i <= progress_steps; ++i)
+    {
+        onProgress(i, progress_steps);
+    }
+    progress_dispatch_nsecs += clock.nsecsElapsed();
+    progress_dispatch_count += progress_steps;
+
+    onLoadFinish(true);
+}
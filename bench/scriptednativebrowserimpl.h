@@ -0,0 +1,38 @@
+#ifndef SCRIPTEDNATIVEBROWSERIMPL_H
+#define SCRIPTEDNATIVEBROWSERIMPL_H
+
+#include "nativebrowserimpl.h"
+
+// Backend without an engine: every navigate() plays back a fixed script
+// (start, progress_steps progress events, finish) on the next event loop
+// iteration, so only the cost of the shared pipeline is measured.
+class ScriptedNativeBrowserImpl : public NativeBrowserImpl
+{
+    Q_OBJECT
+public:
+    static NativeBrowserImpl* create(WId browserwindow);
+
+    static void setProgressSteps(int steps);
+    static void resetCounters();
+    static qint64 progressDispatchCount();
+    static qint64 progressDispatchNsecs();
+
+    virtual void navigate(const QString &url) override;
+    virtual QString location() const override;
+    virtual void stop() override;
+
+    virtual void setSize(const QSize& size) override;
+
+    virtual QSize contentSize() const override;
+
+private slots:
+    void runScript();
+
+private:
+    ScriptedNativeBrowserImpl();
+
+    QString current_url;
+    bool pending;
+};
+
+#endif // SCRIPTEDNATIVEBROWSERIMPL_H
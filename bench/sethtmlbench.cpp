@@ -0,0 +1,134 @@
+#include "sethtmlbench.h"
+
+#include <QElapsedTimer>
+#include <QEventLoop>
+#include <QJsonArray>
+#include <QTemporaryFile>
+#include <QUrl>
+
+#include "nativebrowser.h"
+#include "nativebrowserimpl.h"
+
+namespace {
+
+enum Approach
+{
+    SetHtml,
+    TemporaryFile,
+    DataUrl
+};
+
+static const char *ApproachName(Approach approach)
+{
+    switch (approach)
+    {
+    case SetHtml: return "set_html";
+    case TemporaryFile: return "temporary_file";
+    case DataUrl: return "data_url";
+    }
+    return "";
+}
+
+static QByteArray Document(int megabytes)
+{
+    QByteArray html("<!DOCTYPE html><html><body>\n");
+    int size = megabytes * 1024 * 1024;
+    html.reserve(size + 64);
+    for (int row = 0; html.size() < size; ++row)
+        html += "<p>report row " + QByteArray::number(row) + ": lorem ipsum dolor sit amet</p>\n";
+    html += "</body></html>\n";
+    return html;
+}
+
+// time from the call until loadFinished, what the caller does to get the
+// document in (writing the file, encoding the URL) included
+static qint64 Show(NativeBrowser *browser, Approach approach, const QByteArray &html, bool &ok, quint64 &allocations)
+{
+    QEventLoop loop;
+    ok = false;
+    QMetaObject::Connection connection = QObject::connect(browser, &NativeBrowser::loadFinished, [&](bool success) {
+        ok = success;
+        loop.quit();
+    });
+
+    QTemporaryFile file;
+    QElapsedTimer clock;
+    quint64 allocations_before = allocationCount();
+    clock.start();
+    switch (approach)
+    {
+    case SetHtml:
+        browser->setHtml(html, QUrl("http://bench.local/"));
+        break;
+    case TemporaryFile:
+        if (!file.open() || file.write(html) != html.size())
+        {
+            QObject::disconnect(connection);
+            return -1;
+        }
+        file.flush();
+        browser->load(QUrl::fromLocalFile(file.fileName()).toString());
+        break;
+    case DataUrl:
+        browser->load(QString("data:text/html;base64,") + QString::fromLatin1(html.toBase64()));
+        break;
+    }
+    loop.exec();
+    qint64 elapsed = clock.nsecsElapsed();
+    allocations = allocationCount() - allocations_before;
+    QObject::disconnect(connection);
+    return elapsed;
+}
+
+} // anonymous
+
+QJsonObject runSetHtmlBench(const BenchOptions &options)
+{
+    int repetitions = options.iterations > 0 ? options.iterations : 3;
+    static const int sizes[] = { 1, 10, 50 };
+    static const Approach approaches[] = { SetHtml, TemporaryFile, DataUrl };
+
+    NativeBrowserImpl::setInstanceFactory(0);
+    NativeBrowser browser;
+    browser.resize(800, 600);
+    browser.show();
+
+    QJsonArray runs;
+    for (int megabytes : sizes)
+    {
+        QByteArray html = Document(megabytes);
+        for (Approach approach : approaches)
+        {
+            QVector<qint64> samples;
+            int failures = 0;
+            quint64 allocations = 0;
+            for (int i = 0; i < repetitions; ++i)
+            {
+                bool ok;
+                quint64 run_allocations;
+                qint64 elapsed = Show(&browser, approach, html, ok, run_allocations);
+                if (elapsed < 0 || !ok)
+                {
+                    ++failures;
+                    continue;
+                }
+                samples.append(elapsed);
+                allocations += run_allocations;
+            }
+            QJsonObject run;
+            run["megabytes"] = megabytes;
+            run["approach"] = ApproachName(approach);
+            run["failures"] = failures;
+            run["call_to_load_finished_ns"] = summarize(samples);
+            run["allocations_per_load"] = samples.isEmpty() ? 0.0 : double(allocations) / samples.size();
+            runs.append(run);
+        }
+    }
+
+    QJsonObject result;
+    result["suite"] = "set-html";
+    result["repetitions"] = repetitions;
+    result["runs"] = runs;
+    result["allocation_counter"] = allocationCounterKind();
+    return result;
+}
@@ -0,0 +1,12 @@
+#ifndef SETHTMLBENCH_H
+#define SETHTMLBENCH_H
+
+#include <QJsonObject>
+
+#include "benchutil.h"
+
+// Shows 1-50 MB documents through the platform backend with setHtml(), a
+// temporary file and a data: URL, and measures each until loadFinished.
+QJsonObject runSetHtmlBench(const BenchOptions &options);
+
+#endif // SETHTMLBENCH_H
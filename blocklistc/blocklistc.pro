@@ -0,0 +1,17 @@
+QT       = core
+
+TEMPLATE = app
+TARGET   = nativebrowser_blocklistc
+DESTDIR  = $$PWD/../bin
+CONFIG  += C++11 console
+CONFIG  -= app_bundle
+
+INCLUDEPATH += $$PWD/..
+
+SOURCES += main.cpp \
+    $$PWD/../navigationpolicy.cpp \
+    $$PWD/../requestblocklist.cpp
+
+HEADERS += \
+    $$PWD/../navigationpolicy.h \
+    $$PWD/../requestblocklist.h
@@ -0,0 +1,55 @@
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QFile>
+#include <QSaveFile>
+#include <QStringList>
+#include <QTextStream>
+
+#include "requestblocklist.h"
+
+int main(int argc, char* argv[])
+{
+    QCoreApplication app(argc, argv);
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Compiles text blocklist rules for NativeBrowser::setRequestBlocklist().");
+    parser.addHelpOption();
+    parser.addPositionalArgument("rules", "Text rule files, one host or host/path per line.", "rules...");
+    QCommandLineOption output_option(QStringList() << "o" << "output", "Write the compiled list to <file>.", "file");
+    parser.addOption(output_option);
+    parser.process(app);
+
+    QStringList inputs = parser.positionalArguments();
+    if (inputs.isEmpty() || !parser.isSet(output_option))
+        parser.showHelp(1);
+
+    QStringList rules;
+    for (const QString &input : inputs)
+    {
+        QFile file(input);
+        if (!file.open(QIODevice::ReadOnly | QIODevice::Text))
+        {
+            QTextStream(stderr) << "cannot read " << input << endl;
+            return 1;
+        }
+        QTextStream stream(&file);
+        while (!stream.atEnd())
+            rules << stream.readLine();
+    }
+
+    // written to a temporary file first, a running browser may map the old one
+    QSaveFile output(parser.value(output_option));
+    if (!output.open(QIODevice::WriteOnly))
+    {
+        QTextStream(stderr) << "cannot write " << output.fileName() << endl;
+        return 1;
+    }
+    int count = RequestBlocklist::compile(rules, &output);
+    if (count < 0 || !output.commit())
+    {
+        QTextStream(stderr) << "cannot write " << output.fileName() << endl;
+        return 1;
+    }
+    QTextStream(stdout) << count << " rules compiled from " << rules.size() << " lines" << endl;
+    return 0;
+}
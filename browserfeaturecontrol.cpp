@@ -0,0 +1,292 @@
+#include "browserfeaturecontrol.h"
+
+#include <QMutex>
+#include <QMutexLocker>
+#include <QStringList>
+
+namespace {
+
+static const char BROWSER_EMULATION[] = "FEATURE_BROWSER_EMULATION";
+
+static QMutex mutex;
+static bool initialized = false;
+static bool initialize_result = false;
+static bool custom_features = false;
+static BrowserFeatureControl::Features current_features;
+static BrowserFeatureStore *injected_store = 0;
+static BrowserFeatureStore *active_store = 0;
+static quint32 emulation_mode = 0;
+
+// expects the mutex to be locked
+static bool ApplyFeatures(BrowserFeatureStore *store, const BrowserFeatureControl::Features &features)
+{
+    // FeatureControl settings are per-process
+    QString process_name = store->processName();
+    if (process_name.isEmpty())
+        return false;
+
+    bool success = true;
+    BrowserFeatureControl::Features::const_iterator it = features.constBegin();
+    for (; it != features.constEnd(); ++it)
+    {
+        success = store->setFeature(it.key(), process_name, it.value()) && success;
+    }
+    return success;
+}
+
+} // anonymous
+
+BrowserFeatureControl::Features BrowserFeatureControl::defaultFeatures()
+{
+    // http://msdn.microsoft.com/en-us/library/ee330720(v=vs.85).aspx
+    Features features;
+
+    // Windows Internet Explorer 8 and later. The FEATURE_BROWSER_EMULATION feature defines the default emulation mode for Internet
+    // Explorer and supports the following values.
+    // Webpages containing standards-based !DOCTYPE directives are displayed in IE10 Standards mode.
+    // The value is derived from the installed engine version unless it is set explicitly, see emulationModeForVersion().
+
+    // Internet Explorer 8 or later. The FEATURE_AJAX_CONNECTIONEVENTS feature enables events that occur when the value of the online
+    // property of the navigator object changes, such as when the user chooses to work offline. For more information, see the ononline
+    // and onoffline events.
+    // Default: DISABLED
+//    features["FEATURE_AJAX_CONNECTIONEVENTS"] = 1;
+
+    // Internet Explorer 9. Internet Explorer 9 optimized the performance of window-drawing routines that involve clipping regions associated
+    // with child windows. This helped improve the performance of certain window drawing operations. However, certain applications hosting the
+    // WebBrowser Control rely on the previous behavior and do not function correctly when these optimizations are enabled. The
+    // FEATURE_ENABLE_CLIPCHILDREN_OPTIMIZATION feature can disable these optimizations.
+    // Default: ENABLED
+    // features["FEATURE_ENABLE_CLIPCHILDREN_OPTIMIZATION"] = 1;
+
+    // Internet Explorer 8 and later. By default, Internet Explorer reduces memory leaks caused by circular references between Internet Explorer
+    // and the Microsoft JScript engine, especially in scenarios where a webpage defines an expando and the page is refreshed. If a legacy
+    // application no longer functions with these changes, the FEATURE_MANAGE_SCRIPT_CIRCULAR_REFS feature can disable these improvements.
+    // Default: ENABLED
+    // features["FEATURE_MANAGE_SCRIPT_CIRCULAR_REFS"] = 1;
+
+    // Windows Internet Explorer 8. When enabled, the FEATURE_DOMSTORAGE feature allows Internet Explorer and applications hosting the WebBrowser
+    // Control to use the Web Storage API. For more information, see Introduction to Web Storage.
+    // Default: ENABLED
+    // features["FEATURE_DOMSTORAGE"] = 1;
+
+    // Internet Explorer 9. The FEATURE_GPU_RENDERING feature enables Internet Explorer to use a graphics processing unit (GPU) to render content.
+    // This dramatically improves performance for webpages that are rich in graphics.
+    // Default: DISABLED
+//    features["FEATURE_GPU_RENDERING"] = 1;
+
+    // Internet Explorer 9. By default, the WebBrowser Control uses Microsoft DirectX to render webpages, which might cause problems for
+    // applications that use the Draw method to create bitmaps from certain webpages. In Internet Explorer 9, this method returns a bitmap
+    // (in a Windows Graphics Device Interface (GDI) wrapper) instead of a GDI metafile representation of the webpage. When the
+    // FEATURE_IVIEWOBJECTDRAW_DMLT9_WITH_GDI feature is enabled, the following conditions cause the Draw method to use GDI instead of DirectX
+    // to create the resulting representation. The GDI representation will contain text records and vector data, but is not guaranteed to be
+    // similar to the same represenation returned in earlier versions of the browser:
+    //    The device context passed to the Draw method points to an enhanced metafile.
+    //    The webpage is not displayed in IE9 Standards mode.
+    // By default, this feature is ENABLED for applications hosting the WebBrowser Control. This feature is ignored by Internet Explorer and
+    // Windows Explorer. To enable this feature by using the registry, add the name of your executable file to the following setting.
+//    features["FEATURE_IVIEWOBJECTDRAW_DMLT9_WITH_GDI"] = 0;
+
+    // Windows 8 introduces a new input model that is different from the Windows 7 input model. In order to provide the broadest compatibility
+    // for legacy applications, the WebBrowser Control for Windows 8 emulates the Windows 7 mouse, touch, and pen input model (also known as the
+    // legacy input model). When the legacy input model is in effect, the following conditions are true:
+    //    Windows pointer messages are not processed by the Trident rendering engine (mshtml.dll).
+    //    Document Object Model (DOM) pointer and gesture events do not fire.
+    //    Mouse and touch messages are dispatched according to the Windows 7 input model.
+    //    Touch selection follows the Windows 7 model ("drag to select") instead of the Windows 8 model ("tap to select").
+    //    Hardware accelerated panning and zooming is disabled.
+    //    The Zoom and Pan Cascading Style Sheets (CSS) properties are ignored.
+    // The FEATURE_NINPUT_LEGACYMODE feature control determines whether the legacy input model is enabled
+    // Default: ENABLED
+//    features["FEATURE_NINPUT_LEGACYMODE"] = 0;
+
+    // Internet Explorer 7 consolidated HTTP compression and data manipulation into a centralized component in order to improve performance and
+    // to provide greater consistency between transfer encodings (such as HTTP no-cache headers). For compatibility reasons, the original
+    // implementation was left in place. When the FEATURE_DISABLE_LEGACY_COMPRESSION feature is disabled, the original compression implementation
+    // is used.
+    // Default: ENABLED
+    // features["FEATURE_DISABLE_LEGACY_COMPRESSION"] = 1;
+
+    // When the FEATURE_LOCALMACHINE_LOCKDOWN feature is enabled, Internet Explorer applies security restrictions on content loaded from the
+    // user's local machine, which helps prevent malicious behavior involving local files:
+    //    Scripts, Microsoft ActiveX controls, and binary behaviors are not allowed to run.
+    //    Object safety settings cannot be overridden.
+    //    Cross-domain data actions require confirmation from the user.
+    // Default: DISABLED
+    // features["FEATURE_LOCALMACHINE_LOCKDOWN"] = 0;
+
+    // Internet Explorer 7 and later. When enabled, the FEATURE_BLOCK_LMZ_??? feature allows ??? stored in the Local Machine zone to be
+    // loaded only by webpages loaded from the Local Machine zone or by webpages hosted by sites in the Trusted Sites list. For more information,
+    // see Security and Compatibility in Internet Explorer 7.
+    // Default: DISABLED
+    //    FEATURE_BLOCK_LMZ_IMG can block images that try to load from the user's local file system. To opt in, add your process name and set
+    //                          the value to 0x00000001.
+    //    FEATURE_BLOCK_LMZ_OBJECT can block objects that try to load from the user's local file system. To opt in, add your process name and
+    //                          set the value to 0x00000001.
+    //    FEATURE_BLOCK_LMZ_SCRIPT can block script access from the user's local file system. To opt in, add your process name and set the value
+    //                          to 0x00000001.
+    // features["FEATURE_BLOCK_LMZ_OBJECT"] = 0;
+    // features["FEATURE_BLOCK_LMZ_OBJECT"] = 0;
+    // features["FEATURE_BLOCK_LMZ_SCRIPT"] = 0;
+
+    // Internet Explorer 8 and later. When enabled, the FEATURE_DISABLE_NAVIGATION_SOUNDS feature disables the sounds played when you open a
+    // link in a webpage.
+    // Default: DISABLED
+    features["FEATURE_DISABLE_NAVIGATION_SOUNDS"] = 1;
+
+    // Windows Internet Explorer 7 and later. Prior to Internet Explorer 7, href attributes of a objects supported the javascript prototcol;
+    // this allowed webpages to execute script when the user clicked a link. For security reasons, this support was disabled in Internet
+    // Explorer 7. For more information, see Event 1034 - Cross-Domain Barrier and Script URL Mitigation.
+    // When enabled, the FEATURE_SCRIPTURL_MITIGATION feature allows the href attribute of a objects to support the javascript prototcol.
+    // Default: DISABLED
+//    features["FEATURE_SCRIPTURL_MITIGATION"] = 1;
+
+    // For Windows 8 and later, the FEATURE_SPELLCHECKING feature controls this behavior for Internet Explorer and for applications hosting
+    // the web browser control (WebOC). When fully enabled, this feature automatically corrects grammar issues and identifies misspelled words
+    // for the conditions described earlier.
+    //    (DWORD) 00000000 - Features are disabled.
+    //    (DWORD) 00000001 - Features are enabled for the conditions described earlier. (This is the default value.)
+    //    (DWORD) 00000002 - Features are enabled, but only for elements that specifically set the spellcheck attribute to true.
+//    features["FEATURE_SPELLCHECKING"] = 0;
+
+    // When enabled, the FEATURE_STATUS_BAR_THROTTLING feature limits the frequency of status bar updates to one update every 200 milliseconds.
+    // Default: DISABLED
+//    features["FEATURE_STATUS_BAR_THROTTLING"] = 1;
+
+    // Internet Explorer 7 or later. When enabled, the FEATURE_TABBED_BROWSING feature enables tabbed browsing navigation shortcuts and
+    // notifications. For more information, see Tabbed Browsing for Developers.
+    // Default: DISABLED
+    // features["FEATURE_TABBED_BROWSING"] = 1;
+
+    // When enabled, the FEATURE_VALIDATE_NAVIGATE_URL feature control prevents Windows Internet Explorer from navigating to a badly formed URL.
+    // Default: DISABLED
+//    features["FEATURE_VALIDATE_NAVIGATE_URL"] = 1;
+
+    // When enabled,the FEATURE_WEBOC_DOCUMENT_ZOOM feature allows HTML dialog boxes to inherit the zoom state of the parent window.
+    // Default: DISABLED
+//    features["FEATURE_WEBOC_DOCUMENT_ZOOM"] = 1;
+
+    // The FEATURE_WEBOC_POPUPMANAGEMENT feature allows applications hosting the WebBrowser Control to receive the default Internet Explorer
+    // pop-up window management behavior.
+    // Default: ENABLED
+//    features["FEATURE_WEBOC_POPUPMANAGEMENT"] = 0;
+
+    // Applications hosting the WebBrowser Control should ensure that window resizing and movement events are handled appropriately for the
+    // needs of the application. By default, these events are ignored if the WebBrowser Control is not hosted in a proper container. When enabled,
+    // the FEATURE_WEBOC_MOVESIZECHILD feature allows these events to affect the parent window of the application hosting the WebBrowser Control.
+    // Because this can lead to unpredictable results, it is not considered desirable behavior.
+    // Default: DISABLED
+    // features["FEATURE_WEBOC_MOVESIZECHILD"] = 0;
+
+    // The FEATURE_ADDON_MANAGEMENT feature enables applications hosting the WebBrowser Control
+    // to respect add-on management selections made using the Add-on Manager feature of Internet Explorer.
+    // Add-ons disabled by the user or by administrative group policy will also be disabled in applications that enable this feature.
+//    features["FEATURE_ADDON_MANAGEMENT"] = 0;
+
+    // Internet Explorer 10. When enabled, the FEATURE_WEBSOCKET feature allows script to create and use WebSocket objects.
+    // The WebSocketobject allows websites to request data across domains from your browser by using the WebSocket protocol.
+    // Default: ENABLED
+//    features["FEATURE_WEBSOCKET"] = 1;
+
+    // When enabled, the FEATURE_WINDOW_RESTRICTIONS feature adds several restrictions to the size and behavior of popup windows:
+    //    Popup windows must appear in the visible display area.
+    //    Popup windows are forced to have status and address bars.
+    //    Popup windows must have minimum sizes.
+    //    Popup windows cannot cover important areas of the parent window.
+    // When enabled, this feature can be configured differently for each security zone by using the URLACTION_FEATURE_WINDOW_RESTRICTIONS URL
+    // action flag.
+    // Default: ENABLED
+//    features["FEATURE_WINDOW_RESTRICTIONS"] = 0;
+
+    // Internet Explorer 7 and later. The FEATURE_XMLHTTP feature enables or disables the native XMLHttpRequest object.
+    // Default: ENABLED
+    // features["FEATURE_XMLHTTP"] = 1;
+
+    return features;
+}
+
+void BrowserFeatureControl::setFeatures(const Features &features)
+{
+    QMutexLocker lock(&mutex);
+    custom_features = true;
+    current_features = features;
+    if (initialized && active_store)
+    {
+        Features applied(features);
+        // an explicit emulation mode replaces the derived one, dropping it
+        // goes back to the engine's
+        if (applied.contains(BROWSER_EMULATION))
+            emulation_mode = applied.value(BROWSER_EMULATION);
+        else
+            emulation_mode = emulationModeForVersion(active_store->engineVersion());
+        if (!applied.contains(BROWSER_EMULATION) && emulation_mode != 0)
+            applied[BROWSER_EMULATION] = emulation_mode;
+        initialize_result = ApplyFeatures(active_store, applied);
+    }
+}
+
+BrowserFeatureControl::Features BrowserFeatureControl::features()
+{
+    QMutexLocker lock(&mutex);
+    return custom_features ? current_features : defaultFeatures();
+}
+
+void BrowserFeatureControl::setStore(BrowserFeatureStore *store)
+{
+    QMutexLocker lock(&mutex);
+    injected_store = store;
+}
+
+bool BrowserFeatureControl::initialize(BrowserFeatureStore *default_store)
+{
+    QMutexLocker lock(&mutex);
+    if (initialized)
+        return initialize_result;
+
+    active_store = injected_store ? injected_store : default_store;
+    initialized = true;
+    if (!active_store)
+        return initialize_result;
+
+    Features applied = custom_features ? current_features : defaultFeatures();
+    if (applied.contains(BROWSER_EMULATION))
+    {
+        emulation_mode = applied.value(BROWSER_EMULATION);
+    }
+    else
+    {
+        emulation_mode = emulationModeForVersion(active_store->engineVersion());
+        if (emulation_mode != 0)
+            applied[BROWSER_EMULATION] = emulation_mode;
+    }
+    initialize_result = ApplyFeatures(active_store, applied);
+    return initialize_result;
+}
+
+quint32 BrowserFeatureControl::emulationMode()
+{
+    QMutexLocker lock(&mutex);
+    return emulation_mode;
+}
+
+quint32 BrowserFeatureControl::emulationModeForVersion(const QString &version)
+{
+    QStringList parts = version.split('.', QString::SkipEmptyParts);
+    bool ok = false;
+    int major = parts.isEmpty() ? 0 : parts.at(0).toInt(&ok);
+    if (!ok)
+        return 0;
+
+    switch (major)
+    {
+    case 7:
+    case 8:
+    case 9:
+    case 10:
+    case 11:
+        return quint32(major) * 1000;
+    default:
+        // newer engines: IE11 edge mode
+        return major > 11 ? 11001 : 0;
+    }
+}
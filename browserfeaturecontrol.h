@@ -0,0 +1,49 @@
+#ifndef BROWSERFEATURECONTROL_H
+#define BROWSERFEATURECONTROL_H
+
+#include <QMap>
+#include <QString>
+
+// Where the engine's per-process feature control settings live. On Windows
+// this is the FeatureControl registry key, other stores can be injected
+// (e.g. to check what would be written without touching the registry).
+class BrowserFeatureStore
+{
+public:
+    virtual ~BrowserFeatureStore() {}
+
+    // version of the installed engine such as "11.0.9600.18860", empty if unknown
+    virtual QString engineVersion() = 0;
+    // executable name the settings are keyed by, empty if unknown
+    virtual QString processName() = 0;
+    virtual bool setFeature(const QString &feature, const QString &process_name, quint32 value) = 0;
+};
+
+// Applies the feature control settings once per process, no matter how many
+// browsers are created, and caches the emulation mode derived from the
+// engine version. Thread-safe.
+class BrowserFeatureControl
+{
+public:
+    typedef QMap<QString, quint32> Features;
+
+    // features applied when setFeatures() was not called
+    static Features defaultFeatures();
+
+    // replaces the feature set; applied right away when the settings were
+    // already written, otherwise when the first browser is created
+    static void setFeatures(const Features &features);
+    static Features features();
+
+    // store used instead of the platform default, must outlive its use
+    static void setStore(BrowserFeatureStore *store);
+
+    // writes the settings on the first call, later calls return the first result
+    static bool initialize(BrowserFeatureStore *default_store);
+
+    // FEATURE_BROWSER_EMULATION value written by initialize(), 0 if unknown
+    static quint32 emulationMode();
+    static quint32 emulationModeForVersion(const QString &version);
+};
+
+#endif // BROWSERFEATURECONTROL_H
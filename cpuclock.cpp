@@ -0,0 +1,36 @@
+#include "cpuclock.h"
+
+#if defined(Q_OS_WIN)
+#include <Windows.h>
+#elif defined(Q_OS_MAC)
+#include <mach/mach.h>
+#else
+#include <time.h>
+#endif
+
+qint64 CpuClock::threadTime()
+{
+#if defined(Q_OS_WIN)
+    FILETIME creation, exit, kernel, user;
+    if (!GetThreadTimes(GetCurrentThread(), &creation, &exit, &kernel, &user))
+        return 0;
+    quint64 ticks = (quint64(kernel.dwHighDateTime) << 32 | kernel.dwLowDateTime)
+            + (quint64(user.dwHighDateTime) << 32 | user.dwLowDateTime);
+    return qint64(ticks * 100); // 100 ns units
+#elif defined(Q_OS_MAC)
+    mach_port_t thread = mach_thread_self();
+    thread_basic_info_data_t info;
+    mach_msg_type_number_t count = THREAD_BASIC_INFO_COUNT;
+    kern_return_t result = thread_info(thread, THREAD_BASIC_INFO, reinterpret_cast<thread_info_t>(&info), &count);
+    mach_port_deallocate(mach_task_self(), thread);
+    if (result != KERN_SUCCESS)
+        return 0;
+    return (qint64(info.user_time.seconds) + info.system_time.seconds) * 1000000000
+            + (qint64(info.user_time.microseconds) + info.system_time.microseconds) * 1000;
+#else
+    timespec now;
+    if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &now) != 0)
+        return 0;
+    return qint64(now.tv_sec) * 1000000000 + now.tv_nsec;
+#endif
+}
@@ -0,0 +1,13 @@
+#ifndef CPUCLOCK_H
+#define CPUCLOCK_H
+
+#include <QtGlobal>
+
+// CPU time (user and system) consumed by the calling thread, in
+// nanoseconds, for attributing work to the engine instances on it.
+struct CpuClock
+{
+    static qint64 threadTime();
+};
+
+#endif // CPUCLOCK_H
@@ -0,0 +1,274 @@
+#include "enginetrace.h"
+
+#include <QCoreApplication>
+#include <QDir>
+#include <QFile>
+#include <QMutex>
+#include <QMutexLocker>
+
+#include <cstring>
+
+namespace {
+
+static const char TRACE_MAGIC[4] = { 'N', 'B', 'T', 'R' };
+static const quint8 TRACE_VERSION = 1;
+
+static const quint8 KIND_MASK = 0x1f;
+static const quint8 TOP_FRAME_FLAG = 0x40;
+static const quint8 ALLOWED_FLAG = 0x80;
+
+// strings longer than this are taken as a corrupted trace
+static const quint64 MAX_STRING_SIZE = 64 * 1024 * 1024;
+
+static bool HasUrl(EngineTraceEvent::Kind kind)
+{
+    return kind == EngineTraceEvent::Load
+        || kind == EngineTraceEvent::BeforeNavigate
+        || kind == EngineTraceEvent::NewWindow;
+}
+
+static QMutex record_mutex;
+static QString record_directory;
+static bool record_directory_set = false;
+static int recorder_count = 0;
+
+} // anonymous
+
+EngineTraceEvent::EngineTraceEvent()
+    : kind(LoadStart)
+    , time(0)
+    , top_frame(true)
+    , allowed(true)
+    , current(0)
+    , maximum(0)
+{
+}
+
+EngineTraceWriter::EngineTraceWriter(QIODevice *device)
+    : device(device)
+    , last_time(0)
+    , event_count(0)
+    , header_written(false)
+{
+}
+
+bool EngineTraceWriter::write(const EngineTraceEvent &event)
+{
+    buffer.clear();
+    if (!header_written)
+        writeHeader();
+
+    quint8 kind = quint8(event.kind) & KIND_MASK;
+    if (event.top_frame)
+        kind |= TOP_FRAME_FLAG;
+    if (event.allowed)
+        kind |= ALLOWED_FLAG;
+    buffer.append(char(kind));
+
+    // a clock going backwards is recorded as no time passing
+    putVarint(quint64(qMax<qint64>(0, event.time - last_time)));
+    last_time = qMax(last_time, event.time);
+
+    if (HasUrl(event.kind))
+    {
+        QByteArray url = event.url.toUtf8();
+        putVarint(quint64(url.size()));
+        buffer.append(url);
+    }
+    if (event.kind == EngineTraceEvent::Progress)
+    {
+        // zigzag, engines report -1 for "done"
+        putVarint((quint64(qint64(event.current)) << 1) ^ quint64(qint64(event.current) >> 63));
+        putVarint((quint64(qint64(event.maximum)) << 1) ^ quint64(qint64(event.maximum) >> 63));
+    }
+
+    ++event_count;
+    return device->write(buffer) == buffer.size();
+}
+
+void EngineTraceWriter::writeHeader()
+{
+    buffer.append(TRACE_MAGIC, sizeof(TRACE_MAGIC));
+    buffer.append(char(TRACE_VERSION));
+    header_written = true;
+}
+
+void EngineTraceWriter::putVarint(quint64 value)
+{
+    while (value >= 0x80)
+    {
+        buffer.append(char(quint8(value) | 0x80));
+        value >>= 7;
+    }
+    buffer.append(char(value));
+}
+
+EngineTraceReader::EngineTraceReader(QIODevice *device)
+    : device(device)
+    , last_time(0)
+    , header_read(false)
+    , error(false)
+{
+}
+
+bool EngineTraceReader::read(EngineTraceEvent &event)
+{
+    if (error)
+        return false;
+    if (!header_read && !readHeader())
+        return false;
+
+    quint8 kind;
+    if (!getByte(kind))
+        return false; // a clean end of the trace
+    event = EngineTraceEvent();
+    quint8 kind_value = kind & KIND_MASK;
+    if (kind_value < EngineTraceEvent::Load || kind_value > EngineTraceEvent::LoadFinish)
+    {
+        error = true;
+        return false;
+    }
+    event.kind = EngineTraceEvent::Kind(kind_value);
+    event.top_frame = kind & TOP_FRAME_FLAG;
+    event.allowed = kind & ALLOWED_FLAG;
+
+    quint64 delta;
+    if (!getVarint(delta))
+    {
+        error = true;
+        return false;
+    }
+    last_time += qint64(delta);
+    event.time = last_time;
+
+    if (HasUrl(event.kind))
+    {
+        quint64 size;
+        if (!getVarint(size) || size > MAX_STRING_SIZE)
+        {
+            error = true;
+            return false;
+        }
+        QByteArray url = device->read(qint64(size));
+        if (quint64(url.size()) != size)
+        {
+            error = true;
+            return false;
+        }
+        event.url = QString::fromUtf8(url);
+    }
+    if (event.kind == EngineTraceEvent::Progress)
+    {
+        quint64 current, maximum;
+        if (!getVarint(current) || !getVarint(maximum))
+        {
+            error = true;
+            return false;
+        }
+        event.current = int(qint64(current >> 1) ^ -qint64(current & 1));
+        event.maximum = int(qint64(maximum >> 1) ^ -qint64(maximum & 1));
+    }
+    return true;
+}
+
+bool EngineTraceReader::readHeader()
+{
+    QByteArray header = device->read(sizeof(TRACE_MAGIC) + 1);
+    header_read = true;
+    if (header.size() != int(sizeof(TRACE_MAGIC)) + 1
+            || memcmp(header.constData(), TRACE_MAGIC, sizeof(TRACE_MAGIC)) != 0
+            || quint8(header.at(sizeof(TRACE_MAGIC))) != TRACE_VERSION)
+    {
+        error = true;
+        return false;
+    }
+    return true;
+}
+
+bool EngineTraceReader::getByte(quint8 &value)
+{
+    char c;
+    if (!device->getChar(&c))
+        return false;
+    value = quint8(c);
+    return true;
+}
+
+bool EngineTraceReader::getVarint(quint64 &value)
+{
+    value = 0;
+    for (int shift = 0; shift < 64; shift += 7)
+    {
+        quint8 byte;
+        if (!getByte(byte))
+            return false;
+        value |= quint64(byte & 0x7f) << shift;
+        if (!(byte & 0x80))
+            return true;
+    }
+    return false;
+}
+
+void EngineTraceRecorder::setRecordDirectory(const QString &path)
+{
+    QMutexLocker lock(&record_mutex);
+    record_directory = path;
+    record_directory_set = true;
+}
+
+QString EngineTraceRecorder::recordDirectory()
+{
+    QMutexLocker lock(&record_mutex);
+    if (!record_directory_set)
+    {
+        // production builds are switched on from the outside
+        record_directory = QString::fromLocal8Bit(qgetenv("NATIVEBROWSER_ENGINE_TRACE"));
+        record_directory_set = true;
+    }
+    return record_directory;
+}
+
+EngineTraceRecorder *EngineTraceRecorder::create()
+{
+    QString directory = recordDirectory();
+    if (directory.isEmpty())
+        return 0;
+
+    int index;
+    {
+        QMutexLocker lock(&record_mutex);
+        index = ++recorder_count;
+    }
+    QString name = QString("engine-%1-%2.nbtrace")
+            .arg(QCoreApplication::applicationPid())
+            .arg(index);
+    QFile *file = new QFile(QDir(directory).filePath(name));
+    if (!file->open(QIODevice::WriteOnly | QIODevice::Truncate))
+    {
+        delete file;
+        return 0;
+    }
+    return new EngineTraceRecorder(file);
+}
+
+EngineTraceRecorder::EngineTraceRecorder(QIODevice *file)
+    : file(file)
+    , writer(file)
+{
+}
+
+EngineTraceRecorder::~EngineTraceRecorder()
+{
+    delete file;
+}
+
+void EngineTraceRecorder::record(const EngineTraceEvent &event)
+{
+    writer.write(event);
+}
+
+QString EngineTraceRecorder::fileName() const
+{
+    QFile *trace_file = qobject_cast<QFile *>(file);
+    return trace_file ? trace_file->fileName() : QString();
+}
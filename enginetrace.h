@@ -0,0 +1,106 @@
+#ifndef ENGINETRACE_H
+#define ENGINETRACE_H
+
+#include <QByteArray>
+#include <QString>
+
+class QIODevice;
+
+// One event of a backend's engine event stream, as handled by
+// NativeBrowserImpl. Which arguments are used depends on the kind.
+struct EngineTraceEvent
+{
+    enum Kind
+    {
+        Load = 1,          // url: NativeBrowser::load()
+        BeforeNavigate,    // url, top_frame, allowed: the engine's decision
+        NewWindow,         // url
+        LoadStart,
+        Progress,          // current, maximum
+        NavigateComplete,  // top_frame
+        NavigateError,     // top_frame
+        DocumentComplete,  // top_frame
+        LoadFinish         // allowed: success
+    };
+
+    EngineTraceEvent();
+
+    Kind kind;
+    qint64 time; // nanoseconds, NavigationTiming::now() of the recording process
+    QString url;
+    bool top_frame;
+    bool allowed;
+    int current;
+    int maximum;
+};
+
+// Compact binary trace of engine events: a header, then one record per
+// event made of a kind byte (flags in the high bits), the time since the
+// previous event and the arguments, integers as varints and strings as
+// length-prefixed UTF-8.
+class EngineTraceWriter
+{
+public:
+    // the device must be open for writing and outlive the writer
+    explicit EngineTraceWriter(QIODevice *device);
+
+    bool write(const EngineTraceEvent &event);
+    quint64 eventCount() const { return event_count; }
+
+private:
+    void writeHeader();
+    void putVarint(quint64 value);
+
+    QIODevice *device;
+    QByteArray buffer;
+    qint64 last_time;
+    quint64 event_count;
+    bool header_written;
+};
+
+class EngineTraceReader
+{
+public:
+    // the device must be open for reading and outlive the reader
+    explicit EngineTraceReader(QIODevice *device);
+
+    // false at the end of the trace or when it is malformed, see hasError()
+    bool read(EngineTraceEvent &event);
+    bool hasError() const { return error; }
+
+private:
+    bool readHeader();
+    bool getByte(quint8 &value);
+    bool getVarint(quint64 &value);
+
+    QIODevice *device;
+    qint64 last_time;
+    bool header_read;
+    bool error;
+};
+
+// Recording of every backend's engine events, for replay with
+// EngineTraceReplay. Disabled unless a directory is set, either with
+// setRecordDirectory() or the NATIVEBROWSER_ENGINE_TRACE environment
+// variable; each backend then writes its own file there.
+class EngineTraceRecorder
+{
+public:
+    static void setRecordDirectory(const QString &path);
+    static QString recordDirectory();
+
+    // 0 when recording is disabled or the file cannot be created
+    static EngineTraceRecorder *create();
+    ~EngineTraceRecorder();
+
+    void record(const EngineTraceEvent &event);
+    QString fileName() const;
+
+private:
+    explicit EngineTraceRecorder(QIODevice *file);
+
+    QIODevice *file;
+    EngineTraceWriter writer;
+};
+
+#endif // ENGINETRACE_H
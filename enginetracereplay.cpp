@@ -0,0 +1,225 @@
+#include "enginetracereplay.h"
+
+#include <QFile>
+#include <QTimer>
+
+#include "nativebrowser.h"
+#include "nativebrowserimpl.h"
+
+// Backend without an engine, the replay calls its hooks in the order the
+// trace has them.
+class ReplayNativeBrowserImpl : public NativeBrowserImpl
+{
+public:
+    static NativeBrowserImpl *create(WId)
+    {
+        last_created = new ReplayNativeBrowserImpl();
+        return last_created;
+    }
+
+    static ReplayNativeBrowserImpl *last_created;
+
+    virtual void navigate(const QString &url) override
+    {
+        current_url = url;
+    }
+
+    virtual QString location() const override
+    {
+        return current_url;
+    }
+
+    virtual void stop() override
+    {
+        // what the engine did after being stopped is in the trace
+    }
+
+    virtual void setSize(const QSize &) override
+    {
+    }
+
+    virtual QSize contentSize() const override
+    {
+        return QSize();
+    }
+
+    // false if the backend decided differently than the recorded engine
+    bool replay(const EngineTraceEvent &event)
+    {
+        switch (event.kind)
+        {
+        case EngineTraceEvent::Load:
+            break; // goes through NativeBrowser::load()
+        case EngineTraceEvent::BeforeNavigate:
+        {
+            bool allowed = onBeforeNavigate(event.url, event.top_frame);
+            if (event.allowed && event.top_frame)
+                current_url = event.url;
+            return allowed == event.allowed;
+        }
+        case EngineTraceEvent::NewWindow:
+            onNewWindow(event.url);
+            break;
+        case EngineTraceEvent::LoadStart:
+            onLoadStart();
+            break;
+        case EngineTraceEvent::Progress:
+            onProgress(event.current, event.maximum);
+            break;
+        case EngineTraceEvent::NavigateComplete:
+            onNavigateComplete(event.top_frame);
+            break;
+        case EngineTraceEvent::NavigateError:
+            onNavigateError(event.top_frame);
+            break;
+        case EngineTraceEvent::DocumentComplete:
+            onDocumentComplete(event.top_frame);
+            break;
+        case EngineTraceEvent::LoadFinish:
+            onLoadFinish(event.allowed);
+            break;
+        }
+        return true;
+    }
+
+private:
+    ReplayNativeBrowserImpl()
+    {
+    }
+
+    QString current_url;
+};
+
+ReplayNativeBrowserImpl *ReplayNativeBrowserImpl::last_created = 0;
+
+EngineTraceReplay::EngineTraceReplay(QObject *parent)
+    : QObject(parent)
+    , target(0)
+    , backend(0)
+    , timer(new QTimer(this))
+    , speed(MaximumSpeed)
+    , next(0)
+    , mismatches(0)
+    , running(false)
+{
+    timer->setSingleShot(true);
+    connect(timer, SIGNAL(timeout()), this, SLOT(replayNext()));
+
+    target = new NativeBrowser();
+    target->setAttribute(Qt::WA_DontShowOnScreen);
+    target->resize(800, 600);
+}
+
+EngineTraceReplay::~EngineTraceReplay()
+{
+    delete target;
+}
+
+bool EngineTraceReplay::open(const QString &file_name)
+{
+    QFile file(file_name);
+    if (!file.open(QIODevice::ReadOnly))
+        return false;
+    return read(&file);
+}
+
+bool EngineTraceReplay::read(QIODevice *device)
+{
+    EngineTraceReader reader(device);
+    QVector<EngineTraceEvent> trace;
+    EngineTraceEvent event;
+    while (reader.read(event))
+        trace.append(event);
+    if (reader.hasError())
+        return false;
+    setEvents(trace);
+    return true;
+}
+
+void EngineTraceReplay::setEvents(const QVector<EngineTraceEvent> &trace)
+{
+    events = trace;
+}
+
+int EngineTraceReplay::eventCount() const
+{
+    return events.size();
+}
+
+NativeBrowser *EngineTraceReplay::browser() const
+{
+    return target;
+}
+
+void EngineTraceReplay::start(Speed replay_speed)
+{
+    if (!backend)
+    {
+        // the backend is created when the browser is first shown, never
+        // taken from the pool while the factory is set
+        NativeBrowserImpl::setInstanceFactory(&ReplayNativeBrowserImpl::create);
+        ReplayNativeBrowserImpl::last_created = 0;
+        target->show();
+        backend = ReplayNativeBrowserImpl::last_created;
+        NativeBrowserImpl::setInstanceFactory(0);
+    }
+    speed = replay_speed;
+    next = 0;
+    mismatches = 0;
+    running = backend != 0;
+    if (!running)
+    {
+        // the browser already had a backend of its own
+        emit finished();
+        return;
+    }
+    scheduleNext();
+}
+
+bool EngineTraceReplay::isRunning() const
+{
+    return running;
+}
+
+int EngineTraceReplay::replayedEvents() const
+{
+    return next;
+}
+
+int EngineTraceReplay::decisionMismatches() const
+{
+    return mismatches;
+}
+
+void EngineTraceReplay::replayNext()
+{
+    if (!running)
+        return;
+    const EngineTraceEvent &event = events.at(next++);
+    if (event.kind == EngineTraceEvent::Load)
+    {
+        target->load(event.url);
+    }
+    else if (!backend->replay(event))
+    {
+        ++mismatches;
+    }
+    scheduleNext();
+}
+
+void EngineTraceReplay::scheduleNext()
+{
+    if (next >= events.size())
+    {
+        running = false;
+        emit finished();
+        return;
+    }
+    int delay = 0;
+    if (speed == RecordedSpeed && next > 0)
+    {
+        qint64 gap = events.at(next).time - events.at(next - 1).time;
+        delay = int(qMin<qint64>(gap / 1000000, 60 * 60 * 1000));
+    }
+    timer->start(delay);
+}
@@ -0,0 +1,69 @@
+#ifndef ENGINETRACEREPLAY_H
+#define ENGINETRACEREPLAY_H
+
+#include <QObject>
+#include <QVector>
+
+#include "enginetrace.h"
+
+class NativeBrowser;
+class QIODevice;
+class QTimer;
+class ReplayNativeBrowserImpl;
+
+// Plays a trace written by EngineTraceRecorder back through the shared
+// NativeBrowserImpl event handling, without an engine: Load events call
+// NativeBrowser::load(), engine events call the backend's hooks. Works on
+// every platform, so traces recorded on Windows or macOS can be replayed
+// offline. Navigation decisions that differ from the recorded ones are
+// counted as mismatches.
+class EngineTraceReplay : public QObject
+{
+    Q_OBJECT
+    Q_DISABLE_COPY(EngineTraceReplay)
+public:
+    enum Speed
+    {
+        RecordedSpeed, // keeps the recorded gaps between events
+        MaximumSpeed   // one event per event loop iteration
+    };
+
+    explicit EngineTraceReplay(QObject *parent = 0);
+    ~EngineTraceReplay();
+
+    // reads the whole trace up front, false if it is unreadable or malformed
+    bool open(const QString &file_name);
+    bool read(QIODevice *device);
+    void setEvents(const QVector<EngineTraceEvent> &events);
+    int eventCount() const;
+
+    // the browser the trace is replayed into, shown off-screen; connect to
+    // its signals before start()
+    NativeBrowser *browser() const;
+
+    void start(Speed speed);
+    bool isRunning() const;
+
+    int replayedEvents() const;
+    int decisionMismatches() const;
+
+signals:
+    void finished();
+
+private slots:
+    void replayNext();
+
+private:
+    void scheduleNext();
+
+    QVector<EngineTraceEvent> events;
+    NativeBrowser *target;
+    ReplayNativeBrowserImpl *backend;
+    QTimer *timer;
+    Speed speed;
+    int next;
+    int mismatches;
+    bool running;
+};
+
+#endif // ENGINETRACEREPLAY_H
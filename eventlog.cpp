@@ -0,0 +1,296 @@
+#include "eventlog.h"
+
+#include <QFile>
+#include <QSaveFile>
+
+#include <atomic>
+
+#if defined(Q_OS_WIN)
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+#endif
+
+#include "navigationtiming.h"
+
+namespace {
+
+// sequence is 0 for a slot never written, 2n + 1 while entry n is being
+// written and 2n + 2 once it is complete; readers take an entry only when
+// the sequence is the same before and after reading it
+struct Slot
+{
+    std::atomic<quint64> sequence;
+    std::atomic<qint64> time;
+    std::atomic<quint64> instance;
+    std::atomic<quint32> kind;
+    std::atomic<qint32> code;
+    std::atomic<quint64> url_hash;
+};
+
+// static storage, zeroed before anything runs
+static Slot ring[EventLog::Capacity];
+static std::atomic<quint64> next_sequence;
+
+static const char *const kind_names[EventLog::KindCount] = {
+    "unknown",
+    "backend-created",
+    "backend-destroyed",
+    "navigation-requested",
+    "navigation-started",
+    "navigation-finished",
+    "navigation-timed-out",
+    "navigation-abandoned",
+    "external-navigation",
+    "request-blocked",
+    "lifecycle-changed",
+    "load-profile-changed",
+    "engine-create-failed",
+    "engine-advise-failed",
+    "engine-unadvise-failed",
+    "html-load-failed",
+    "scheme-register-failed",
+    "feature-control-failed",
+    "navigation-saved",
+    "navigate-failed",
+};
+
+// formatting below runs in crash handlers too: no allocation, no locks
+typedef void (*Sink)(void *context, const char *data, int size);
+
+static int AppendDecimal(char *out, qint64 value)
+{
+    char digits[24];
+    int count = 0;
+    quint64 magnitude = value < 0 ? quint64(-(value + 1)) + 1 : quint64(value);
+    do
+    {
+        digits[count++] = char('0' + magnitude % 10);
+        magnitude /= 10;
+    } while (magnitude);
+    int length = 0;
+    if (value < 0)
+        out[length++] = '-';
+    while (count)
+        out[length++] = digits[--count];
+    return length;
+}
+
+static int AppendHex(char *out, quint64 value, int width)
+{
+    static const char hex[] = "0123456789abcdef";
+    for (int i = width - 1; i >= 0; --i)
+    {
+        out[i] = hex[value & 0xf];
+        value >>= 4;
+    }
+    return width;
+}
+
+static int AppendString(char *out, const char *text)
+{
+    int length = 0;
+    while (text[length])
+    {
+        out[length] = text[length];
+        ++length;
+    }
+    return length;
+}
+
+static bool ReadEntry(quint64 sequence, EventLogEntry &entry)
+{
+    const Slot &slot = ring[sequence & (EventLog::Capacity - 1)];
+    quint64 expected = 2 * sequence + 2;
+    if (slot.sequence.load(std::memory_order_acquire) != expected)
+        return false;
+    entry.time = slot.time.load(std::memory_order_relaxed);
+    entry.instance = slot.instance.load(std::memory_order_relaxed);
+    entry.kind = slot.kind.load(std::memory_order_relaxed);
+    entry.code = slot.code.load(std::memory_order_relaxed);
+    entry.url_hash = slot.url_hash.load(std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return slot.sequence.load(std::memory_order_relaxed) == expected;
+}
+
+static void WriteEntries(Sink sink, void *context)
+{
+    quint64 end = next_sequence.load(std::memory_order_acquire);
+    quint64 begin = end > quint64(EventLog::Capacity) ? end - EventLog::Capacity : 0;
+    for (quint64 sequence = begin; sequence < end; ++sequence)
+    {
+        EventLogEntry entry;
+        if (!ReadEntry(sequence, entry))
+            continue;
+        char line[128];
+        int length = AppendDecimal(line, entry.time);
+        line[length++] = ' ';
+        length += AppendDecimal(line + length, qint64(entry.instance));
+        line[length++] = ' ';
+        length += AppendString(line + length, EventLog::kindName(entry.kind));
+        line[length++] = ' ';
+        length += AppendString(line + length, "0x");
+        length += AppendHex(line + length, quint32(entry.code), 8);
+        line[length++] = ' ';
+        length += AppendHex(line + length, entry.url_hash, 16);
+        line[length++] = '\n';
+        sink(context, line, length);
+    }
+}
+
+static void AppendToByteArray(void *context, const char *data, int size)
+{
+    static_cast<QByteArray *>(context)->append(data, size);
+}
+
+#if defined(Q_OS_WIN)
+
+static HANDLE crash_file = INVALID_HANDLE_VALUE;
+static LPTOP_LEVEL_EXCEPTION_FILTER previous_filter = 0;
+
+static void WriteToCrashFile(void *, const char *data, int size)
+{
+    DWORD written = 0;
+    ::WriteFile(crash_file, data, DWORD(size), &written, NULL);
+}
+
+static LONG WINAPI CrashFilter(EXCEPTION_POINTERS *exception)
+{
+    if (crash_file != INVALID_HANDLE_VALUE)
+    {
+        WriteEntries(&WriteToCrashFile, 0);
+        ::FlushFileBuffers(crash_file);
+    }
+    return previous_filter ? previous_filter(exception) : EXCEPTION_CONTINUE_SEARCH;
+}
+
+#else
+
+static int crash_file = -1;
+static const int crash_signals[] = { SIGSEGV, SIGBUS, SIGFPE, SIGILL, SIGABRT };
+
+static void WriteToCrashFile(void *, const char *data, int size)
+{
+    while (size > 0)
+    {
+        ssize_t written = ::write(crash_file, data, size_t(size));
+        if (written <= 0)
+            return;
+        data += written;
+        size -= int(written);
+    }
+}
+
+static void CrashSignal(int signal_number)
+{
+    if (crash_file >= 0)
+        WriteEntries(&WriteToCrashFile, 0);
+    // the handler was reset on entry, the default action ends the process
+    ::raise(signal_number);
+}
+
+#endif
+
+} // anonymous
+
+void EventLog::record(Kind kind, quint64 instance, qint32 code, quint64 url_hash)
+{
+    quint64 sequence = next_sequence.fetch_add(1, std::memory_order_relaxed);
+    Slot &slot = ring[sequence & (Capacity - 1)];
+    slot.sequence.store(2 * sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    slot.time.store(NavigationTiming::now(), std::memory_order_relaxed);
+    slot.instance.store(instance, std::memory_order_relaxed);
+    slot.kind.store(quint32(kind), std::memory_order_relaxed);
+    slot.code.store(code, std::memory_order_relaxed);
+    slot.url_hash.store(url_hash, std::memory_order_relaxed);
+    slot.sequence.store(2 * sequence + 2, std::memory_order_release);
+}
+
+quint64 EventLog::hashUrl(const QString &url)
+{
+    if (url.isEmpty())
+        return 0;
+    quint64 hash = Q_UINT64_C(14695981039346656037);
+    const ushort *unit = url.utf16();
+    for (int i = 0; i < url.size(); ++i)
+    {
+        hash ^= unit[i];
+        hash *= Q_UINT64_C(1099511628211);
+    }
+    // 0 means no URL
+    return hash ? hash : 1;
+}
+
+const char *EventLog::kindName(quint32 kind)
+{
+    return kind < quint32(KindCount) ? kind_names[kind] : kind_names[0];
+}
+
+quint64 EventLog::recordedEvents()
+{
+    return next_sequence.load(std::memory_order_relaxed);
+}
+
+QVector<EventLogEntry> EventLog::snapshot()
+{
+    QVector<EventLogEntry> entries;
+    quint64 end = next_sequence.load(std::memory_order_acquire);
+    quint64 begin = end > quint64(Capacity) ? end - Capacity : 0;
+    entries.reserve(int(end - begin));
+    for (quint64 sequence = begin; sequence < end; ++sequence)
+    {
+        EventLogEntry entry;
+        if (ReadEntry(sequence, entry))
+            entries.append(entry);
+    }
+    return entries;
+}
+
+QByteArray EventLog::dump()
+{
+    QByteArray text;
+    WriteEntries(&AppendToByteArray, &text);
+    return text;
+}
+
+bool EventLog::writeFile(const QString &file)
+{
+    QSaveFile output(file);
+    if (!output.open(QIODevice::WriteOnly))
+        return false;
+    output.write(dump());
+    return output.commit();
+}
+
+bool EventLog::installCrashHandler(const QString &file)
+{
+#if defined(Q_OS_WIN)
+    HANDLE handle = ::CreateFileW(reinterpret_cast<const wchar_t *>(file.utf16()), GENERIC_WRITE, FILE_SHARE_READ, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (handle == INVALID_HANDLE_VALUE)
+        return false;
+    if (crash_file != INVALID_HANDLE_VALUE)
+        ::CloseHandle(crash_file);
+    crash_file = handle;
+    LPTOP_LEVEL_EXCEPTION_FILTER previous = ::SetUnhandledExceptionFilter(&CrashFilter);
+    if (previous != &CrashFilter)
+        previous_filter = previous;
+    return true;
+#else
+    int descriptor = ::open(QFile::encodeName(file).constData(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (descriptor < 0)
+        return false;
+    if (crash_file >= 0)
+        ::close(crash_file);
+    crash_file = descriptor;
+    struct sigaction action;
+    sigemptyset(&action.sa_mask);
+    action.sa_handler = &CrashSignal;
+    action.sa_flags = SA_RESETHAND;
+    for (int signal_number : crash_signals)
+        ::sigaction(signal_number, &action, 0);
+    return true;
+#endif
+}
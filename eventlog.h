@@ -0,0 +1,86 @@
+#ifndef EVENTLOG_H
+#define EVENTLOG_H
+
+#include <QByteArray>
+#include <QString>
+#include <QVector>
+
+// One entry of the EventLog.
+struct EventLogEntry
+{
+    qint64 time;       // NavigationTiming::now()
+    quint64 instance;  // NativeBrowserImpl::instanceId(), 0 for the process
+    quint32 kind;      // EventLog::Kind
+    qint32 code;       // HRESULT, success flag or state, 0 if none
+    quint64 url_hash;  // EventLog::hashUrl(), 0 if none
+};
+
+// Fixed-size, lock-free ring buffer of the last Capacity events of all
+// browsers in the process. Recording is a handful of relaxed atomic stores
+// into a preallocated slot, cheap enough to leave on; the oldest events are
+// overwritten. URLs are kept as hashes only, nothing is allocated. The log
+// is read with snapshot() or dump(), and installCrashHandler() writes it to
+// a file when the process crashes.
+class EventLog
+{
+public:
+    enum Kind
+    {
+        BackendCreated = 1,
+        BackendDestroyed,
+        NavigationRequested,  // url
+        NavigationStarted,
+        NavigationFinished,   // code: 1 on success
+        NavigationTimedOut,
+        NavigationAbandoned,
+        ExternalNavigation,   // url
+        RequestBlocked,       // url
+        LifecycleChanged,     // code: NativeBrowser::LifecycleState
+        LoadProfileChanged,   // code: NativeBrowser::LoadProfile
+        EngineCreateFailed,   // code: HRESULT
+        EngineAdviseFailed,   // code: HRESULT
+        EngineUnadviseFailed, // code: HRESULT
+        HtmlLoadFailed,       // code: HRESULT
+        SchemeRegisterFailed, // code: HRESULT
+        FeatureControlFailed, // code: system error
+        NavigationSaved,      // code: SavedReason
+        NavigateFailed,       // code: HRESULT
+        KindCount
+    };
+
+    enum SavedReason
+    {
+        SavedCollapsed = 1, // the URL was already being loaded
+        SavedDebounced,     // replaced by a later request of the same burst
+        SavedFresh          // the URL was loaded a moment ago
+    };
+
+    // a power of two, slots are picked by masking the sequence number
+    static const int Capacity = 4096;
+
+    static void record(Kind kind, quint64 instance, qint32 code = 0, quint64 url_hash = 0);
+    static void record(Kind kind, quint64 instance, const QString &url, qint32 code = 0)
+    {
+        record(kind, instance, code, hashUrl(url));
+    }
+
+    // 64-bit FNV-1a of the URL's UTF-16 code units, stable across runs
+    static quint64 hashUrl(const QString &url);
+    static const char *kindName(quint32 kind);
+
+    // events recorded since the start, including overwritten ones
+    static quint64 recordedEvents();
+
+    // the retained events, oldest first; entries overwritten while they
+    // were being read are skipped
+    static QVector<EventLogEntry> snapshot();
+    // one line per event: time, instance, kind, code and URL hash
+    static QByteArray dump();
+    static bool writeFile(const QString &file);
+
+    // dumps the log to file when the process crashes (unhandled exception
+    // on Windows, fatal signal elsewhere); the file is opened right away
+    static bool installCrashHandler(const QString &file);
+};
+
+#endif // EVENTLOG_H
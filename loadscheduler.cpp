@@ -0,0 +1,190 @@
+#include "loadscheduler.h"
+
+#include <QApplication>
+#include <QCoreApplication>
+#include <QMetaObject>
+#include <QWidget>
+
+#include "nativebrowserimpl.h"
+#include "navigationtiming.h"
+
+namespace {
+
+// reset by the destructor, the scheduler goes with the application
+static LoadScheduler *scheduler = 0;
+
+} // anonymous
+
+LoadScheduler *LoadScheduler::instance()
+{
+    if (!scheduler)
+    {
+        scheduler = new LoadScheduler(QCoreApplication::instance());
+    }
+    return scheduler;
+}
+
+LoadScheduler::LoadScheduler(QObject *parent)
+    : QObject(parent)
+    , maximum_loads(0)
+    , start_pending(false)
+    , started_count(0)
+    , delayed_count(0)
+    , total_wait(0)
+    , maximum_wait(0)
+{
+}
+
+LoadScheduler::~LoadScheduler()
+{
+    if (scheduler == this)
+        scheduler = 0;
+}
+
+void LoadScheduler::setMaximumConcurrentLoads(int count)
+{
+    maximum_loads = qMax(0, count);
+    // a higher cap or none at all lets waiting loads through
+    scheduleStart();
+}
+
+int LoadScheduler::maximumConcurrentLoads() const
+{
+    return maximum_loads;
+}
+
+int LoadScheduler::runningLoads() const
+{
+    return running.size();
+}
+
+int LoadScheduler::queuedLoads() const
+{
+    return queue.size();
+}
+
+quint64 LoadScheduler::startedLoads() const
+{
+    return started_count;
+}
+
+quint64 LoadScheduler::delayedLoads() const
+{
+    return delayed_count;
+}
+
+qint64 LoadScheduler::totalWaitTime() const
+{
+    return total_wait;
+}
+
+qint64 LoadScheduler::maximumWaitTime() const
+{
+    return maximum_wait;
+}
+
+void LoadScheduler::resetStatistics()
+{
+    started_count = 0;
+    delayed_count = 0;
+    total_wait = 0;
+    maximum_wait = 0;
+}
+
+LoadScheduler::Priority LoadScheduler::priorityOf(const QWidget *browser)
+{
+    if (!browser || !browser->isVisible() || browser->visibleRegion().isEmpty())
+        return Hidden;
+    QWidget *focus = QApplication::focusWidget();
+    if (focus && (focus == browser || browser->isAncestorOf(focus)))
+        return Focused;
+    return Visible;
+}
+
+bool LoadScheduler::request(NativeBrowserImpl *backend, const QWidget *browser)
+{
+    if (running.contains(backend))
+    {
+        // the new navigation supersedes the running one in its slot
+        ++started_count;
+        return true;
+    }
+    for (int i = 0; i < queue.size(); ++i)
+    {
+        if (queue.at(i).backend == backend)
+        {
+            // still waiting, the new navigation takes over its place
+            return false;
+        }
+    }
+    // waiting loads go first even when a slot just freed up
+    if (maximum_loads == 0 || (queue.isEmpty() && running.size() < maximum_loads))
+    {
+        if (maximum_loads > 0)
+            running.append(backend);
+        ++started_count;
+        return true;
+    }
+    Entry entry;
+    entry.backend = backend;
+    entry.browser = browser;
+    entry.queued_at = NavigationTiming::now();
+    queue.append(entry);
+    scheduleStart();
+    return false;
+}
+
+void LoadScheduler::release(NativeBrowserImpl *backend)
+{
+    if (running.removeOne(backend))
+    {
+        scheduleStart();
+        return;
+    }
+    for (int i = 0; i < queue.size(); ++i)
+    {
+        if (queue.at(i).backend == backend)
+        {
+            queue.removeAt(i);
+            return;
+        }
+    }
+}
+
+void LoadScheduler::scheduleStart()
+{
+    if (start_pending || queue.isEmpty())
+        return;
+    // not from within the finishing backend's signals
+    start_pending = true;
+    QMetaObject::invokeMethod(this, "startQueued", Qt::QueuedConnection);
+}
+
+void LoadScheduler::startQueued()
+{
+    start_pending = false;
+    while (!queue.isEmpty() && (maximum_loads == 0 || running.size() < maximum_loads))
+    {
+        int next = 0;
+        Priority next_priority = priorityOf(queue.first().browser);
+        for (int i = 1; i < queue.size() && next_priority != Focused; ++i)
+        {
+            Priority priority = priorityOf(queue.at(i).browser);
+            if (priority < next_priority)
+            {
+                next = i;
+                next_priority = priority;
+            }
+        }
+
+        Entry entry = queue.takeAt(next);
+        qint64 waited = NavigationTiming::now() - entry.queued_at;
+        ++started_count;
+        ++delayed_count;
+        total_wait += waited;
+        maximum_wait = qMax(maximum_wait, waited);
+        if (maximum_loads > 0)
+            running.append(entry.backend);
+        entry.backend->startScheduledNavigation();
+    }
+}
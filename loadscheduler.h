@@ -0,0 +1,83 @@
+#ifndef LOADSCHEDULER_H
+#define LOADSCHEDULER_H
+
+#include <QList>
+#include <QObject>
+
+class NativeBrowserImpl;
+class QWidget;
+
+// Caps how many navigations run at once across all NativeBrowser instances.
+// Navigations beyond the cap wait in a queue and are let through as running
+// ones finish: the browser with the keyboard focus first, then visible ones,
+// hidden ones last, each in the order they were requested. Priorities are
+// taken when a slot frees up, so a waiting load moves up as soon as its
+// browser is shown or focused. A browser that loads again keeps its slot;
+// about:blank and pooled backends never wait. Disabled until
+// setMaximumConcurrentLoads().
+class LoadScheduler : public QObject
+{
+    Q_OBJECT
+    Q_DISABLE_COPY(LoadScheduler)
+public:
+    enum Priority
+    {
+        Focused, // visible, has the keyboard focus
+        Visible,
+        Hidden
+    };
+
+    static LoadScheduler *instance();
+
+    // 0 lets every navigation through right away
+    void setMaximumConcurrentLoads(int count);
+    int maximumConcurrentLoads() const;
+
+    int runningLoads() const;
+    int queuedLoads() const;
+
+    // navigations let through, and how many of them had to wait first
+    quint64 startedLoads() const;
+    quint64 delayedLoads() const;
+    // nanoseconds the delayed navigations waited, in total and at most
+    qint64 totalWaitTime() const;
+    qint64 maximumWaitTime() const;
+    void resetStatistics();
+
+    static Priority priorityOf(const QWidget *browser);
+
+private slots:
+    void startQueued();
+
+private:
+    friend class NativeBrowserImpl;
+    explicit LoadScheduler(QObject *parent = 0);
+    ~LoadScheduler();
+
+    // true if backend may navigate now, otherwise it is queued and
+    // startScheduledNavigation() is called on it when a slot is free
+    bool request(NativeBrowserImpl *backend, const QWidget *browser);
+    // the backend's navigation finished or was dropped, also takes it out
+    // of the queue
+    void release(NativeBrowserImpl *backend);
+
+    void scheduleStart();
+
+    struct Entry
+    {
+        NativeBrowserImpl *backend;
+        const QWidget *browser;
+        qint64 queued_at;
+    };
+
+    QList<Entry> queue; // in request order
+    QList<NativeBrowserImpl *> running;
+    int maximum_loads;
+    bool start_pending;
+    quint64 started_count;
+    quint64 delayed_count;
+    qint64 total_wait;
+    qint64 maximum_wait;
+};
+
+#endif // LOADSCHEDULER_H
@@ -1,32 +1,544 @@
 #include "nativebrowser.h"
+#include "browserfeaturecontrol.h"
+#include "nativebrowsergovernor.h"
 #include "nativebrowserimpl.h"
+#include "navigationstatemachine.h"
+#include "schemehandler.h"
 
+#include <QEvent>
+#include <QHideEvent>
+#include <QMetaObject>
 #include <QResizeEvent>
+#include <QShowEvent>
+#include <QWindow>
 
 NativeBrowser::NativeBrowser(QWidget *parent)
     : QWidget(parent)
-    , browser(NativeBrowserImpl::createNewInstance(this))
+    , browser(0)
+    , has_pending_url(false)
+    , pending_load_time(-1)
+    , pending_start_timeout(-1)
+    , pending_idle_timeout(-1)
+    , discarded(false)
+    , lifecycle_state(Active)
+    , automatic_throttling(false)
+    , load_profile(Full)
+    , deduplicate_navigations(false)
+    , navigation_debounce(0)
+    , navigation_freshness(0)
+    , history_traversal(NoTraversal)
+    , timing_history_size(16)
 {
+    qRegisterMetaType<NavigationTiming>();
+
+    // the backend is only created when the browser is first shown or loads
+    // something, settings made before are replayed on it
+    NavigationStateMachine defaults;
+    load_start_timeout = defaults.startTimeout();
+    load_idle_timeout = defaults.idleTimeout();
 }
 
 NativeBrowser::~NativeBrowser()
 {
-    delete browser;
+    supersedeReply();
+    if (browser)
+    {
+        NativeBrowserGovernor::instance()->backendDestroyed(this);
+        NativeBrowserImpl::releaseInstance(browser);
+    }
 }
 
 QString NativeBrowser::url() const
 {
+    if (!browser)
+        return pending_url;
     return browser->location();
 }
 
 QSize NativeBrowser::sizeHint() const
 {
+    if (!browser)
+        return QWidget::sizeHint();
     return browser->sizeHint();
 }
 
+quint64 NativeBrowser::rawProgressEvents() const
+{
+    return browser ? browser->rawProgressEvents() : 0;
+}
+
+quint64 NativeBrowser::emittedProgressEvents() const
+{
+    return browser ? browser->emittedProgressEvents() : 0;
+}
+
+quint64 NativeBrowser::appliedResizes() const
+{
+    return browser ? browser->appliedResizes() : 0;
+}
+
+quint64 NativeBrowser::droppedResizes() const
+{
+    return browser ? browser->droppedResizes() : 0;
+}
+
+bool NativeBrowser::hasBackend() const
+{
+    return browser != 0;
+}
+
+bool NativeBrowser::isDiscarded() const
+{
+    return discarded;
+}
+
 void NativeBrowser::load(const QString &url)
 {
-    browser->navigate(url);
+    supersedeReply();
+    leaveHistoryEntry();
+    history_traversal = NoTraversal;
+    startLoad(url, NavigationTiming::now(), NavigationOptions());
+}
+
+NavigationReply *NativeBrowser::navigate(const QString &url, const NavigationOptions &options)
+{
+    supersedeReply();
+    leaveHistoryEntry();
+    history_traversal = NoTraversal;
+    qint64 load_called = NavigationTiming::now();
+    NavigationReply *reply = new NavigationReply(this, url, load_called, options.timeout);
+    current_reply = reply;
+    qint64 served = startLoad(url, load_called, options);
+    // joined a navigation already under way
+    if (current_reply == reply)
+        reply->load_called = served;
+    return reply;
+}
+
+qint64 NativeBrowser::startLoad(const QString &url, qint64 load_called, const NavigationOptions &options)
+{
+    // the first load creates the engine, shown or not
+    forgetPendingLoad();
+    NativeBrowserImpl *impl = backend();
+    // before load(), the engine may start within it
+    impl->setNavigationTimeouts(options.start_timeout, options.idle_timeout);
+    return impl->load(url, load_called);
+}
+
+void NativeBrowser::setHtml(const QByteArray &html, const QUrl &baseUrl)
+{
+    supersedeReply();
+    leaveHistoryEntry();
+    history_traversal = NoTraversal;
+    startHtml(html, baseUrl, NavigationTiming::now());
+}
+
+void NativeBrowser::startHtml(const QByteArray &html, const QUrl &baseUrl, qint64 load_called)
+{
+    forgetPendingLoad();
+    backend()->setHtml(html, baseUrl, load_called);
+}
+
+void NativeBrowser::forgetPendingLoad()
+{
+    // a page kept by discardBackend() is replaced by the new navigation
+    has_pending_url = false;
+    pending_url.clear();
+    pending_scroll = QPoint();
+    pending_start_timeout = -1;
+    pending_idle_timeout = -1;
+}
+
+void NativeBrowser::setLoadTimeouts(int start_msecs, int idle_msecs)
+{
+    load_start_timeout = start_msecs;
+    load_idle_timeout = idle_msecs;
+    if (browser)
+        browser->setLoadTimeouts(start_msecs, idle_msecs);
+}
+
+int NativeBrowser::loadStartTimeout() const
+{
+    return load_start_timeout;
+}
+
+int NativeBrowser::loadIdleTimeout() const
+{
+    return load_idle_timeout;
+}
+
+void NativeBrowser::setNavigationPolicy(const NavigationPolicy &policy)
+{
+    navigation_policy = policy;
+    if (browser)
+        browser->setNavigationPolicy(policy);
+}
+
+NavigationPolicy NativeBrowser::navigationPolicy() const
+{
+    return navigation_policy;
+}
+
+void NativeBrowser::setLifecycleState(LifecycleState state)
+{
+    lifecycle_state = state;
+    if (browser)
+        browser->setLifecycleState(state);
+}
+
+NativeBrowser::LifecycleState NativeBrowser::lifecycleState() const
+{
+    return lifecycle_state;
+}
+
+void NativeBrowser::setAutomaticThrottling(bool enabled)
+{
+    automatic_throttling = enabled;
+    visibilityChanged();
+}
+
+bool NativeBrowser::automaticThrottling() const
+{
+    return automatic_throttling;
+}
+
+void NativeBrowser::setLoadProfile(LoadProfile profile)
+{
+    load_profile = profile;
+    if (browser)
+        browser->setLoadProfile(profile);
+}
+
+NativeBrowser::LoadProfile NativeBrowser::loadProfile() const
+{
+    return load_profile;
+}
+
+void NativeBrowser::setDeduplicateNavigations(bool enabled)
+{
+    deduplicate_navigations = enabled;
+    if (browser)
+        browser->setDeduplicateNavigations(enabled);
+}
+
+bool NativeBrowser::deduplicateNavigations() const
+{
+    return deduplicate_navigations;
+}
+
+void NativeBrowser::setNavigationDebounce(int msecs)
+{
+    navigation_debounce = qMax(0, msecs);
+    if (browser)
+        browser->setNavigationDebounce(navigation_debounce);
+}
+
+int NativeBrowser::navigationDebounce() const
+{
+    return navigation_debounce;
+}
+
+void NativeBrowser::setNavigationFreshness(int msecs)
+{
+    navigation_freshness = qMax(0, msecs);
+    if (browser)
+        browser->setNavigationFreshness(navigation_freshness);
+}
+
+int NativeBrowser::navigationFreshness() const
+{
+    return navigation_freshness;
+}
+
+quint64 NativeBrowser::savedNavigations() const
+{
+    return browser ? browser->savedNavigations() : 0;
+}
+
+qint64 NativeBrowser::cpuTime() const
+{
+    return browser ? browser->cpuTime() : 0;
+}
+
+void NativeBrowser::visibilityChanged()
+{
+    bool shown = isVisible() && !window()->isMinimized();
+    // a restored window shows its children without show events
+    if (shown && discarded)
+        backend();
+    if (browser)
+        NativeBrowserGovernor::instance()->visibilityChanged(this, shown);
+    if (!automatic_throttling)
+        return;
+    // an explicitly frozen browser stays frozen while hidden
+    if (shown)
+        setLifecycleState(Active);
+    else if (lifecycle_state == Active)
+        setLifecycleState(Throttled);
+}
+
+bool NativeBrowser::canDiscardBackend() const
+{
+    // a document from memory could not be loaded again, location() is not
+    // yet the page a running navigation goes to
+    return browser && !browser->showsHtml() && !browser->isNavigating();
+}
+
+void NativeBrowser::discardBackend()
+{
+    // replayed by backend() like a load made before the first show
+    pending_url = browser->location();
+    has_pending_url = true;
+    pending_load_time = -1;
+    pending_scroll = browser->scrollPosition();
+    discarded = true;
+    // the reload of the page finds its entry as the current one
+    history_traversal = NoTraversal;
+
+    NativeBrowserImpl *discarded_backend = browser;
+    browser = 0;
+    NativeBrowserGovernor::instance()->backendDestroyed(this);
+    // not pooled, the point is to give its memory back
+    delete discarded_backend;
+}
+
+void NativeBrowser::setBrowserFeatures(const QMap<QString, quint32> &features)
+{
+    BrowserFeatureControl::setFeatures(features);
+}
+
+QMap<QString, quint32> NativeBrowser::browserFeatures()
+{
+    return BrowserFeatureControl::features();
+}
+
+bool NativeBrowser::registerSchemeHandler(const QString &scheme, SchemeHandler *handler)
+{
+    if (!SchemeHandlers::registerHandler(scheme, handler))
+        return false;
+    if (handler)
+        NativeBrowserImpl::registerScheme(scheme.toLower());
+    return true;
+}
+
+bool NativeBrowser::setRequestBlocklist(const QString &compiled_file)
+{
+    return NativeBrowserImpl::setRequestBlocklist(compiled_file);
+}
+
+int NativeBrowser::requestBlocklistRules()
+{
+    return NativeBrowserImpl::requestBlocklistRules();
+}
+
+quint64 NativeBrowser::checkedRequests() const
+{
+    return browser ? browser->checkedRequests() : 0;
+}
+
+quint64 NativeBrowser::blockedRequests() const
+{
+    return browser ? browser->blockedRequests() : 0;
+}
+
+QList<NavigationHistoryEntry> NativeBrowser::history() const
+{
+    return navigation_history.entries();
+}
+
+int NativeBrowser::historyIndex() const
+{
+    return navigation_history.currentIndex();
+}
+
+bool NativeBrowser::canGoBack() const
+{
+    return navigation_history.canGoBack();
+}
+
+bool NativeBrowser::canGoForward() const
+{
+    return navigation_history.canGoForward();
+}
+
+void NativeBrowser::setHistorySize(int entries)
+{
+    navigation_history.setMaximumCount(entries);
+}
+
+int NativeBrowser::historySize() const
+{
+    return navigation_history.maximumCount();
+}
+
+void NativeBrowser::setHistorySnapshotBudget(qint64 bytes)
+{
+    navigation_history.setSnapshotBudget(bytes);
+}
+
+qint64 NativeBrowser::historySnapshotBudget() const
+{
+    return navigation_history.snapshotBudget();
+}
+
+void NativeBrowser::back()
+{
+    goToHistoryIndex(navigation_history.currentIndex() - 1);
+}
+
+void NativeBrowser::forward()
+{
+    goToHistoryIndex(navigation_history.currentIndex() + 1);
+}
+
+void NativeBrowser::goToHistoryIndex(int index)
+{
+    if (index < 0 || index >= navigation_history.count() || index == navigation_history.currentIndex())
+        return;
+    supersedeReply();
+    leaveHistoryEntry();
+    navigation_history.setCurrentIndex(index);
+    NavigationHistoryEntry entry = navigation_history.entry(index);
+    QByteArray snapshot = navigation_history.snapshot(index);
+    if (snapshot.isEmpty())
+    {
+        history_traversal = LoadingEntry;
+        startLoad(entry.url, NavigationTiming::now(), NavigationOptions());
+    }
+    else
+    {
+        history_traversal = RestoringSnapshot;
+        startHtml(snapshot, QUrl(entry.url), NavigationTiming::now());
+    }
+    // engines finish asynchronously, the position is applied then
+    browser->restoreScrollPosition(entry.scroll);
+}
+
+void NativeBrowser::revalidateHistoryEntry()
+{
+    if (history_traversal != RevalidatingEntry || !browser)
+        return;
+    history_traversal = LoadingEntry;
+    // the page replaces its snapshot where the user left it
+    browser->restoreScrollPosition(browser->scrollPosition());
+    startLoad(navigation_history.entry(navigation_history.currentIndex()).url, NavigationTiming::now(), NavigationOptions());
+}
+
+void NativeBrowser::updateHistory(const NavigationTiming &timing)
+{
+    if (timing.finished < 0 || !browser)
+        return;
+    if (history_traversal == RestoringSnapshot)
+    {
+        // the snapshot is on screen, the page itself is loaded behind it
+        history_traversal = RevalidatingEntry;
+        QMetaObject::invokeMethod(this, "revalidateHistoryEntry", Qt::QueuedConnection);
+        return;
+    }
+    if (history_traversal == LoadingEntry)
+    {
+        history_traversal = NoTraversal;
+        if (!timing.success)
+            return;
+        navigation_history.setCurrentUrl(browser->location());
+    }
+    else
+    {
+        QString location = browser->location();
+        if (!timing.success || browser->showsHtml() || location.isEmpty() || location == "about:blank")
+            return;
+        navigation_history.push(location);
+    }
+    if (navigation_history.snapshotBudget() > 0)
+        navigation_history.setCurrentSnapshot(browser->documentSnapshot());
+}
+
+void NativeBrowser::leaveHistoryEntry()
+{
+    // a document from setHtml() is not the current entry, unless it is
+    // the entry's snapshot
+    if (browser && (history_traversal != NoTraversal || !browser->showsHtml()))
+        navigation_history.setCurrentScroll(browser->scrollPosition());
+}
+
+QList<NavigationTiming> NativeBrowser::navigationTimingHistory() const
+{
+    return timing_history;
+}
+
+void NativeBrowser::setNavigationTimingHistorySize(int size)
+{
+    timing_history_size = qMax(0, size);
+    while (timing_history.size() > timing_history_size)
+        timing_history.removeFirst();
+}
+
+int NativeBrowser::navigationTimingHistorySize() const
+{
+    return timing_history_size;
+}
+
+void NativeBrowser::supersedeReply()
+{
+    if (!current_reply)
+        return;
+    NavigationReply *reply = current_reply;
+    current_reply = 0;
+    reply->finish(NavigationReply::Cancelled, reply->timing(), url());
+}
+
+void NativeBrowser::cancelNavigation(NavigationReply *reply, NavigationReply::Result result)
+{
+    if (reply != current_reply)
+        return;
+    reply->decided_result = result;
+    if (browser)
+    {
+        // records the timeline, which resolves the reply
+        browser->cancelNavigation();
+    }
+    else
+    {
+        forgetPendingLoad();
+    }
+    supersedeReply();
+}
+
+void NativeBrowser::navigationRedirected(const QString &url, qint64 load_called)
+{
+    if (current_reply && current_reply->loadCalled() == load_called)
+    {
+        current_reply->external_url = url;
+        current_reply->decided_result = NavigationReply::Failed;
+    }
+}
+
+void NativeBrowser::recordNavigationTiming(const NavigationTiming &timing)
+{
+    // before the reply's handler can start the next navigation
+    updateHistory(timing);
+    if (current_reply && timing.load_called == current_reply->loadCalled())
+    {
+        NavigationReply *reply = current_reply;
+        current_reply = 0;
+        NavigationReply::Result result = NavigationReply::Cancelled;
+        if (timing.finished >= 0)
+            result = timing.success ? NavigationReply::Succeeded : NavigationReply::Failed;
+        reply->finish(result, timing, url());
+    }
+    if (timing_history_size > 0)
+    {
+        if (timing_history.size() == timing_history_size)
+            timing_history.removeFirst();
+        timing_history.append(timing);
+    }
+    emit navigationTimings(timing);
+}
+
+void NativeBrowser::invalidateContentSize()
+{
+    if (browser)
+        browser->invalidateContentSize();
 }
 
 void NativeBrowser::loadBlank()
@@ -36,6 +548,80 @@ void NativeBrowser::loadBlank()
 
 void NativeBrowser::resizeEvent(QResizeEvent *e)
 {
-    browser->setSize(e->size());
+    if (!browser)
+        return; // applied when the backend is created
+    browser->resize(e->size());
+}
+
+void NativeBrowser::screenChanged()
+{
+    if (browser)
+        browser->screenChanged();
 }
 
+void NativeBrowser::showEvent(QShowEvent *e)
+{
+    QWidget::showEvent(e);
+    // minimizing only changes the state of the top-level window
+    if (window() != this)
+        window()->installEventFilter(this);
+    // the engine's extent depends on the resolution of the screen
+    if (window()->windowHandle())
+        connect(window()->windowHandle(), SIGNAL(screenChanged(QScreen*)), this, SLOT(screenChanged()), Qt::UniqueConnection);
+    backend();
+    visibilityChanged();
+}
+
+void NativeBrowser::hideEvent(QHideEvent *e)
+{
+    QWidget::hideEvent(e);
+    visibilityChanged();
+}
+
+bool NativeBrowser::eventFilter(QObject *watched, QEvent *event)
+{
+    if (event->type() == QEvent::WindowStateChange && watched == window())
+        visibilityChanged();
+    return QWidget::eventFilter(watched, event);
+}
+
+void NativeBrowser::changeEvent(QEvent *e)
+{
+    QWidget::changeEvent(e);
+    if (e->type() == QEvent::WindowStateChange)
+        visibilityChanged();
+}
+
+NativeBrowserImpl *NativeBrowser::backend()
+{
+    if (!browser)
+    {
+        browser = NativeBrowserImpl::createNewInstance(this);
+        browser->setLoadTimeouts(load_start_timeout, load_idle_timeout);
+        browser->setNavigationPolicy(navigation_policy);
+        browser->setLifecycleState(lifecycle_state);
+        // pooled backends may come with another browser's profile
+        browser->setLoadProfile(load_profile);
+        browser->setDeduplicateNavigations(deduplicate_navigations);
+        browser->setNavigationDebounce(navigation_debounce);
+        browser->setNavigationFreshness(navigation_freshness);
+        browser->resize(size());
+        NativeBrowserGovernor::instance()->backendCreated(this, discarded);
+        discarded = false;
+        if (!pending_scroll.isNull())
+        {
+            browser->restoreScrollPosition(pending_scroll);
+            pending_scroll = QPoint();
+        }
+        if (has_pending_url)
+        {
+            has_pending_url = false;
+            browser->setNavigationTimeouts(pending_start_timeout, pending_idle_timeout);
+            browser->load(pending_url, pending_load_time);
+            pending_start_timeout = -1;
+            pending_idle_timeout = -1;
+            pending_url.clear();
+        }
+    }
+    return browser;
+}
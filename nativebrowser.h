@@ -1,14 +1,41 @@
 #ifndef NATIVEBROWSER_H
 #define NATIVEBROWSER_H
 
+#include <QByteArray>
+#include <QList>
+#include <QMap>
+#include <QPoint>
+#include <QPointer>
+#include <QUrl>
 #include <QWidget>
 
+#include "navigationhistory.h"
+#include "navigationpolicy.h"
+#include "navigationreply.h"
+#include "navigationtiming.h"
+
 class NativeBrowserImpl;
+class SchemeHandler;
 
 class NativeBrowser : public QWidget
 {
     Q_OBJECT
 public:
+    enum LifecycleState
+    {
+        Active,    // the engine runs at full speed
+        Throttled, // not painted, timers and progress updates slowed down
+        Frozen     // script and animations stopped too, as far as the engine allows
+    };
+
+    enum LoadProfile
+    {
+        Full,          // everything the page asks for
+        NoImages,      // text, layout and script
+        NoScript,      // text, layout and images
+        StaticSnapshot // text and layout only
+    };
+
     explicit NativeBrowser(QWidget *parent = 0);
     virtual ~NativeBrowser();
 
@@ -18,25 +45,211 @@ public:
 
     QSize sizeHint() const override;
 
+    // loads url like load() and reports how it ended through the returned
+    // reply, which deletes itself after finished(); any later navigation
+    // cancels it
+    NavigationReply *navigate(const QString &url, const NavigationOptions &options = NavigationOptions());
+
+    // false until the browser is first shown or loads something, the engine
+    // is created lazily, and after NativeBrowserGovernor discarded it
+    bool hasBackend() const;
+    // the backend was discarded while hidden, showing the browser reloads
+    // its page
+    bool isDiscarded() const;
+
+    // engine progress events received vs. loadProgress signals emitted,
+    // the difference was collapsed into per-frame updates
+    quint64 rawProgressEvents() const;
+    quint64 emittedProgressEvents() const;
+
+    // resize events received vs. applied to the engine, the difference was
+    // collapsed into per-frame resizes
+    quint64 appliedResizes() const;
+    quint64 droppedResizes() const;
+
+    // completion is taken from the engine's events, these are fallbacks for
+    // an engine that goes silent: a load fails when it shows no activity for
+    // start_msecs after it was handed to the engine, started or not, and is
+    // considered finished when it stays silent for idle_msecs after
+    // activity was seen. 0 disables a timeout.
+    void setLoadTimeouts(int start_msecs, int idle_msecs);
+    int loadStartTimeout() const;
+    int loadIdleTimeout() const;
+
+    // decides which links the engine follows and which go to externalNavigate,
+    // by default only links to the host of the current page are followed
+    void setNavigationPolicy(const NavigationPolicy &policy);
+    NavigationPolicy navigationPolicy() const;
+
+    // how much the engine may run; set explicitly, or by automatic
+    // throttling, which makes a hidden or minimized browser Throttled and
+    // Active again when it is shown
+    void setLifecycleState(LifecycleState state);
+    LifecycleState lifecycleState() const;
+    void setAutomaticThrottling(bool enabled);
+    bool automaticThrottling() const;
+
+    // what the engine downloads and runs, from the next navigation on; all
+    // but Full also disable plug-ins and CSS animations and transitions
+    void setLoadProfile(LoadProfile profile);
+    LoadProfile loadProfile() const;
+
+    // load() and navigate() of the URL already being loaded join that
+    // navigation instead of restarting it
+    void setDeduplicateNavigations(bool enabled);
+    bool deduplicateNavigations() const;
+    // of loads requested less than msecs apart only the last one reaches
+    // the engine, once msecs passed without another; 0 disables it
+    void setNavigationDebounce(int msecs);
+    int navigationDebounce() const;
+    // a load of the URL that finished loading less than msecs ago completes
+    // right away with the document on screen; 0 disables it
+    void setNavigationFreshness(int msecs);
+    int navigationFreshness() const;
+    // requests answered by one of the above without an engine navigation
+    quint64 savedNavigations() const;
+
+    // GUI-thread CPU time this browser's engine used in calls, events and
+    // painting, in nanoseconds
+    qint64 cpuTime() const;
+
+    // engine feature control settings (FEATURE_* name -> value) applied
+    // once per process; call before the first browser is created to
+    // replace the built-in set. Only the Windows engine uses them.
+    static void setBrowserFeatures(const QMap<QString, quint32> &features);
+    static QMap<QString, quint32> browserFeatures();
+
+    // serves scheme:// documents and assets from handler in every browser,
+    // e.g. "app" with a ResourceSchemeHandler; the handler must outlive the
+    // browsers, 0 removes it. False for schemes the engine handles itself.
+    static bool registerSchemeHandler(const QString &scheme, SchemeHandler *handler);
+
+    // blocks subresources and subframes listed in a file compiled with
+    // nativebrowser_blocklistc, for every browser; an empty name disables it
+    static bool setRequestBlocklist(const QString &compiled_file);
+    static int requestBlocklistRules();
+
+    // requests checked against the blocklist and blocked by it
+    quint64 checkedRequests() const;
+    quint64 blockedRequests() const;
+
+    // pages loaded in this browser, oldest first; load() and the page's own
+    // navigations add an entry, setHtml() does not
+    QList<NavigationHistoryEntry> history() const;
+    // the entry shown, -1 for none
+    int historyIndex() const;
+    bool canGoBack() const;
+    bool canGoForward() const;
+    // maximum entries kept, the oldest ones are dropped (default: 50)
+    void setHistorySize(int entries);
+    int historySize() const;
+    // bytes of serialized documents kept for history entries, 0 disables
+    // the cache (default); going to an entry with one shows it at once and
+    // loads the page behind it
+    void setHistorySnapshotBudget(qint64 bytes);
+    qint64 historySnapshotBudget() const;
+
+    // timelines of the last navigationTimingHistorySize() navigations, oldest first
+    QList<NavigationTiming> navigationTimingHistory() const;
+    void setNavigationTimingHistorySize(int size);
+    int navigationTimingHistorySize() const;
+
 signals:
     void loadStarted();
     void loadProgress(int progress);
     void loadFinished(bool ok);
 
+    // the document size reported by sizeHint() changed
+    void contentSizeChanged(const QSize &size);
+
     void externalNavigate(const QString &url);
 
+    // emitted when a navigation finished or was superseded by the next one
+    void navigationTimings(const NavigationTiming &timing);
+
 public slots:
     void load(const QString &url);
+    // shows html straight from memory, the bytes go to the engine as they
+    // are (declare the charset in the document); relative URLs and the
+    // navigation policy's $current use baseUrl
+    void setHtml(const QByteArray &html, const QUrl &baseUrl = QUrl());
+
+    // previous or next history entry, from its snapshot if it has one
+    void back();
+    void forward();
+    void goToHistoryIndex(int index);
+
+    // re-reads the document size, for pages that change it by themselves
+    void invalidateContentSize();
 
 protected slots:
     void loadBlank();
 
+private slots:
+    void screenChanged();
+    void revalidateHistoryEntry();
+
 protected:
     virtual void resizeEvent(QResizeEvent *) override;
+    virtual void showEvent(QShowEvent *) override;
+    virtual void hideEvent(QHideEvent *) override;
+    virtual void changeEvent(QEvent *) override;
+    virtual bool eventFilter(QObject *watched, QEvent *event) override;
 
 private:
+    NativeBrowserImpl *backend();
+    // the load_called of the navigation that serves the request
+    qint64 startLoad(const QString &url, qint64 load_called, const NavigationOptions &options);
+    void startHtml(const QByteArray &html, const QUrl &baseUrl, qint64 load_called);
+    void forgetPendingLoad();
+    void recordNavigationTiming(const NavigationTiming &timing);
+    // adds or updates the history entry of a finished navigation
+    void updateHistory(const NavigationTiming &timing);
+    // remembers where the current entry was scrolled before it is left
+    void leaveHistoryEntry();
+    // the reply of the current navigation, if any, resolves as superseded
+    void supersedeReply();
+    void cancelNavigation(NavigationReply *reply, NavigationReply::Result result);
+    // the engine handed the requested page to externalNavigate
+    void navigationRedirected(const QString &url, qint64 load_called);
+    // shown or hidden, by itself or by its window
+    void visibilityChanged();
+    bool canDiscardBackend() const;
+    void discardBackend();
+
+    friend class NativeBrowserGovernor;
     friend class NativeBrowserImpl;
+    friend class NavigationReply;
     NativeBrowserImpl *browser;
+    QString pending_url;
+    bool has_pending_url;
+    qint64 pending_load_time;
+    QPoint pending_scroll;
+    int pending_start_timeout;
+    int pending_idle_timeout;
+    bool discarded;
+    QPointer<NavigationReply> current_reply;
+    int load_start_timeout;
+    int load_idle_timeout;
+    NavigationPolicy navigation_policy;
+    LifecycleState lifecycle_state;
+    bool automatic_throttling;
+    LoadProfile load_profile;
+    bool deduplicate_navigations;
+    int navigation_debounce;
+    int navigation_freshness;
+    NavigationHistory navigation_history;
+    // how the navigation in flight moves through the history
+    enum HistoryTraversal
+    {
+        NoTraversal,       // a new page, pushed when it finished
+        RestoringSnapshot, // an entry shown from its snapshot
+        RevalidatingEntry, // the snapshot is shown, its page loads next
+        LoadingEntry       // an entry loaded from its URL
+    };
+    HistoryTraversal history_traversal;
+    QList<NavigationTiming> timing_history;
+    int timing_history_size;
 };
 
 #endif // NATIVEBROWSER_H
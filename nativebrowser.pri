@@ -1,10 +1,29 @@
-QT      *= core gui widgets
+QT      *= core gui widgets network
 
 CONFIG  *= c++11
 
 SOURCES +=  \
+    $$PWD/browserfeaturecontrol.cpp \
+    $$PWD/cpuclock.cpp \
+    $$PWD/enginetrace.cpp \
+    $$PWD/enginetracereplay.cpp \
+    $$PWD/eventlog.cpp \
+    $$PWD/loadscheduler.cpp \
     $$PWD/nativebrowser.cpp \
-    $$PWD/nativebrowserimpl.cpp
+    $$PWD/nativebrowsergovernor.cpp \
+    $$PWD/nativebrowserimpl.cpp \
+    $$PWD/nativebrowsermetrics.cpp \
+    $$PWD/nativebrowserpool.cpp \
+    $$PWD/navigationhistory.cpp \
+    $$PWD/navigationpolicy.cpp \
+    $$PWD/navigationreply.cpp \
+    $$PWD/navigationstatemachine.cpp \
+    $$PWD/navigationtiming.cpp \
+    $$PWD/progresscoalescer.cpp \
+    $$PWD/requestblocklist.cpp \
+    $$PWD/resizecoalescer.cpp \
+    $$PWD/resourceschemehandler.cpp \
+    $$PWD/schemehandler.cpp
 
 win32:SOURCES += \
     $$PWD/nativebrowserimpl_win.cpp
@@ -12,9 +31,31 @@ win32:SOURCES += \
 macx:OBJECTIVE_SOURCES += \
     $$PWD/nativebrowserimpl_mac.mm
 
-win32:LIBS *= -lOle32 -lOleAut32 -lGdi32
+unix:!macx:SOURCES += \
+    $$PWD/nativebrowserimpl_linux.cpp
+
+win32:LIBS *= -lOle32 -lOleAut32 -lGdi32 -lUrlmon -lComctl32 -lPsapi
  macx:LIBS += -framework WebKit -framework Foundation
 
 HEADERS += \
+    $$PWD/browserfeaturecontrol.h \
+    $$PWD/cpuclock.h \
+    $$PWD/enginetrace.h \
+    $$PWD/enginetracereplay.h \
+    $$PWD/eventlog.h \
+    $$PWD/loadscheduler.h \
     $$PWD/nativebrowser.h \
-    $$PWD/nativebrowserimpl.h
+    $$PWD/nativebrowsergovernor.h \
+    $$PWD/nativebrowserimpl.h \
+    $$PWD/nativebrowsermetrics.h \
+    $$PWD/nativebrowserpool.h \
+    $$PWD/navigationhistory.h \
+    $$PWD/navigationpolicy.h \
+    $$PWD/navigationreply.h \
+    $$PWD/navigationstatemachine.h \
+    $$PWD/navigationtiming.h \
+    $$PWD/progresscoalescer.h \
+    $$PWD/requestblocklist.h \
+    $$PWD/resizecoalescer.h \
+    $$PWD/resourceschemehandler.h \
+    $$PWD/schemehandler.h
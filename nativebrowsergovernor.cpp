@@ -0,0 +1,247 @@
+#include "nativebrowsergovernor.h"
+
+#include <QCoreApplication>
+#include <QMetaObject>
+#include <QTimer>
+
+#if defined(Q_OS_WIN)
+#include <Windows.h>
+#include <Psapi.h>
+#elif defined(Q_OS_MAC)
+#include <mach/mach.h>
+#else
+#include <QFile>
+#include <unistd.h>
+#endif
+
+#include "nativebrowser.h"
+#include "navigationtiming.h"
+
+namespace {
+
+// reset by the destructor, the governor goes with the application
+static NativeBrowserGovernor *governor = 0;
+
+} // anonymous
+
+NativeBrowserGovernor *NativeBrowserGovernor::instance()
+{
+    if (!governor)
+    {
+        governor = new NativeBrowserGovernor(QCoreApplication::instance());
+    }
+    return governor;
+}
+
+NativeBrowserGovernor::NativeBrowserGovernor(QObject *parent)
+    : QObject(parent)
+    , check_timer(new QTimer(this))
+    , maximum_backends(0)
+    , memory_budget(0)
+    , minimum_hidden_time(5 * 60 * 1000)
+    , discarded_count(0)
+    , restored_count(0)
+{
+    check_timer->setInterval(10 * 1000);
+    connect(check_timer, SIGNAL(timeout()), this, SLOT(check()));
+}
+
+NativeBrowserGovernor::~NativeBrowserGovernor()
+{
+    if (governor == this)
+        governor = 0;
+}
+
+void NativeBrowserGovernor::setMaximumBackends(int count)
+{
+    maximum_backends = qMax(0, count);
+    updateTimer();
+}
+
+int NativeBrowserGovernor::maximumBackends() const
+{
+    return maximum_backends;
+}
+
+void NativeBrowserGovernor::setMemoryBudget(qint64 bytes)
+{
+    memory_budget = qMax(Q_INT64_C(0), bytes);
+    updateTimer();
+}
+
+qint64 NativeBrowserGovernor::memoryBudget() const
+{
+    return memory_budget;
+}
+
+void NativeBrowserGovernor::setMinimumHiddenTime(int msecs)
+{
+    minimum_hidden_time = qMax(0, msecs);
+}
+
+int NativeBrowserGovernor::minimumHiddenTime() const
+{
+    return minimum_hidden_time;
+}
+
+void NativeBrowserGovernor::setCheckInterval(int msecs)
+{
+    check_timer->setInterval(qMax(1, msecs));
+}
+
+int NativeBrowserGovernor::checkInterval() const
+{
+    return check_timer->interval();
+}
+
+int NativeBrowserGovernor::liveBackends() const
+{
+    return entries.size();
+}
+
+quint64 NativeBrowserGovernor::discardedCount() const
+{
+    return discarded_count;
+}
+
+quint64 NativeBrowserGovernor::restoredCount() const
+{
+    return restored_count;
+}
+
+qint64 NativeBrowserGovernor::processMemory()
+{
+#if defined(Q_OS_WIN)
+    PROCESS_MEMORY_COUNTERS counters;
+    if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+        return 0;
+    return qint64(counters.WorkingSetSize);
+#elif defined(Q_OS_MAC)
+    mach_task_basic_info_data_t info;
+    mach_msg_type_number_t count = MACH_TASK_BASIC_INFO_COUNT;
+    if (task_info(mach_task_self(), MACH_TASK_BASIC_INFO, reinterpret_cast<task_info_t>(&info), &count) != KERN_SUCCESS)
+        return 0;
+    return qint64(info.resident_size);
+#else
+    // second field of statm: resident pages
+    QFile statm("/proc/self/statm");
+    if (!statm.open(QIODevice::ReadOnly))
+        return 0;
+    QList<QByteArray> fields = statm.readAll().split(' ');
+    if (fields.size() < 2)
+        return 0;
+    return fields.at(1).toLongLong() * sysconf(_SC_PAGESIZE);
+#endif
+}
+
+void NativeBrowserGovernor::check()
+{
+    if (!enabled())
+        return;
+    while (maximum_backends > 0 && entries.size() > maximum_backends)
+    {
+        int candidate = nextCandidate();
+        if (candidate < 0)
+            break;
+        discard(candidate);
+    }
+    if (memory_budget > 0 && processMemory() > memory_budget)
+    {
+        // memory is only returned to the system over time, the next check
+        // sees whether one was enough
+        int candidate = nextCandidate();
+        if (candidate >= 0)
+            discard(candidate);
+    }
+}
+
+void NativeBrowserGovernor::discard(int index)
+{
+    NativeBrowser *browser = entries.at(index).browser;
+    // takes the entry out through backendDestroyed()
+    browser->discardBackend();
+    ++discarded_count;
+    emit discarded(browser);
+}
+
+void NativeBrowserGovernor::backendCreated(NativeBrowser *browser, bool restored)
+{
+    if (indexOf(browser) < 0)
+    {
+        Entry entry;
+        entry.browser = browser;
+        entry.hidden_since = browser->isVisible() ? -1 : NavigationTiming::now();
+        entries.append(entry);
+    }
+    if (restored)
+    {
+        ++restored_count;
+        emit this->restored(browser);
+    }
+    updateTimer();
+}
+
+void NativeBrowserGovernor::backendDestroyed(NativeBrowser *browser)
+{
+    int index = indexOf(browser);
+    if (index >= 0)
+        entries.removeAt(index);
+    updateTimer();
+}
+
+void NativeBrowserGovernor::visibilityChanged(NativeBrowser *browser, bool visible)
+{
+    int index = indexOf(browser);
+    if (index < 0)
+        return;
+    Entry &entry = entries[index];
+    if (visible)
+    {
+        entry.hidden_since = -1;
+    }
+    else if (entry.hidden_since < 0)
+    {
+        entry.hidden_since = NavigationTiming::now();
+        if (enabled() && minimum_hidden_time == 0)
+            QMetaObject::invokeMethod(this, "check", Qt::QueuedConnection);
+    }
+}
+
+bool NativeBrowserGovernor::enabled() const
+{
+    return maximum_backends > 0 || memory_budget > 0;
+}
+
+int NativeBrowserGovernor::indexOf(NativeBrowser *browser) const
+{
+    for (int i = 0; i < entries.size(); ++i)
+    {
+        if (entries.at(i).browser == browser)
+            return i;
+    }
+    return -1;
+}
+
+int NativeBrowserGovernor::nextCandidate() const
+{
+    qint64 hidden_before = NavigationTiming::now() - qint64(minimum_hidden_time) * 1000000;
+    int candidate = -1;
+    for (int i = 0; i < entries.size(); ++i)
+    {
+        const Entry &entry = entries.at(i);
+        if (entry.hidden_since < 0 || entry.hidden_since > hidden_before || !entry.browser->canDiscardBackend())
+            continue;
+        if (candidate < 0 || entry.hidden_since < entries.at(candidate).hidden_since)
+            candidate = i;
+    }
+    return candidate;
+}
+
+void NativeBrowserGovernor::updateTimer()
+{
+    bool needed = enabled() && !entries.isEmpty();
+    if (needed && !check_timer->isActive())
+        check_timer->start();
+    else if (!needed)
+        check_timer->stop();
+}
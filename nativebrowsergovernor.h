@@ -0,0 +1,88 @@
+#ifndef NATIVEBROWSERGOVERNOR_H
+#define NATIVEBROWSERGOVERNOR_H
+
+#include <QList>
+#include <QObject>
+
+class NativeBrowser;
+class QTimer;
+
+// Caps the engine instances kept alive for hidden browsers. When there are
+// more live backends than allowed, or the process uses more memory than
+// allowed, the backends of browsers hidden for at least minimumHiddenTime()
+// are destroyed, the longest hidden first. The browser keeps its URL and
+// scroll position and gets a new backend, reloading the page, when it is
+// shown again. Browsers showing a document from memory (setHtml) are
+// never discarded. Disabled until a budget is set.
+class NativeBrowserGovernor : public QObject
+{
+    Q_OBJECT
+    Q_DISABLE_COPY(NativeBrowserGovernor)
+public:
+    static NativeBrowserGovernor *instance();
+
+    // live backends allowed, 0 for no limit
+    void setMaximumBackends(int count);
+    int maximumBackends() const;
+
+    // process memory (working set / resident size) allowed, in bytes, 0 for
+    // no limit; one backend is discarded per check while it is exceeded
+    void setMemoryBudget(qint64 bytes);
+    qint64 memoryBudget() const;
+
+    // how long a browser has to be hidden before it may be discarded
+    void setMinimumHiddenTime(int msecs);
+    int minimumHiddenTime() const;
+
+    // how often the budgets are checked, hiding a browser checks too
+    void setCheckInterval(int msecs);
+    int checkInterval() const;
+
+    int liveBackends() const;
+    quint64 discardedCount() const;
+    quint64 restoredCount() const;
+
+    static qint64 processMemory();
+
+signals:
+    void discarded(NativeBrowser *browser);
+    void restored(NativeBrowser *browser);
+
+public slots:
+    // discards what the budgets require right away
+    void check();
+
+private:
+    friend class NativeBrowser;
+    explicit NativeBrowserGovernor(QObject *parent = 0);
+    ~NativeBrowserGovernor();
+
+    // called by NativeBrowser as its backend comes and goes and as it is
+    // shown and hidden
+    void backendCreated(NativeBrowser *browser, bool restored);
+    void backendDestroyed(NativeBrowser *browser);
+    void visibilityChanged(NativeBrowser *browser, bool visible);
+
+    bool enabled() const;
+    int indexOf(NativeBrowser *browser) const;
+    // the longest hidden browser that may be discarded, -1 if there is none
+    int nextCandidate() const;
+    void discard(int index);
+    void updateTimer();
+
+    struct Entry
+    {
+        NativeBrowser *browser;
+        qint64 hidden_since; // NavigationTiming::now(), -1 while visible
+    };
+
+    QList<Entry> entries;
+    QTimer *check_timer;
+    int maximum_backends;
+    qint64 memory_budget;
+    int minimum_hidden_time;
+    quint64 discarded_count;
+    quint64 restored_count;
+};
+
+#endif // NATIVEBROWSERGOVERNOR_H
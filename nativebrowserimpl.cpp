@@ -1,33 +1,783 @@
 #include "nativebrowserimpl.h"
 
+#include <QGuiApplication>
 #include <QMetaObject>
-#ifdef Q_OS_WIN
+#include <QMutex>
+#include <QMutexLocker>
+#include <QScreen>
 #include <QTimer>
-#endif
+#include <QUrl>
 
+#include "cpuclock.h"
+#include "eventlog.h"
+#include "loadscheduler.h"
 #include "nativebrowser.h"
+#include "nativebrowsermetrics.h"
+#include "nativebrowserpool.h"
+#include "progresscoalescer.h"
+#include "requestblocklist.h"
+#include "resizecoalescer.h"
+
+namespace {
+
+static NativeBrowserImpl::InstanceFactory instance_factory = 0;
+static quint64 last_navigation_id = 0;
+static quint64 last_instance_id = 0;
+// replaced as a whole, engines check requests on their own threads
+static QSharedPointer<const RequestBlocklist> request_blocklist;
+static QMutex request_blocklist_mutex;
+
+// progress delivery of throttled and frozen browsers, in ms
+static const int throttled_progress_interval = 250;
+static const int frozen_progress_interval = 1000;
+
+// equal after the normalization the engines apply, "host" and "host/" alike
+static bool SameUrl(const QString &a, const QString &b)
+{
+    if (a == b)
+        return true;
+    QUrl::FormattingOptions options = QUrl::StripTrailingSlash | QUrl::NormalizePathSegments;
+    return QUrl::fromUserInput(a).adjusted(options) == QUrl::fromUserInput(b).adjusted(options);
+}
+
+} // anonymous
 
 NativeBrowserImpl::NativeBrowserImpl()
-    : parent_wnd(0)
+    : instance_id(++last_instance_id)
+    , parent_wnd(0)
+    , progress_coalescer(new ProgressCoalescer(this))
+    , resize_coalescer(new ResizeCoalescer(this))
+    , content_size_refresh(new QTimer(this))
+    , navigation_timer(new QTimer(this))
+    , default_start_timeout(0)
+    , default_idle_timeout(0)
+    , next_start_timeout(-1)
+    , next_idle_timeout(-1)
+    , timing_active(false)
+    , trace_recorder(EngineTraceRecorder::create())
+    , checked_requests(0)
+    , blocked_requests(0)
+    , showing_html(false)
+    , lifecycle_state(NativeBrowser::Active)
+    , load_profile(NativeBrowser::Full)
+    , cpu_time(0)
+    , cpu_scope_depth(0)
+    , deduplicate_navigations(false)
+    , debounce_interval(0)
+    , freshness_interval(0)
+    , debounce_timer(new QTimer(this))
+    , fresh_timer(new QTimer(this))
+    , refused_timer(new QTimer(this))
+    , holding(false)
+    , last_request(-1)
+    , fresh_since(-1)
+    , saved_navigations(0)
+    , scheduled_html(false)
+    , replaced(false)
 {
+    // engines report progress far more often than it can be displayed,
+    // deliver it at most once per frame
+    QScreen *screen = QGuiApplication::primaryScreen();
+    if (screen && screen->refreshRate() > 1)
+    {
+        progress_coalescer->setInterval(int(1000 / screen->refreshRate()));
+    }
+    frame_interval = progress_coalescer->interval();
+    resize_coalescer->setInterval(frame_interval);
+    connect(resize_coalescer, SIGNAL(resize(QSize)), this, SLOT(applySize(QSize)));
+    connect(progress_coalescer, SIGNAL(progress(int)), this, SLOT(deliverProgress(int)));
+
+    content_size_refresh->setSingleShot(true);
+    content_size_refresh->setInterval(0);
+    connect(content_size_refresh, SIGNAL(timeout()), this, SLOT(refreshContentSize()));
+
+    default_start_timeout = navigation.startTimeout();
+    default_idle_timeout = navigation.idleTimeout();
+    navigation_timer->setSingleShot(true);
+    connect(navigation_timer, SIGNAL(timeout()), this, SLOT(navigationTimeout()));
 
+    debounce_timer->setSingleShot(true);
+    connect(debounce_timer, SIGNAL(timeout()), this, SLOT(startDebouncedNavigation()));
+    fresh_timer->setSingleShot(true);
+    fresh_timer->setInterval(0);
+    connect(fresh_timer, SIGNAL(timeout()), this, SLOT(finishFreshNavigation()));
+    refused_timer->setSingleShot(true);
+    refused_timer->setInterval(0);
+    connect(refused_timer, SIGNAL(timeout()), this, SLOT(finishRefusedNavigation()));
+
+    NativeBrowserMetrics *metrics = NativeBrowserMetrics::instance();
+    metrics->increment(NativeBrowserMetrics::BackendsCreated);
+    metrics->add(NativeBrowserMetrics::LiveBackends, 1);
+    EventLog::record(EventLog::BackendCreated, instance_id);
 }
 
 NativeBrowserImpl::~NativeBrowserImpl()
 {
-
+    NativeBrowserMetrics::instance()->add(NativeBrowserMetrics::LiveBackends, -1);
+    EventLog::record(EventLog::BackendDestroyed, instance_id);
+    LoadScheduler::instance()->release(this);
+    delete trace_recorder;
 }
 
 NativeBrowserImpl *NativeBrowserImpl::createNewInstance(NativeBrowser *browserwindow)
 {
-    NativeBrowserImpl *result = createNewInstance(browserwindow->winId());
-    result->setParent(browserwindow);
-    result->parent_wnd = browserwindow;
+    // a replaced backend was asked for, pooled ones are platform backends
+    NativeBrowserImpl *result = instance_factory ? 0 : NativeBrowserPool::instance()->acquire();
+    if (result)
+    {
+        result->reparent(browserwindow->winId());
+    }
+    else
+    {
+        result = createDetachedInstance(browserwindow);
+    }
+    result->attach(browserwindow);
+    return result;
+}
+
+void NativeBrowserImpl::releaseInstance(NativeBrowserImpl *instance)
+{
+    if (!NativeBrowserPool::instance()->release(instance))
+    {
+        delete instance;
+    }
+}
+
+NativeBrowserImpl *NativeBrowserImpl::createDetachedInstance(QWidget *host)
+{
+    if (!instance_factory)
+        return createNewInstance(host->winId());
+    NativeBrowserImpl *result = instance_factory(host->winId());
+    result->replaced = true;
     return result;
 }
 
+bool NativeBrowserImpl::hasInstanceFactory()
+{
+    return instance_factory != 0;
+}
+
+void NativeBrowserImpl::attach(NativeBrowser *browserwindow)
+{
+    setParent(browserwindow);
+    parent_wnd = browserwindow;
+    // counters are per browser, a pooled backend starts over
+    checked_requests = 0;
+    blocked_requests = 0;
+    cpu_time = 0;
+    saved_navigations = 0;
+}
+
+void NativeBrowserImpl::detach(QObject *owner, QWidget *host)
+{
+    parent_wnd = 0;
+    // parked backends are hidden, the next browser sets its own state
+    setLifecycleState(NativeBrowser::Throttled);
+    setParent(owner);
+    reparent(host->winId());
+    resize_coalescer->reset();
+    applySize(host->size());
+    content_size = QSize();
+    load("about:blank");
+}
+
+void NativeBrowserImpl::reparent(WId)
+{
+}
+
+bool NativeBrowserImpl::showsHtml() const
+{
+    return showing_html;
+}
+
+bool NativeBrowserImpl::isNavigating() const
+{
+    return holding || timing_active || navigation.state() != NavigationStateMachine::Idle;
+}
+
+QPoint NativeBrowserImpl::scrollPosition() const
+{
+    return QPoint();
+}
+
+void NativeBrowserImpl::setScrollPosition(const QPoint &)
+{
+}
+
+void NativeBrowserImpl::restoreScrollPosition(const QPoint &position)
+{
+    restore_scroll = position;
+}
+
+QByteArray NativeBrowserImpl::documentSnapshot()
+{
+    CpuTimeScope cpu(this);
+    return serializeDocument();
+}
+
+QByteArray NativeBrowserImpl::serializeDocument() const
+{
+    return QByteArray();
+}
+
+void NativeBrowserImpl::applyLifecycleState(NativeBrowser::LifecycleState)
+{
+}
+
+void NativeBrowserImpl::setLifecycleState(NativeBrowser::LifecycleState state)
+{
+    if (state == lifecycle_state)
+        return;
+    lifecycle_state = state;
+    EventLog::record(EventLog::LifecycleChanged, instance_id, qint32(state));
+    switch (state)
+    {
+    case NativeBrowser::Active:
+        progress_coalescer->setInterval(frame_interval);
+        break;
+    case NativeBrowser::Throttled:
+        progress_coalescer->setInterval(throttled_progress_interval);
+        break;
+    case NativeBrowser::Frozen:
+        progress_coalescer->setInterval(frozen_progress_interval);
+        break;
+    }
+    CpuTimeScope cpu(this);
+    applyLifecycleState(state);
+}
+
+NativeBrowser::LifecycleState NativeBrowserImpl::lifecycleState() const
+{
+    return lifecycle_state;
+}
+
+void NativeBrowserImpl::applyLoadProfile(NativeBrowser::LoadProfile)
+{
+}
+
+void NativeBrowserImpl::setLoadProfile(NativeBrowser::LoadProfile profile)
+{
+    if (profile == load_profile)
+        return;
+    load_profile = profile;
+    EventLog::record(EventLog::LoadProfileChanged, instance_id, qint32(profile));
+    CpuTimeScope cpu(this);
+    applyLoadProfile(profile);
+}
+
+NativeBrowser::LoadProfile NativeBrowserImpl::loadProfile() const
+{
+    return load_profile;
+}
+
+int NativeBrowserImpl::loadFeatures(NativeBrowser::LoadProfile profile)
+{
+    switch (profile)
+    {
+    case NativeBrowser::NoImages:
+        return LoadScripts;
+    case NativeBrowser::NoScript:
+        return LoadImages;
+    case NativeBrowser::StaticSnapshot:
+        return 0;
+    default:
+        return LoadImages | LoadScripts | LoadPlugins | LoadAnimations;
+    }
+}
+
+QString NativeBrowserImpl::profileStyleSheet(NativeBrowser::LoadProfile profile)
+{
+    if (loadFeatures(profile) & LoadAnimations)
+        return QString();
+    return QStringLiteral("*,*:before,*:after{animation:none!important;transition:none!important;}");
+}
+
+qint64 NativeBrowserImpl::cpuTime() const
+{
+    return cpu_time;
+}
+
+quint64 NativeBrowserImpl::instanceId() const
+{
+    return instance_id;
+}
+
+void NativeBrowserImpl::setDeduplicateNavigations(bool enabled)
+{
+    deduplicate_navigations = enabled;
+}
+
+void NativeBrowserImpl::setNavigationDebounce(int msecs)
+{
+    debounce_interval = qMax(0, msecs);
+    if (debounce_interval == 0 && holding)
+        startDebouncedNavigation();
+}
+
+void NativeBrowserImpl::setNavigationFreshness(int msecs)
+{
+    freshness_interval = qMax(0, msecs);
+}
+
+quint64 NativeBrowserImpl::savedNavigations() const
+{
+    return saved_navigations;
+}
+
+void NativeBrowserImpl::startDebouncedNavigation()
+{
+    if (!holding)
+        return;
+    holding = false;
+    debounce_timer->stop();
+    scheduleNavigation(true, false);
+}
+
+void NativeBrowserImpl::finishFreshNavigation()
+{
+    if (!timing_active || navigation.state() != NavigationStateMachine::Idle)
+        return;
+    timing_active = false;
+    timing.finished = NavigationTiming::now();
+    timing.success = true;
+    if (!parent_wnd)
+        return;
+    // the browser sees a load that finished right away
+    emit parent_wnd->loadStarted();
+    parent_wnd->recordNavigationTiming(timing);
+    emit parent_wnd->loadFinished(true);
+}
+
+void NativeBrowserImpl::finishRefusedNavigation()
+{
+    applyNavigationActions(navigation.refused());
+}
+
+bool NativeBrowserImpl::isPendingNavigation(const QString &url) const
+{
+    if (!timing_active || timing.load_called < 0 || scheduled_html
+            || navigation.state() == NavigationStateMachine::Idle)
+        return false;
+    return SameUrl(url, scheduled_url);
+}
+
+bool NativeBrowserImpl::isFresh(const QString &url) const
+{
+    if (freshness_interval == 0 || fresh_since < 0 || showing_html || timing_active
+            || navigation.state() != NavigationStateMachine::Idle)
+        return false;
+    if (NavigationTiming::now() - fresh_since >= qint64(freshness_interval) * 1000000)
+        return false;
+    // the requested URL or where it redirected to
+    return SameUrl(url, fresh_url) || SameUrl(url, location());
+}
+
+void NativeBrowserImpl::saveNavigation(int reason)
+{
+    ++saved_navigations;
+    NativeBrowserMetrics::instance()->increment(NativeBrowserMetrics::NavigationsSaved);
+    EventLog::record(EventLog::NavigationSaved, instance_id, reason);
+}
+
+NativeBrowserImpl::CpuTimeScope::CpuTimeScope(NativeBrowserImpl *backend)
+    : backend(backend)
+    , started(backend->cpu_scope_depth++ == 0 ? CpuClock::threadTime() : -1)
+{
+}
+
+NativeBrowserImpl::CpuTimeScope::~CpuTimeScope()
+{
+    --backend->cpu_scope_depth;
+    if (started < 0)
+        return;
+    qint64 used = CpuClock::threadTime() - started;
+    backend->cpu_time += used;
+    NativeBrowserMetrics::instance()->increment(NativeBrowserMetrics::EngineCpuTime, quint64(qMax(Q_INT64_C(0), used)));
+}
+
+void NativeBrowserImpl::setInstanceFactory(InstanceFactory factory)
+{
+    instance_factory = factory;
+}
+
+qint64 NativeBrowserImpl::load(const QString &url, qint64 requested_at)
+{
+    traceEvent(EngineTraceEvent::Load, url);
+    if (deduplicate_navigations && isPendingNavigation(url))
+    {
+        next_start_timeout = -1;
+        next_idle_timeout = -1;
+        saveNavigation(EventLog::SavedCollapsed);
+        return timing.load_called;
+    }
+    if (isFresh(url))
+    {
+        next_start_timeout = -1;
+        next_idle_timeout = -1;
+        // superseding nothing, the document on screen is the answer
+        beginTiming(url);
+        timing.load_called = requested_at < 0 ? NavigationTiming::now() : requested_at;
+        saveNavigation(EventLog::SavedFresh);
+        fresh_timer->start();
+        return timing.load_called;
+    }
+    bool was_loading = beginNavigation(url, QUrl::fromUserInput(url.isEmpty() ? QString("about:blank") : url).host(), requested_at);
+    showing_html = false;
+    scheduled_url = url;
+    scheduled_html = false;
+    scheduled_document.clear();
+    scheduled_base_url.clear();
+    bool needs_slot = !url.isEmpty() && url != "about:blank";
+    qint64 previous_request = last_request;
+    last_request = timing.load_called;
+    if (needs_slot && parent_wnd && debounce_interval > 0 && previous_request >= 0
+            && timing.load_called - previous_request < qint64(debounce_interval) * 1000000)
+    {
+        // part of a burst, only its last request reaches the engine
+        if (was_loading)
+            stop();
+        LoadScheduler::instance()->release(this);
+        // the start timeout runs once the engine has the navigation
+        navigation_timer->stop();
+        holding = true;
+        debounce_timer->start(debounce_interval);
+        return timing.load_called;
+    }
+    scheduleNavigation(needs_slot, was_loading);
+    return timing.load_called;
+}
+
+void NativeBrowserImpl::setHtml(const QByteArray &html, const QUrl &base_url, qint64 requested_at)
+{
+    bool was_loading = beginNavigation(base_url.isEmpty() ? QString("about:blank") : base_url.toString(), base_url.host(), requested_at);
+    // links are relative to base_url, not to where the engine says it is
+    showing_html = true;
+    scheduled_base_url = base_url;
+    scheduled_html = true;
+    scheduled_document = html;
+    scheduleNavigation(true, was_loading);
+}
+
+void NativeBrowserImpl::scheduleNavigation(bool needs_slot, bool was_loading)
+{
+    LoadScheduler *scheduler = LoadScheduler::instance();
+    if (!needs_slot || !parent_wnd)
+    {
+        scheduler->release(this);
+    }
+    else if (!scheduler->request(this, parent_wnd))
+    {
+        // the superseded load would otherwise keep its connections while
+        // this one waits
+        if (was_loading)
+            stop();
+        navigation_timer->stop();
+        return;
+    }
+    startScheduledNavigation();
+}
+
+void NativeBrowserImpl::startScheduledNavigation()
+{
+    timing.navigate_issued = NavigationTiming::now();
+    // counted from here, not from the wait for a slot or the end of a burst
+    if (navigation.state() == NavigationStateMachine::Requested && navigation.startTimeout() > 0)
+        navigation_timer->start(navigation.startTimeout());
+    if (timing.load_called >= 0)
+        NativeBrowserMetrics::instance()->observe(NativeBrowserMetrics::QueueWait, timing.navigate_issued - timing.load_called);
+    CpuTimeScope cpu(this);
+    if (scheduled_html)
+    {
+        QByteArray html = scheduled_document;
+        scheduled_document.clear();
+        navigateToHtml(html, scheduled_base_url);
+    }
+    else
+    {
+        navigate(scheduled_url);
+    }
+}
+
+void NativeBrowserImpl::navigateToHtml(const QByteArray &html, const QUrl &)
+{
+    // engines that cannot take a document from memory get a data: URL
+    navigate(QString("data:text/html;charset=utf-8;base64,") + QString::fromLatin1(html.toBase64()));
+}
+
+bool NativeBrowserImpl::beginNavigation(const QString &url, const QString &host, qint64 requested_at)
+{
+    qint64 called = requested_at < 0 ? NavigationTiming::now() : requested_at;
+    bool was_loading = navigation.isLoading();
+    if (holding)
+    {
+        // the held request of a burst is replaced without reaching the engine
+        holding = false;
+        debounce_timer->stop();
+        saveNavigation(EventLog::SavedDebounced);
+    }
+    fresh_timer->stop();
+    refused_timer->stop();
+    NativeBrowserMetrics::instance()->increment(NativeBrowserMetrics::NavigationsRequested);
+    EventLog::record(EventLog::NavigationRequested, instance_id, url);
+    navigation_host = host;
+    // timeouts of a single navigate() do not outlive it
+    navigation.setTimeouts(next_start_timeout < 0 ? default_start_timeout : next_start_timeout,
+                           next_idle_timeout < 0 ? default_idle_timeout : next_idle_timeout);
+    next_start_timeout = -1;
+    next_idle_timeout = -1;
+    applyNavigationActions(navigation.requested());
+    // a navigation still in flight is superseded
+    recordTiming(false);
+    beginTiming(url);
+    timing.load_called = called;
+    return was_loading;
+}
+
+void NativeBrowserImpl::resize(const QSize &size)
+{
+    resize_coalescer->post(size);
+}
+
+void NativeBrowserImpl::screenChanged()
+{
+    // a pending size is newer than the applied one
+    resize_coalescer->flush();
+    if (!engine_size.isValid())
+        return;
+    resize_coalescer->reset();
+    resize_coalescer->post(engine_size);
+}
+
+quint64 NativeBrowserImpl::appliedResizes() const
+{
+    return resize_coalescer->appliedEvents();
+}
+
+quint64 NativeBrowserImpl::droppedResizes() const
+{
+    return resize_coalescer->droppedEvents();
+}
+
+void NativeBrowserImpl::applySize(const QSize &size)
+{
+    engine_size = size;
+    {
+        CpuTimeScope cpu(this);
+        setSize(size);
+    }
+    // the document reflows to the new width
+    invalidateContentSize();
+}
+
+QSize NativeBrowserImpl::sizeHint() const
+{
+    return content_size;
+}
+
+void NativeBrowserImpl::invalidateContentSize()
+{
+    // several invalidations in a row cost one engine query
+    content_size_refresh->start();
+}
+
+void NativeBrowserImpl::setLoadTimeouts(int start_msecs, int idle_msecs)
+{
+    default_start_timeout = start_msecs;
+    default_idle_timeout = idle_msecs;
+    navigation.setTimeouts(start_msecs, idle_msecs);
+}
+
+int NativeBrowserImpl::loadStartTimeout() const
+{
+    return default_start_timeout;
+}
+
+int NativeBrowserImpl::loadIdleTimeout() const
+{
+    return default_idle_timeout;
+}
+
+void NativeBrowserImpl::setNavigationTimeouts(int start_msecs, int idle_msecs)
+{
+    next_start_timeout = start_msecs;
+    next_idle_timeout = idle_msecs;
+}
+
+void NativeBrowserImpl::cancelNavigation()
+{
+    if (!timing_active && navigation.state() == NavigationStateMachine::Idle)
+        return;
+    // a navigation waiting for a slot or the end of a burst never reaches
+    // the engine
+    LoadScheduler::instance()->release(this);
+    holding = false;
+    debounce_timer->stop();
+    fresh_timer->stop();
+    refused_timer->stop();
+    scheduled_document.clear();
+    {
+        CpuTimeScope cpu(this);
+        stop();
+    }
+    applyNavigationActions(navigation.cancelled());
+    recordTiming(false);
+}
+
+quint64 NativeBrowserImpl::rawProgressEvents() const
+{
+    return progress_coalescer->rawEvents();
+}
+
+quint64 NativeBrowserImpl::emittedProgressEvents() const
+{
+    return progress_coalescer->deliveredEvents();
+}
+
+bool NativeBrowserImpl::onBeforeNavigate(const QString &url, bool top_frame)
+{
+    if (!top_frame && !onRequest(url))
+    {
+        traceEvent(EngineTraceEvent::BeforeNavigate, url, top_frame, false);
+        return false;
+    }
+    NavigationPolicy::Action action = navigation_policy.decide(url, navigation_host);
+    // redirects of a running load and about:blank are only held back when blocked
+    bool allowed = action == NavigationPolicy::Allow
+            || (action == NavigationPolicy::External && (loadInProgress() || url == "about:blank"));
+    // traced before it is acted on, the replay repeats what follows
+    traceEvent(EngineTraceEvent::BeforeNavigate, url, top_frame, allowed);
+    if (allowed)
+    {
+        if (top_frame && url != "about:blank")
+            showing_html = false;
+        if (top_frame)
+            applyNavigationActions(navigation.started(true));
+    }
+    else if (action == NavigationPolicy::Block)
+    {
+        // the requested page itself is blocked, the engine will never
+        // start loading it
+        if (top_frame && navigation.state() == NavigationStateMachine::Requested)
+            refused_timer->start();
+    }
+    else if (action == NavigationPolicy::External)
+    {
+        // the engine's own error pages are not worth an external browser
+        if (NavigationPolicy::hostOf(url) != QLatin1String("ieframe.dll"))
+        {
+            if (top_frame && navigation.state() == NavigationStateMachine::Requested)
+            {
+                // the requested page itself went external, the engine will
+                // never start loading it
+                if (parent_wnd)
+                    parent_wnd->navigationRedirected(url, timing.load_called);
+                LoadScheduler::instance()->release(this);
+                applyNavigationActions(navigation.cancelled());
+                recordTiming(false);
+            }
+            onExternalNavigate(url);
+        }
+    }
+    return allowed;
+}
+
+NavigationPolicy::Action NativeBrowserImpl::navigationAction(const QString &url) const
+{
+    return navigation_policy.decide(url, navigation_host);
+}
+
+void NativeBrowserImpl::setNavigationPolicy(const NavigationPolicy &policy)
+{
+    navigation_policy = policy;
+}
+
+const NavigationPolicy &NativeBrowserImpl::navigationPolicy() const
+{
+    return navigation_policy;
+}
+
+bool NativeBrowserImpl::onRequest(const QString &url)
+{
+    QSharedPointer<const RequestBlocklist> blocklist = requestBlocklist();
+    if (!blocklist)
+        return true;
+    bool blocked = blocklist->isBlocked(url);
+    countRequest(url, blocked);
+    return !blocked;
+}
+
+void NativeBrowserImpl::countRequest(const QString &url, bool blocked)
+{
+    NativeBrowserMetrics *metrics = NativeBrowserMetrics::instance();
+    ++checked_requests;
+    metrics->increment(NativeBrowserMetrics::RequestsChecked);
+    if (!blocked)
+        return;
+    ++blocked_requests;
+    metrics->increment(NativeBrowserMetrics::RequestsBlocked);
+    EventLog::record(EventLog::RequestBlocked, instance_id, url);
+}
+
+bool NativeBrowserImpl::setRequestBlocklist(const QString &compiled_file)
+{
+    QSharedPointer<RequestBlocklist> blocklist;
+    if (!compiled_file.isEmpty())
+    {
+        blocklist = QSharedPointer<RequestBlocklist>::create();
+        if (!blocklist->open(compiled_file))
+            blocklist.clear();
+    }
+    {
+        QMutexLocker lock(&request_blocklist_mutex);
+        request_blocklist = blocklist;
+    }
+    if (!blocklist)
+        return compiled_file.isEmpty();
+    installRequestFilter();
+    return true;
+}
+
+QSharedPointer<const RequestBlocklist> NativeBrowserImpl::requestBlocklist()
+{
+    QMutexLocker lock(&request_blocklist_mutex);
+    return request_blocklist;
+}
+
+int NativeBrowserImpl::requestBlocklistRules()
+{
+    QSharedPointer<const RequestBlocklist> blocklist = requestBlocklist();
+    return blocklist ? blocklist->ruleCount() : 0;
+}
+
+quint64 NativeBrowserImpl::checkedRequests() const
+{
+    return checked_requests;
+}
+
+quint64 NativeBrowserImpl::blockedRequests() const
+{
+    return blocked_requests;
+}
+
+void NativeBrowserImpl::onNewWindow(const QString &url)
+{
+    traceEvent(EngineTraceEvent::NewWindow, url);
+    NativeBrowserMetrics::instance()->increment(NativeBrowserMetrics::NewWindowRequests);
+    onExternalNavigate(url);
+}
+
 void NativeBrowserImpl::onProgress(int current_progress, int max_progress)
 {
+    if (trace_recorder)
+    {
+        EngineTraceEvent event;
+        event.kind = EngineTraceEvent::Progress;
+        event.time = NavigationTiming::now();
+        event.current = current_progress;
+        event.maximum = max_progress;
+        trace_recorder->record(event);
+    }
+    NativeBrowserMetrics::instance()->increment(NativeBrowserMetrics::ProgressEvents);
     int progress;
     if (current_progress < 0 || current_progress > max_progress || max_progress < 1)
     {
@@ -37,26 +787,203 @@ void NativeBrowserImpl::onProgress(int current_progress, int max_progress)
     {
         progress = int(double(current_progress)/max_progress * 100);
     }
-    if (!parent_wnd) return;
-    parent_wnd->updateGeometry();
-    emit parent_wnd->loadProgress(progress);
+    applyNavigationActions(navigation.progress());
+    if (timing_active && navigation.isLoading())
+    {
+        timing.last_progress = NavigationTiming::now();
+        if (timing.first_progress < 0)
+            timing.first_progress = timing.last_progress;
+    }
+    progress_coalescer->post(progress);
 }
 
 void NativeBrowserImpl::onLoadStart()
 {
-    if (!parent_wnd) return;
-    emit parent_wnd->loadStarted();
+    traceEvent(EngineTraceEvent::LoadStart);
+    applyNavigationActions(navigation.started(true));
+}
+
+void NativeBrowserImpl::onNavigateComplete(bool top_frame)
+{
+    traceEvent(EngineTraceEvent::NavigateComplete, top_frame);
+    applyNavigationActions(navigation.navigateComplete(top_frame));
+}
+
+void NativeBrowserImpl::onNavigateError(bool top_frame)
+{
+    traceEvent(EngineTraceEvent::NavigateError, top_frame);
+    applyNavigationActions(navigation.navigateError(top_frame));
+}
+
+void NativeBrowserImpl::onDocumentComplete(bool top_frame)
+{
+    traceEvent(EngineTraceEvent::DocumentComplete, top_frame);
+    applyNavigationActions(navigation.documentComplete(top_frame));
 }
 
 void NativeBrowserImpl::onLoadFinish(bool success)
 {
+    traceEvent(EngineTraceEvent::LoadFinish, true, success);
+    applyNavigationActions(navigation.finished(success));
+}
+
+void NativeBrowserImpl::onNavigateFailed()
+{
+    refused_timer->start();
+}
+
+bool NativeBrowserImpl::loadInProgress() const
+{
+    return navigation.isLoading();
+}
+
+void NativeBrowserImpl::loadCompleted(bool)
+{
+}
+
+void NativeBrowserImpl::navigationTimeout()
+{
+    int actions = navigation.timeout();
+    if (actions & NavigationStateMachine::EmitFinished)
+    {
+        NativeBrowserMetrics::instance()->increment(NativeBrowserMetrics::NavigationsTimedOut);
+        EventLog::record(EventLog::NavigationTimedOut, instance_id);
+    }
+    applyNavigationActions(actions);
+}
+
+void NativeBrowserImpl::applyNavigationActions(int actions)
+{
+    if (actions & NavigationStateMachine::StopTimer)
+    {
+        navigation_timer->stop();
+    }
+    if (actions & NavigationStateMachine::RestartTimer)
+    {
+        navigation_timer->start(navigation.timerInterval());
+    }
+    if (actions & NavigationStateMachine::StopEngine)
+    {
+        stop();
+    }
+    if (actions & NavigationStateMachine::EmitStarted)
+    {
+        if (!timing_active)
+        {
+            // started by the page itself, not by load()
+            beginTiming(location());
+        }
+        timing.engine_started = NavigationTiming::now();
+        // the document on screen is being replaced
+        fresh_since = -1;
+        NativeBrowserMetrics::instance()->increment(NativeBrowserMetrics::NavigationsStarted);
+        EventLog::record(EventLog::NavigationStarted, instance_id);
+        progress_coalescer->reset();
+        if (parent_wnd)
+            emit parent_wnd->loadStarted();
+    }
+    if (actions & NavigationStateMachine::EmitFinished)
+    {
+        bool success = navigation.succeeded();
+        if (success && !showing_html)
+        {
+            fresh_url = timing.url;
+            fresh_since = NavigationTiming::now();
+        }
+        LoadScheduler::instance()->release(this);
+        progress_coalescer->flush();
+        refreshContentSize();
+        loadCompleted(success);
+        recordTiming(true);
+        if (!restore_scroll.isNull())
+        {
+            if (success)
+                setScrollPosition(restore_scroll);
+            restore_scroll = QPoint();
+        }
+        if (!showing_html)
+            navigation_host = QUrl::fromUserInput(location()).host();
+        if (parent_wnd)
+            emit parent_wnd->loadFinished(success);
+    }
+}
+
+void NativeBrowserImpl::beginTiming(const QString &url)
+{
+    timing = NavigationTiming();
+    timing.id = ++last_navigation_id;
+    timing.url = url;
+    timing.load_profile = load_profile;
+    timing_active = true;
+}
+
+void NativeBrowserImpl::recordTiming(bool finished)
+{
+    if (!timing_active) return;
+    timing_active = false;
+    NativeBrowserMetrics *metrics = NativeBrowserMetrics::instance();
+    if (finished)
+    {
+        timing.finished = NavigationTiming::now();
+        timing.success = navigation.succeeded();
+        metrics->increment(timing.success ? NativeBrowserMetrics::NavigationsSucceeded : NativeBrowserMetrics::NavigationsFailed);
+        // pages that started themselves have no load()
+        qint64 begun = timing.load_called >= 0 ? timing.load_called : timing.engine_started;
+        metrics->observe(timing.success ? NativeBrowserMetrics::LoadTime : NativeBrowserMetrics::FailedLoadTime, timing.finished - begun);
+        EventLog::record(EventLog::NavigationFinished, instance_id, timing.success ? 1 : 0);
+    }
+    else
+    {
+        metrics->increment(NativeBrowserMetrics::NavigationsAbandoned);
+        EventLog::record(EventLog::NavigationAbandoned, instance_id);
+    }
+    if (!parent_wnd) return;
+    parent_wnd->recordNavigationTiming(timing);
+}
+
+void NativeBrowserImpl::traceEvent(EngineTraceEvent::Kind kind, bool top_frame, bool allowed)
+{
+    if (!trace_recorder) return;
+    traceEvent(kind, QString(), top_frame, allowed);
+}
+
+void NativeBrowserImpl::traceEvent(EngineTraceEvent::Kind kind, const QString &url, bool top_frame, bool allowed)
+{
+    if (!trace_recorder) return;
+    EngineTraceEvent event;
+    event.kind = kind;
+    event.time = NavigationTiming::now();
+    event.url = url;
+    event.top_frame = top_frame;
+    event.allowed = allowed;
+    trace_recorder->record(event);
+}
+
+void NativeBrowserImpl::deliverProgress(int progress)
+{
+    if (!parent_wnd) return;
+    emit parent_wnd->loadProgress(progress);
+}
+
+void NativeBrowserImpl::refreshContentSize()
+{
+    content_size_refresh->stop();
+    QSize new_size;
+    {
+        CpuTimeScope cpu(this);
+        new_size = contentSize();
+    }
+    if (new_size == content_size) return;
+    content_size = new_size;
     if (!parent_wnd) return;
     parent_wnd->updateGeometry();
-    emit parent_wnd->loadFinished(success);
+    emit parent_wnd->contentSizeChanged(content_size);
 }
 
 void NativeBrowserImpl::onExternalNavigate(const QString &external_url)
 {
+    NativeBrowserMetrics::instance()->increment(NativeBrowserMetrics::ExternalNavigations);
+    EventLog::record(EventLog::ExternalNavigation, instance_id, external_url);
     if (!parent_wnd) return;
     emit parent_wnd->externalNavigate(external_url);
 }
@@ -1,12 +1,24 @@
 #ifndef NATIVEBROWSERIMPL_H
 #define NATIVEBROWSERIMPL_H
 
+#include <QByteArray>
 #include <QObject>
+#include <QPoint>
+#include <QSharedPointer>
+#include <QSize>
+#include <QString>
+#include <QUrl>
 
+#include "enginetrace.h"
 #include "nativebrowser.h"
+#include "navigationpolicy.h"
+#include "navigationstatemachine.h"
+#include "navigationtiming.h"
 
-class QPoint;
-class QString;
+class EngineTraceRecorder;
+class ProgressCoalescer;
+class RequestBlocklist;
+class ResizeCoalescer;
 class QTimer;
 
 class NativeBrowserImpl: public QObject
@@ -16,36 +28,287 @@ class NativeBrowserImpl: public QObject
 public:
     virtual ~NativeBrowserImpl();
 
-    virtual void navigate(const QString &url) = 0;
+    // starts a navigation, the engine reports its course through the on*() hooks;
+    // requested_at is when the caller asked for it (NavigationTiming::now()),
+    // -1 for right now. Returns the load_called of the navigation that
+    // serves the request, an earlier one when it was collapsed into it.
+    qint64 load(const QString &url, qint64 requested_at = -1);
+    // shows a document from memory, relative URLs resolve against base_url
+    void setHtml(const QByteArray &html, const QUrl &base_url, qint64 requested_at = -1);
     virtual QString location() const = 0;
     virtual void stop() = 0;
 
+    // true while the document came from setHtml() rather than a URL
+    bool showsHtml() const;
+    // true from load() or setHtml() until the navigation finished or was
+    // dropped, also while it waits for a slot or the end of a burst
+    bool isNavigating() const;
+
+    // scroll offset of the document, (0, 0) where the engine cannot tell
+    virtual QPoint scrollPosition() const;
+    // the document shown, as setHtml() takes it; empty where the engine
+    // cannot tell
+    QByteArray documentSnapshot();
+    // scrolls there once the next load has finished
+    void restoreScrollPosition(const QPoint &position);
+
     virtual void setSize(const QSize& size) = 0;
 
-    virtual QSize sizeHint() const = 0;
+    // resizes the engine at most once per frame, a live resize applies
+    // its first and its latest size
+    void resize(const QSize &size);
+    // applies the current size again after the browser moved to a screen
+    // with another resolution
+    void screenChanged();
+    quint64 appliedResizes() const;
+    quint64 droppedResizes() const;
+
+    // last known content size, only refreshed when a load finishes or
+    // after invalidateContentSize()
+    QSize sizeHint() const;
+    void invalidateContentSize();
+
+    void setLoadTimeouts(int start_msecs, int idle_msecs);
+    int loadStartTimeout() const;
+    int loadIdleTimeout() const;
+    // replaces the load timeouts for the next load() or setHtml() only,
+    // -1 keeps the ones from setLoadTimeouts()
+    void setNavigationTimeouts(int start_msecs, int idle_msecs);
+    // stops the current navigation, whether it is loading or still waiting
+    // for the engine or the scheduler, and records it unfinished
+    void cancelNavigation();
 
+    void setNavigationPolicy(const NavigationPolicy &policy);
+    const NavigationPolicy &navigationPolicy() const;
+
+    // takes a pooled backend if there is one, see NativeBrowserPool; not
+    // while an instance factory is set
     static NativeBrowserImpl* createNewInstance(NativeBrowser *browserwindow);
+    // gives the backend back to the pool or destroys it
+    static void releaseInstance(NativeBrowserImpl *instance);
+
+    // replaces the platform backend for instances created afterwards
+    // (benchmarks, replay drivers); 0 restores the platform backend
+    typedef NativeBrowserImpl* (*InstanceFactory)(WId browserwindow);
+    static void setInstanceFactory(InstanceFactory factory);
+
+    quint64 rawProgressEvents() const;
+    quint64 emittedProgressEvents() const;
+
+    // makes the platform engine send requests for scheme to SchemeHandlers,
+    // implemented by every platform backend
+    static void registerScheme(const QString &scheme);
+
+    // compiled blocklist checked by onRequest() in every backend, see
+    // RequestBlocklist; an empty file name disables it
+    static bool setRequestBlocklist(const QString &compiled_file);
+    static int requestBlocklistRules();
+    // the blocklist in force, null if there is none; safe on any thread,
+    // a snapshot stays usable after the blocklist is replaced
+    static QSharedPointer<const RequestBlocklist> requestBlocklist();
+
+    quint64 checkedRequests() const;
+    quint64 blockedRequests() const;
+
+    // slows down progress delivery here and has the backend throttle its engine
+    void setLifecycleState(NativeBrowser::LifecycleState state);
+    NativeBrowser::LifecycleState lifecycleState() const;
+
+    // CPU time counted by CpuTimeScope, in nanoseconds
+    qint64 cpuTime() const;
+
+    // unique in the process, identifies the backend in the EventLog
+    quint64 instanceId() const;
+
+    // see NativeBrowser::setDeduplicateNavigations() and the following
+    void setDeduplicateNavigations(bool enabled);
+    void setNavigationDebounce(int msecs);
+    void setNavigationFreshness(int msecs);
+    quint64 savedNavigations() const;
+
+    void setLoadProfile(NativeBrowser::LoadProfile profile);
+    NativeBrowser::LoadProfile loadProfile() const;
+
+    enum LoadFeature
+    {
+        LoadImages     = 0x01,
+        LoadScripts    = 0x02,
+        LoadPlugins    = 0x04,
+        LoadAnimations = 0x08
+    };
+    // LoadFeature flags the profile allows
+    static int loadFeatures(NativeBrowser::LoadProfile profile);
+    // CSS the engine adds to every document of the profile, empty for Full
+    static QString profileStyleSheet(NativeBrowser::LoadProfile profile);
 protected:
+    // adds the CPU time the thread spends while it exists to cpuTime();
+    // backends put one around calls into their engine and the engine's
+    // callbacks, nested scopes count once
+    class CpuTimeScope
+    {
+    public:
+        explicit CpuTimeScope(NativeBrowserImpl *backend);
+        ~CpuTimeScope();
+
+    private:
+        Q_DISABLE_COPY(CpuTimeScope)
+        NativeBrowserImpl *backend;
+        qint64 started;
+    };
+
     static NativeBrowserImpl* createNewInstance(WId browserwindow);
     NativeBrowserImpl();
 
+    virtual void navigate(const QString &url) = 0;
+    // hands the document to the engine without a URL round-trip; the
+    // default navigates to a data: URL
+    virtual void navigateToHtml(const QByteArray &html, const QUrl &base_url);
+
+    // moves the engine's view into another native window
+    virtual void reparent(WId window);
+
+    // the default does nothing
+    virtual void setScrollPosition(const QPoint &position);
+
+    // stops or resumes painting, timers and script in the engine; the
+    // default does nothing
+    virtual void applyLifecycleState(NativeBrowser::LifecycleState state);
+
+    // makes the engine load what the profile allows from the next
+    // navigation on; the default does nothing
+    virtual void applyLoadProfile(NativeBrowser::LoadProfile profile);
+
+    // asks the engine for the document size, may be expensive
+    virtual QSize contentSize() const = 0;
+
+    // serializes the document shown for documentSnapshot(); the default
+    // returns nothing
+    virtual QByteArray serializeDocument() const;
+
+    // called right before loadFinished is emitted
+    virtual void loadCompleted(bool success);
+
+    // what the navigation policy says about url, relative to the current page
+    NavigationPolicy::Action navigationAction(const QString &url) const;
+
+    // engine events, top_frame tells whether they concern the main document
+    // the engine is about to navigate to url, false if it has to be cancelled;
+    // the navigation policy decides, external navigations go to externalNavigate
+    bool onBeforeNavigate(const QString &url, bool top_frame);
+    // the page asked for a new window, it is always redirected externally
+    void onNewWindow(const QString &url);
+    // a subresource or subframe is about to be requested, false if the
+    // request blocklist says it must not be
+    bool onRequest(const QString &url);
     void onProgress(int current_progress, int max_progress);
     void onLoadStart();
+    void onNavigateComplete(bool top_frame);
+    void onNavigateError(bool top_frame);
+    void onDocumentComplete(bool top_frame);
     void onLoadFinish(bool success);
+    // navigate() could not hand the URL to the engine, the navigation
+    // finishes failed once the caller of load() returned
+    void onNavigateFailed();
+
+    bool loadInProgress() const;
 
     void queuedNavigate(const QString &url);
 
 protected slots:
     void onExternalNavigate(const QString &external_url);
 
+private slots:
+    void deliverProgress(int progress);
+    void applySize(const QSize &size);
+    void refreshContentSize();
+    void navigationTimeout();
+    void startDebouncedNavigation();
+    void finishFreshNavigation();
+    void finishRefusedNavigation();
+    // per browser counters of onRequest(), engines that check requests on
+    // their own threads queue the result here
+    void countRequest(const QString &url, bool blocked);
+
 private:
+    friend class LoadScheduler;
+    friend class NativeBrowserPool;
+    static NativeBrowserImpl* createDetachedInstance(QWidget *host);
+    static bool hasInstanceFactory();
+    // routes requests the engine reports no callback for through the
+    // blocklist, once one is loaded; implemented by every platform backend
+    static void installRequestFilter();
+    void attach(NativeBrowser *browserwindow);
+    void detach(QObject *owner, QWidget *host);
+
+    // true if it supersedes a running load
+    bool beginNavigation(const QString &url, const QString &host, qint64 requested_at);
+    // navigates now or once LoadScheduler has a slot for it, needs_slot
+    // is false for navigations that never wait
+    void scheduleNavigation(bool needs_slot, bool was_loading);
+    void startScheduledNavigation();
+    // the URL is being loaded for an earlier load()
+    bool isPendingNavigation(const QString &url) const;
+    // the URL was loaded successfully less than the freshness interval ago
+    bool isFresh(const QString &url) const;
+    // an engine navigation was not needed, reason as in EventLog
+    void saveNavigation(int reason);
+    void applyNavigationActions(int actions);
+    void beginTiming(const QString &url);
+    // hands the timeline of the current navigation to the browser
+    void recordTiming(bool finished);
+    void traceEvent(EngineTraceEvent::Kind kind, bool top_frame = true, bool allowed = true);
+    void traceEvent(EngineTraceEvent::Kind kind, const QString &url, bool top_frame = true, bool allowed = true);
+
+    quint64 instance_id;
     NativeBrowser *parent_wnd;
-#ifdef Q_OS_WIN
-protected slots:
-    virtual void navigateNotStarted() = 0;
-    virtual void navigateFinished() = 0;
-#endif
+    ProgressCoalescer *progress_coalescer;
+    ResizeCoalescer *resize_coalescer;
+    QSize engine_size;
+    QTimer *content_size_refresh;
+    QSize content_size;
+    NavigationStateMachine navigation;
+    int default_start_timeout;
+    int default_idle_timeout;
+    // from setNavigationTimeouts(), applied by beginNavigation()
+    int next_start_timeout;
+    int next_idle_timeout;
+    QTimer *navigation_timer;
+    NavigationTiming timing;
+    bool timing_active;
+    // host of the page being loaded or shown, links elsewhere are external
+    QString navigation_host;
+    NavigationPolicy navigation_policy;
+    EngineTraceRecorder *trace_recorder;
+    quint64 checked_requests;
+    quint64 blocked_requests;
+    bool showing_html;
+    NativeBrowser::LifecycleState lifecycle_state;
+    NativeBrowser::LoadProfile load_profile;
+    int frame_interval;
+    qint64 cpu_time;
+    int cpu_scope_depth;
+    QPoint restore_scroll;
+    bool deduplicate_navigations;
+    int debounce_interval;
+    int freshness_interval;
+    QTimer *debounce_timer;
+    QTimer *fresh_timer;
+    // finishes a navigation turned down before it started
+    QTimer *refused_timer;
+    // the navigation is held until debounce_timer fires
+    bool holding;
+    qint64 last_request;
+    // the last successful load, for isFresh()
+    QString fresh_url;
+    qint64 fresh_since;
+    quint64 saved_navigations;
+    // what startScheduledNavigation() hands to the engine
+    QString scheduled_url;
+    bool scheduled_html;
+    QByteArray scheduled_document;
+    QUrl scheduled_base_url;
+    // made by an instance factory, never pooled
+    bool replaced;
 };
 
 #endif // NATIVEBROWSERIMPL_H
-
@@ -0,0 +1,360 @@
+#include "nativebrowserimpl.h"
+
+#include <QByteArray>
+#include <QFile>
+#include <QHostAddress>
+#include <QMetaObject>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QNetworkAccessManager>
+#include <QNetworkReply>
+#include <QNetworkRequest>
+#include <QTimer>
+#include <QUrl>
+
+#include "schemehandler.h"
+
+namespace {
+
+// file:// documents are read in chunks of this size, one chunk per event loop
+// iteration, so progress is reported the way a real engine would report it
+static const qint64 FILE_CHUNK_SIZE = 64 * 1024;
+// delay between chunks of a throttled load, in ms
+static const int THROTTLED_CHUNK_INTERVAL = 100;
+
+static bool IsLoopbackHost(const QString &host)
+{
+    if (host.compare("localhost", Qt::CaseInsensitive) == 0)
+        return true;
+    QHostAddress address;
+    if (!address.setAddress(host))
+        return false;
+    return address == QHostAddress::LocalHostIPv6
+        || address.isInSubnet(QHostAddress(QHostAddress::LocalHost), 8);
+}
+
+static bool DecodeDataUrl(const QUrl &url, QByteArray &data)
+{
+    QByteArray encoded = url.toEncoded();
+    int comma = encoded.indexOf(',');
+    if (comma < 0)
+        return false;
+    QByteArray header = encoded.mid(5, comma - 5); // skip "data:"
+    QByteArray payload = QByteArray::fromPercentEncoding(encoded.mid(comma + 1));
+    if (header.endsWith(";base64"))
+        data = QByteArray::fromBase64(payload);
+    else
+        data = payload;
+    return true;
+}
+
+// Wakes the backend up on its own thread when the handler answered.
+class LinuxSchemeRequest : public SchemeRequest
+{
+public:
+    LinuxSchemeRequest(const QUrl &url, QObject *receiver)
+        : SchemeRequest(url)
+        , receiver(receiver)
+    {
+    }
+
+    void detach()
+    {
+        QMutexLocker lock(&receiver_mutex);
+        receiver = 0;
+    }
+
+protected:
+    virtual void finished() override
+    {
+        QMutexLocker lock(&receiver_mutex);
+        if (receiver)
+            QMetaObject::invokeMethod(receiver, "schemeRequestFinished", Qt::QueuedConnection);
+    }
+
+private:
+    QMutex receiver_mutex;
+    QObject *receiver;
+};
+
+} // anonymous
+
+// Headless backend: there is no rendering engine on Linux, the document is
+// only fetched. It supports about:blank, data:, file://, loopback http://,
+// registered custom schemes and documents from memory, and is meant for load-testing the shared event
+// pipeline on CI machines.
+class LinuxNativeBrowserImpl : public NativeBrowserImpl
+{
+    Q_OBJECT
+public:
+    LinuxNativeBrowserImpl()
+        : network(new QNetworkAccessManager(this))
+        , reply(0)
+        , file(0)
+        , start_timer(new QTimer(this))
+        , chunk_timer(new QTimer(this))
+        , loading(false)
+        , html_pending(false)
+    {
+        start_timer->setSingleShot(true);
+        start_timer->setInterval(0);
+        connect(start_timer, SIGNAL(timeout()), this, SLOT(startLoad()));
+        chunk_timer->setInterval(0);
+        connect(chunk_timer, SIGNAL(timeout()), this, SLOT(readFileChunk()));
+    }
+
+    virtual ~LinuxNativeBrowserImpl()
+    {
+        abortLoad();
+    }
+
+    virtual void navigate(const QString &url_str) override
+    {
+        QString new_url(url_str.isEmpty() ? "about:blank" : url_str);
+        QUrl url(new_url);
+        if (url.scheme().isEmpty())
+            url = QUrl::fromUserInput(new_url);
+
+        abortLoad();
+        current_url = url;
+        document.clear();
+        html_pending = false;
+        start_timer->start();
+    }
+
+    virtual void navigateToHtml(const QByteArray &html, const QUrl &base_url) override
+    {
+        abortLoad();
+        current_url = base_url.isEmpty() ? QUrl("about:blank") : base_url;
+        // shares the caller's buffer, nothing is copied
+        document = html;
+        html_pending = true;
+        start_timer->start();
+    }
+
+    virtual QString location() const override
+    {
+        return current_url.toString();
+    }
+
+    virtual void stop() override
+    {
+        if (loading)
+        {
+            abortLoad();
+            onLoadFinish(false);
+        }
+    }
+
+    virtual void setSize(const QSize& size) override
+    {
+        view_size = size;
+    }
+
+    virtual void applyLifecycleState(NativeBrowser::LifecycleState state) override
+    {
+        // nothing is painted or scripted here, only file reads slow down
+        // and stop like an engine's timers would
+        chunk_timer->setInterval(state == NativeBrowser::Active ? 0 : THROTTLED_CHUNK_INTERVAL);
+        if (state == NativeBrowser::Frozen)
+            chunk_timer->stop();
+        else if (file && !chunk_timer->isActive())
+            chunk_timer->start();
+    }
+
+    virtual QSize contentSize() const override
+    {
+        // no layout engine, so there is no content size to report
+        return QSize();
+    }
+
+    virtual QByteArray serializeDocument() const override
+    {
+        // the bytes fetched, shared rather than copied
+        return loading ? QByteArray() : document;
+    }
+
+private slots:
+    void startLoad()
+    {
+        CpuTimeScope cpu(this);
+        loading = true;
+        onLoadStart();
+
+        if (html_pending)
+        {
+            html_pending = false;
+            finishLoad(true);
+            return;
+        }
+
+        QString scheme = current_url.scheme().toLower();
+        if (scheme == "about")
+        {
+            finishLoad(current_url.path() == "blank");
+        }
+        else if (scheme == "data")
+        {
+            finishLoad(DecodeDataUrl(current_url, document));
+        }
+        else if (scheme == "file")
+        {
+            file = new QFile(current_url.toLocalFile(), this);
+            if (!file->open(QIODevice::ReadOnly))
+            {
+                finishLoad(false);
+                return;
+            }
+            document.reserve(int(file->size()));
+            if (lifecycleState() != NativeBrowser::Frozen)
+                chunk_timer->start();
+        }
+        else if (scheme == "http" && IsLoopbackHost(current_url.host()))
+        {
+            startRequest(current_url);
+        }
+        else if (SchemeHandlers::isRegistered(scheme))
+        {
+            scheme_request = QSharedPointer<LinuxSchemeRequest>(new LinuxSchemeRequest(current_url, this));
+            SchemeHandlers::start(scheme_request);
+        }
+        else
+        {
+            finishLoad(false);
+        }
+    }
+
+    void readFileChunk()
+    {
+        CpuTimeScope cpu(this);
+        document.append(file->read(FILE_CHUNK_SIZE));
+        qint64 size = file->size();
+        if (file->atEnd() || file->error() != QFileDevice::NoError)
+        {
+            bool success = file->error() == QFileDevice::NoError;
+            finishLoad(success);
+            return;
+        }
+        onProgress(int(file->pos() * 100 / size), 100);
+    }
+
+    void schemeRequestFinished()
+    {
+        if (!scheme_request || !scheme_request->isFinished())
+            return;
+        QSharedPointer<LinuxSchemeRequest> finished = scheme_request;
+        document = finished->data();
+        finishLoad(finished->status() == 200);
+    }
+
+    void replyProgress(qint64 received, qint64 total)
+    {
+        if (total > 0)
+            onProgress(int(received * 100 / total), 100);
+    }
+
+    void replyReadyRead()
+    {
+        CpuTimeScope cpu(this);
+        document.append(reply->readAll());
+    }
+
+    void replyFinished()
+    {
+        QNetworkReply *finished = reply;
+        reply = 0;
+        finished->deleteLater();
+
+        QUrl target = finished->attribute(QNetworkRequest::RedirectionTargetAttribute).toUrl();
+        if (target.isValid())
+        {
+            target = finished->url().resolved(target);
+            if (target.scheme() == "http" && IsLoopbackHost(target.host()))
+            {
+                current_url = target;
+                document.clear();
+                startRequest(target);
+            }
+            else
+            {
+                onExternalNavigate(target.toString());
+                finishLoad(false);
+            }
+            return;
+        }
+        document.append(finished->readAll());
+        finishLoad(finished->error() == QNetworkReply::NoError);
+    }
+
+private:
+    void startRequest(const QUrl &url)
+    {
+        reply = network->get(QNetworkRequest(url));
+        connect(reply, SIGNAL(downloadProgress(qint64,qint64)), this, SLOT(replyProgress(qint64,qint64)));
+        connect(reply, SIGNAL(readyRead()), this, SLOT(replyReadyRead()));
+        connect(reply, SIGNAL(finished()), this, SLOT(replyFinished()));
+    }
+
+    void finishLoad(bool success)
+    {
+        abortLoad();
+        if (success)
+            onProgress(100, 100);
+        onLoadFinish(success);
+    }
+
+    void abortLoad()
+    {
+        loading = false;
+        start_timer->stop();
+        chunk_timer->stop();
+        if (file)
+        {
+            delete file;
+            file = 0;
+        }
+        if (scheme_request)
+        {
+            scheme_request->detach();
+            scheme_request->cancel();
+            scheme_request.clear();
+        }
+        if (reply)
+        {
+            reply->disconnect(this);
+            reply->abort();
+            reply->deleteLater();
+            reply = 0;
+        }
+    }
+
+private:
+    QNetworkAccessManager *network;
+    QNetworkReply *reply;
+    QSharedPointer<LinuxSchemeRequest> scheme_request;
+    QFile *file;
+    QTimer *start_timer;
+    QTimer *chunk_timer;
+    QUrl current_url;
+    QByteArray document;
+    QSize view_size;
+    bool loading;
+    bool html_pending;
+};
+
+NativeBrowserImpl* NativeBrowserImpl::createNewInstance(WId)
+{
+    return new LinuxNativeBrowserImpl();
+}
+
+void NativeBrowserImpl::registerScheme(const QString &)
+{
+    // startLoad() asks SchemeHandlers itself
+}
+
+void NativeBrowserImpl::installRequestFilter()
+{
+    // documents come without subresources, there is nothing to filter
+}
+
+#include "nativebrowserimpl_linux.moc"
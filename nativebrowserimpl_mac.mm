@@ -3,14 +3,22 @@
 #import <Foundation/Foundation.h>
 #import <WebKit/WebKit.h>
 
+#include <QByteArray>
 #include <QEvent>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QPoint>
 #include <QUrl>
 #include <QResizeEvent>
+#include <QSharedPointer>
 #include <QString>
 
+#include "schemehandler.h"
+
 class MacNativeBrowserImpl;
+class MacSchemeRequest;
 
-@interface WebViewNotificationListener : NSObject <WebFrameLoadDelegate, WebUIDelegate, WebPolicyDelegate>
+@interface WebViewNotificationListener : NSObject <WebFrameLoadDelegate, WebUIDelegate, WebPolicyDelegate, WebResourceLoadDelegate>
 {
     bool download_success;
     int current_porgress;
@@ -21,6 +29,53 @@ class MacNativeBrowserImpl;
 
 @end
 
+// Serves the schemes registered with SchemeHandlers to every WebView in
+// the process; the URL loading system calls it on its own thread.
+@interface NativeBrowserSchemeProtocol : NSURLProtocol
+{
+    QSharedPointer<MacSchemeRequest> *scheme_request;
+}
+
+- (void) deliverReply;
+
+@end
+
+// Wakes the protocol up on the thread that started it.
+class MacSchemeRequest : public SchemeRequest
+{
+public:
+    MacSchemeRequest(const QUrl &url, NativeBrowserSchemeProtocol *protocol)
+        : SchemeRequest(url)
+        , protocol(protocol)
+        , thread([[NSThread currentThread] retain])
+    {
+    }
+
+    ~MacSchemeRequest()
+    {
+        [thread release];
+    }
+
+    void detach()
+    {
+        QMutexLocker lock(&protocol_mutex);
+        protocol = nil;
+    }
+
+protected:
+    void finished() override
+    {
+        QMutexLocker lock(&protocol_mutex);
+        if (protocol)
+            [protocol performSelector:@selector(deliverReply) onThread:thread withObject:nil waitUntilDone:NO];
+    }
+
+private:
+    QMutex protocol_mutex;
+    NativeBrowserSchemeProtocol *protocol;
+    NSThread *thread;
+};
+
 class MacNativeBrowserImpl : public NativeBrowserImpl
 {
 public:
@@ -33,6 +88,12 @@ public:
         [web setFrameLoadDelegate:notification_listener];
         [web setUIDelegate:notification_listener];
         [web setPolicyDelegate:notification_listener];
+        [web setResourceLoadDelegate:notification_listener];
+        // own preferences, throttling one view must not change the others;
+        // the id is never reused and nothing is written to the defaults
+        [web setPreferencesIdentifier:[NSString stringWithFormat:@"NativeBrowser%llu", instanceId()]];
+        [web.preferences setAutosaves:NO];
+        applyPreferences();
 
         [[NSNotificationCenter defaultCenter] addObserver:notification_listener selector:@selector(_webViewProgressStarted:) name:WebViewProgressStartedNotification object:web];
         [[NSNotificationCenter defaultCenter] addObserver:notification_listener selector:@selector(_webViewProgressFinished:) name:WebViewProgressFinishedNotification object:web];
@@ -45,6 +106,7 @@ public:
         [web retain];
         [web removeFromSuperview];
         [web setFrameLoadDelegate:NULL];
+        [web setResourceLoadDelegate:NULL];
         [web release];
         [notification_listener release];
     }
@@ -52,23 +114,45 @@ public:
     void navigate(const QString &url_str) override
     {
         QUrl url = QUrl::fromUserInput(url_str);
-        current_url_host = url.host();
         web.mainFrameURL = url.toString(QUrl::EncodeUnicode).toNSString();
     }
 
+    void navigateToHtml(const QByteArray &html, const QUrl &base_url) override
+    {
+        // the NSData shares the caller's buffer and keeps it alive as long
+        // as WebKit holds on to it
+        QByteArray *buffer = new QByteArray(html);
+        NSData *data = [[NSData alloc] initWithBytesNoCopy:const_cast<char *>(buffer->constData())
+                                                    length:NSUInteger(buffer->size())
+                                               deallocator:^(void *, NSUInteger) { delete buffer; }];
+        [web.mainFrame loadData:data
+                       MIMEType:@"text/html"
+               textEncodingName:nil
+                        baseURL:base_url.isEmpty() ? nil : base_url.toNSURL()];
+        [data release];
+    }
+
+    void reparent(WId window) override
+    {
+        [web retain];
+        [web removeFromSuperview];
+        [reinterpret_cast<NSView *>(window) addSubview:web];
+        [web release];
+    }
+
     QString location() const override
     {
         return QString::fromNSString(web.mainFrameURL);
     }
 
-    bool locationIsSame(const QUrl &url)
+    NavigationPolicy::Action linkAction(const QUrl &url)
     {
-        return current_url_host == url.host();
+        return navigationAction(url.toString());
     }
 
     void externalNatigate(const QUrl &url)
     {
-        onExternalNavigate(url.toString());
+        onNewWindow(url.toString());
     }
 
     void externalNatigateQueued(const QUrl &url)
@@ -81,35 +165,107 @@ public:
         [web stopLoading:web];
     }
 
+    QPoint scrollPosition() const override
+    {
+        NSRect visible = [[[web.mainFrame frameView] documentView] visibleRect];
+        return QPoint(int(visible.origin.x), int(visible.origin.y));
+    }
+
+    void setScrollPosition(const QPoint &position) override
+    {
+        [[[web.mainFrame frameView] documentView] scrollPoint:NSMakePoint(position.x(), position.y())];
+    }
+
+    void applyLifecycleState(NativeBrowser::LifecycleState state) override
+    {
+        // a hidden view is not drawn; frozen pages stop running script,
+        // timers included, until they are active again
+        [web setHidden:state != NativeBrowser::Active];
+        applyPreferences();
+    }
+
+    void applyLoadProfile(NativeBrowser::LoadProfile profile) override
+    {
+        // the style sheet goes in as a data: URL, no file to clean up
+        QString css = profileStyleSheet(profile);
+        web.preferences.userStyleSheetEnabled = !css.isEmpty();
+        web.preferences.userStyleSheetLocation = css.isEmpty() ? nil
+                : QUrl("data:text/css;charset=utf-8;base64," + QString::fromLatin1(css.toUtf8().toBase64())).toNSURL();
+        applyPreferences();
+    }
+
+    // what the load profile allows, as far as the lifecycle state lets it run
+    void applyPreferences()
+    {
+        int features = loadFeatures(loadProfile());
+        bool active = lifecycleState() == NativeBrowser::Active;
+        bool frozen = lifecycleState() == NativeBrowser::Frozen;
+        web.preferences.loadsImagesAutomatically = (features & LoadImages) != 0;
+        web.preferences.allowsAnimatedImageLooping = active && (features & LoadAnimations);
+        web.preferences.javaScriptEnabled = !frozen && (features & LoadScripts);
+        web.preferences.plugInsEnabled = !frozen && (features & LoadPlugins);
+    }
+
     void setSize(const QSize& size) override
     {
         [web setFrameSize:NSMakeSize(size.width(), size.height())];
         [web setNeedsDisplay:YES];
     }
 
-    QSize sizeHint() const override
+    QSize contentSize() const override
     {
         NSRect webFrameRect = [[[web.mainFrame frameView] documentView] frame];
         return QSize(webFrameRect.size.width, webFrameRect.size.height);
     }
 
+    QByteArray serializeDocument() const override
+    {
+        // the source as it was received, before script changed it; the BOM
+        // has the restore read it as UTF-8 whatever charset the page declares
+        id<WebDocumentRepresentation> representation = [[web.mainFrame dataSource] representation];
+        if (![representation canProvideDocumentSource])
+            return QByteArray();
+        return "\xEF\xBB\xBF" + QString::fromNSString([representation documentSource]).toUtf8();
+    }
+
+    inline bool requestAllowed(NSURL *url)
+    {
+        return onRequest(QString::fromNSString(url.absoluteString));
+    }
+
     inline void pageLoadStarted()
     {
+        CpuTimeScope cpu(this);
         onLoadStart();
     }
 
     inline void pageLoadFinished(bool success)
     {
-        if (success)
-        {
-            QUrl cur_url =  QUrl::fromUserInput(location());
-            current_url_host = cur_url.host();
-        }
+        CpuTimeScope cpu(this);
         onLoadFinish(success);
     }
 
+    inline void pageLoadCommitted(bool main_frame)
+    {
+        CpuTimeScope cpu(this);
+        onNavigateComplete(main_frame);
+    }
+
+    inline void pageLoadFailed(bool main_frame)
+    {
+        CpuTimeScope cpu(this);
+        onNavigateError(main_frame);
+    }
+
+    inline void pageDocumentComplete(bool main_frame)
+    {
+        CpuTimeScope cpu(this);
+        onDocumentComplete(main_frame);
+    }
+
     inline void pageLoadProgress(int percentage)
     {
+        CpuTimeScope cpu(this);
         onProgress(percentage, 100);
     }
 
@@ -121,7 +277,6 @@ public:
 private:
     WebView *web;
     WebViewNotificationListener *notification_listener;
-    QString current_url_host;
 };
 
 @implementation WebViewNotificationListener
@@ -142,13 +297,18 @@ private:
     Q_UNUSED(frame)
     if (WebNavigationTypeLinkClicked == [[actionInformation objectForKey:WebActionNavigationTypeKey] intValue])
     {
-        if (web_view_impl->locationIsSame(QUrl::fromNSURL(request.URL)))
+        QUrl url = QUrl::fromNSURL(request.URL);
+        NavigationPolicy::Action action = web_view_impl->linkAction(url);
+        if (action == NavigationPolicy::Allow)
         {
             [listener use];
         }
         else
         {
-            web_view_impl->externalNatigateQueued(QUrl::fromNSURL(request.URL));
+            if (action == NavigationPolicy::External)
+            {
+                web_view_impl->externalNatigateQueued(url);
+            }
             [listener ignore];
         }
     }
@@ -173,6 +333,22 @@ private:
     [listener ignore];
 }
 
+// ------- WebResourceLoadDelegate --------
+
+- (NSURLRequest *)webView:(WebView *)sender resource:(id)identifier
+                                      willSendRequest:(NSURLRequest *)request
+                                     redirectResponse:(NSURLResponse *)redirectResponse
+                                       fromDataSource:(WebDataSource *)dataSource
+{
+    Q_UNUSED(identifier)
+    Q_UNUSED(redirectResponse)
+    // the main document is the navigation itself, not a request to block
+    if ([dataSource webFrame] == [sender mainFrame] && [[dataSource initialRequest].URL isEqual:request.URL])
+        return request;
+    // nil cancels the request
+    return web_view_impl->requestAllowed(request.URL) ? request : nil;
+}
+
 // ------- WebUIDelegate --------
 
 - (NSArray *)webView:(WebView *)sender contextMenuItemsForElement:(NSDictionary *)element defaultMenuItems:(NSArray *)defaultMenuItems
@@ -186,6 +362,16 @@ private:
 
 // ------- WebFrameLoadDelegate --------
 
+- (void)webView:(WebView *)sender didCommitLoadForFrame:(WebFrame *)frame
+{
+    web_view_impl->pageLoadCommitted(frame == [sender mainFrame]);
+}
+
+- (void)webView:(WebView *)sender didFinishLoadForFrame:(WebFrame *)frame
+{
+    web_view_impl->pageDocumentComplete(frame == [sender mainFrame]);
+}
+
 - (void)webView:(WebView *)sender didFailLoadWithError:(NSError *)error forFrame:(WebFrame *)frame
 {
     Q_UNUSED(error)
@@ -193,6 +379,7 @@ private:
     {
         download_success = false;
     }
+    web_view_impl->pageLoadFailed(frame == [sender mainFrame]);
 }
 
 - (void)webView:(WebView *)sender didFailProvisionalLoadWithError:(NSError *)error forFrame:(WebFrame *)frame
@@ -202,6 +389,7 @@ private:
     {
         download_success = false;
     }
+    web_view_impl->pageLoadFailed(frame == [sender mainFrame]);
 }
 
 // -------- Notifications ------
@@ -229,7 +417,87 @@ private:
 
 @end
 
+@implementation NativeBrowserSchemeProtocol
+
++ (BOOL)canInitWithRequest:(NSURLRequest *)request
+{
+    return SchemeHandlers::isRegistered(QString::fromNSString(request.URL.scheme));
+}
+
++ (NSURLRequest *)canonicalRequestForRequest:(NSURLRequest *)request
+{
+    return request;
+}
+
+- (void)startLoading
+{
+    scheme_request = new QSharedPointer<MacSchemeRequest>(new MacSchemeRequest(QUrl::fromNSURL(self.request.URL), self));
+    SchemeHandlers::start(*scheme_request);
+}
+
+- (void)stopLoading
+{
+    if (scheme_request)
+    {
+        (*scheme_request)->detach();
+        (*scheme_request)->cancel();
+        delete scheme_request;
+        scheme_request = 0;
+    }
+}
+
+- (void)deliverReply
+{
+    if (!scheme_request)
+        return;
+    MacSchemeRequest *request = scheme_request->data();
+    if (request->status() != 200)
+    {
+        [self.client URLProtocol:self didFailWithError:[NSError errorWithDomain:NSURLErrorDomain code:NSURLErrorFileDoesNotExist userInfo:nil]];
+        return;
+    }
+
+    // as in navigateToHtml(), WebKit reads the handler's buffer in place
+    QByteArray *buffer = new QByteArray(request->data());
+    NSData *data = [[NSData alloc] initWithBytesNoCopy:const_cast<char *>(buffer->constData())
+                                                length:NSUInteger(buffer->size())
+                                           deallocator:^(void *, NSUInteger) { delete buffer; }];
+    NSURLResponse *response = [[NSURLResponse alloc] initWithURL:self.request.URL
+                                                        MIMEType:QString::fromLatin1(request->mimeType()).toNSString()
+                                           expectedContentLength:NSInteger(data.length)
+                                                textEncodingName:nil];
+    [self.client URLProtocol:self didReceiveResponse:response cacheStoragePolicy:NSURLCacheStorageNotAllowed];
+    [self.client URLProtocol:self didLoadData:data];
+    [self.client URLProtocolDidFinishLoading:self];
+    [response release];
+    [data release];
+}
+
+- (void)dealloc
+{
+    [self stopLoading];
+    [super dealloc];
+}
+
+@end
+
 NativeBrowserImpl* NativeBrowserImpl::createNewInstance(WId browserwindow)
 {
     return new MacNativeBrowserImpl(reinterpret_cast<NSView *>(browserwindow));
 }
+
+void NativeBrowserImpl::registerScheme(const QString &)
+{
+    // canInitWithRequest asks SchemeHandlers, one registration serves all
+    static bool registered = false;
+    if (!registered)
+    {
+        [NSURLProtocol registerClass:[NativeBrowserSchemeProtocol class]];
+        registered = true;
+    }
+}
+
+void NativeBrowserImpl::installRequestFilter()
+{
+    // willSendRequest asks onRequest() for every resource already
+}
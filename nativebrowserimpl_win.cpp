@@ -10,22 +10,39 @@
 
 #include <atlbase.h> // for CComPtr<>
 #include <comdef.h> // for variant_t
+#include <CommCtrl.h> // for SetWindowSubclass
 #include <Exdisp.h>
 #include <ExDispid.h>
 #include <MsHtmHst.h>
 #include <MsHTML.h>
+#include <mshtmdid.h> // for DISPID_AMBIENT_DLCONTROL
 #include <strsafe.h>
+#include <urlmon.h>
 #include <Windows.h>
 
+#include <cctype>
 #include <string>
 
 using std::wstring;
 
-#include <QDebug>
+#include <QByteArray>
+#include <QGuiApplication>
+#include <QHash>
+#include <QList>
+#include <QMetaObject>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QScreen>
+#include <QSet>
+#include <QSharedPointer>
 #include <QString>
-#include <QTimer>
 #include <QUrl>
 
+#include "browserfeaturecontrol.h"
+#include "eventlog.h"
+#include "requestblocklist.h"
+#include "schemehandler.h"
+
 namespace {
 
 static bool SetBrowserFeatureControlKey(wstring feature, const wchar_t *appName, DWORD value) {
@@ -77,247 +94,457 @@ static LONG GetStringRegKey(HKEY hKey, const std::wstring &strValueName, std::ws
   return nError;
 }
 
-static DWORD GetBrowserEmulationMode() {
-  int browserVersion = 7;
-  wstring sBrowserVersion;
-  HKEY key;
-  bool success = true;
-  wstring path(L"SOFTWARE\\Microsoft\\Internet Explorer");
-  LONG nError = RegOpenKeyExW(HKEY_LOCAL_MACHINE, path.c_str(), 0, KEY_QUERY_VALUE, &key);
-  DWORD mode = 11001; // IE11 edge mode
+class RegistryFeatureStore : public BrowserFeatureStore {
+public:
+  virtual QString engineVersion() override {
+    wstring sBrowserVersion;
+    HKEY key;
+    wstring path(L"SOFTWARE\\Microsoft\\Internet Explorer");
+    LONG nError = RegOpenKeyExW(HKEY_LOCAL_MACHINE, path.c_str(), 0, KEY_QUERY_VALUE, &key);
+    if (nError != ERROR_SUCCESS) {
+      return QString();
+    }
 
-  if (nError != ERROR_SUCCESS) {
-    success = false;
-  } else {
-    nError = GetStringRegKey(key, L"svcVersion", sBrowserVersion, L"7");
+    nError = GetStringRegKey(key, L"svcVersion", sBrowserVersion, L"");
     if (nError != ERROR_SUCCESS) {
-      nError = GetStringRegKey(key, L"version", sBrowserVersion, L"7");
-      if (nError != ERROR_SUCCESS) {
-        success = false;
+      nError = GetStringRegKey(key, L"version", sBrowserVersion, L"");
+    }
+    RegCloseKey(key);
+
+    return nError == ERROR_SUCCESS ? QString::fromStdWString(sBrowserVersion) : QString();
+  }
+
+  virtual QString processName() override {
+    wchar_t fileName[MAX_PATH + 1];
+    DWORD size = GetModuleFileNameW(NULL, fileName, MAX_PATH);
+    if (size == 0) {
+      EventLog::record(EventLog::FeatureControlFailed, 0, qint32(::GetLastError()));
+      return QString();
+    }
+    wstring filename(fileName, size);
+    size_t sep_pos = filename.find_last_of('\\');
+    if (sep_pos != wstring::npos) {
+      filename.erase(0, sep_pos + 1);
+    }
+    return QString::fromStdWString(filename);
+  }
+
+  virtual bool setFeature(const QString &feature, const QString &process_name, quint32 value) override {
+    return SetBrowserFeatureControlKey(feature.toStdWString(), process_name.toStdWString().c_str(), value);
+  }
+};
+
+
+// Read-only IStream over a QByteArray, for IPersistStreamInit::Load. An
+// optional insertion (a <base> tag) is read at a given offset without
+// copying the document around it.
+class ByteArrayStream : public IStream {
+public:
+  ByteArrayStream(const QByteArray &data, const QByteArray &insertion, qint64 insert_at)
+    : m_refCount(1), m_data(data), m_insertion(insertion), m_insertAt(insert_at), m_position(0) {
+  }
+
+  virtual HRESULT STDMETHODCALLTYPE QueryInterface(REFIID riid, void **ppvObject) override {
+    if (riid == __uuidof(IUnknown) || riid == __uuidof(ISequentialStream) || riid == __uuidof(IStream)) {
+      *ppvObject = static_cast<IStream*>(this);
+      AddRef();
+      return S_OK;
+    }
+    *ppvObject = NULL;
+    return E_NOINTERFACE;
+  }
+
+  virtual ULONG STDMETHODCALLTYPE AddRef(void) override {
+    return InterlockedIncrement(&m_refCount);
+  }
+
+  virtual ULONG STDMETHODCALLTYPE Release(void) override {
+    LONG count = InterlockedDecrement(&m_refCount);
+    if (count == 0) {
+      delete this;
+    }
+    return count;
+  }
+
+  virtual HRESULT STDMETHODCALLTYPE Read(void *pv, ULONG cb, ULONG *pcbRead) override {
+    char *out = static_cast<char*>(pv);
+    ULONG read = 0;
+    while (read < cb && m_position < size()) {
+      const char *chunk;
+      qint64 available;
+      if (m_position < m_insertAt) {
+        chunk = m_data.constData() + m_position;
+        available = m_insertAt - m_position;
+      } else if (m_position < m_insertAt + m_insertion.size()) {
+        chunk = m_insertion.constData() + (m_position - m_insertAt);
+        available = m_insertAt + m_insertion.size() - m_position;
+      } else {
+        qint64 offset = m_position - m_insertion.size();
+        chunk = m_data.constData() + offset;
+        available = m_data.size() - offset;
       }
+      ULONG count = ULONG(qMin<qint64>(available, cb - read));
+      memcpy(out + read, chunk, count);
+      read += count;
+      m_position += count;
     }
+    if (pcbRead) {
+      *pcbRead = read;
+    }
+    return read == cb ? S_OK : S_FALSE;
+  }
 
-   if (RegCloseKey(key) != ERROR_SUCCESS) {
-      success = false;
+  virtual HRESULT STDMETHODCALLTYPE Write(const void *, ULONG, ULONG *) override {
+    return STG_E_ACCESSDENIED;
+  }
+
+  virtual HRESULT STDMETHODCALLTYPE Seek(LARGE_INTEGER dlibMove, DWORD dwOrigin, ULARGE_INTEGER *plibNewPosition) override {
+    qint64 base;
+    switch (dwOrigin) {
+    case STREAM_SEEK_SET: base = 0; break;
+    case STREAM_SEEK_CUR: base = m_position; break;
+    case STREAM_SEEK_END: base = size(); break;
+    default: return STG_E_INVALIDFUNCTION;
+    }
+    qint64 position = base + dlibMove.QuadPart;
+    if (position < 0) {
+      return STG_E_INVALIDFUNCTION;
     }
+    m_position = qMin(position, size());
+    if (plibNewPosition) {
+      plibNewPosition->QuadPart = m_position;
+    }
+    return S_OK;
+  }
+
+  virtual HRESULT STDMETHODCALLTYPE SetSize(ULARGE_INTEGER) override {
+    return STG_E_ACCESSDENIED;
+  }
+
+  virtual HRESULT STDMETHODCALLTYPE CopyTo(IStream *, ULARGE_INTEGER, ULARGE_INTEGER *, ULARGE_INTEGER *) override {
+    return E_NOTIMPL;
+  }
+
+  virtual HRESULT STDMETHODCALLTYPE Commit(DWORD) override {
+    return S_OK;
+  }
+
+  virtual HRESULT STDMETHODCALLTYPE Revert(void) override {
+    return S_OK;
+  }
+
+  virtual HRESULT STDMETHODCALLTYPE LockRegion(ULARGE_INTEGER, ULARGE_INTEGER, DWORD) override {
+    return STG_E_INVALIDFUNCTION;
+  }
+
+  virtual HRESULT STDMETHODCALLTYPE UnlockRegion(ULARGE_INTEGER, ULARGE_INTEGER, DWORD) override {
+    return STG_E_INVALIDFUNCTION;
+  }
+
+  virtual HRESULT STDMETHODCALLTYPE Stat(STATSTG *pstatstg, DWORD) override {
+    ZeroMemory(pstatstg, sizeof(STATSTG));
+    pstatstg->type = STGTY_STREAM;
+    pstatstg->cbSize.QuadPart = size();
+    pstatstg->grfMode = STGM_READ;
+    return S_OK;
+  }
+
+  virtual HRESULT STDMETHODCALLTYPE Clone(IStream **ppstm) override {
+    ByteArrayStream *clone = new ByteArrayStream(m_data, m_insertion, m_insertAt);
+    clone->m_position = m_position;
+    *ppstm = clone;
+    return S_OK;
+  }
+
+private:
+  qint64 size() const {
+    return m_data.size() + m_insertion.size();
   }
 
-  if (success) {
-    browserVersion = QString::fromStdWString(sBrowserVersion).split('.', QString::SkipEmptyParts).at(0).toInt(); // convert base 16 number in s to int
+  LONG m_refCount;
+  QByteArray m_data;
+  QByteArray m_insertion;
+  qint64 m_insertAt;
+  qint64 m_position;
+};
+
+// Pixels per inch of each monitor, looked up once per monitor. Cleared when
+// a screen is added or removed or changes its resolution.
+class MonitorDpiCache {
+public:
+  static MonitorDpiCache &instance() {
+    static MonitorDpiCache cache;
+    return cache;
+  }
 
-    switch (browserVersion) {
-    case 7:
-      mode = 7000;
-      break;
-    case 8:
-      mode = 8000;
-      break;
-    case 9:
-      mode = 9000;
-      break;
-    case 10:
-      mode = 10000;
-      break;
-    case 11:
-      mode = 11000;
-      break;
-    default:
-      // use IE11 edge mode
-      break;
+  void dpiFor(HWND window, int *x, int *y) {
+    HMONITOR monitor = ::MonitorFromWindow(window, MONITOR_DEFAULTTONEAREST);
+    QHash<HMONITOR, QPair<int, int> >::const_iterator found = m_dpi.constFind(monitor);
+    if (found == m_dpi.constEnd()) {
+      found = m_dpi.insert(monitor, Lookup(monitor));
     }
+    *x = found->first;
+    *y = found->second;
+  }
 
-  } else {
-    mode = -1;
+  void clear() {
+    m_dpi.clear();
+  }
+
+private:
+  typedef HRESULT (WINAPI *GetDpiForMonitorFunction)(HMONITOR, int, UINT *, UINT *);
+
+  MonitorDpiCache() {
+    // Windows 8.1 and later know the resolution of every monitor
+    HMODULE shcore = ::LoadLibraryW(L"Shcore.dll");
+    m_getDpiForMonitor = shcore != NULL
+        ? reinterpret_cast<GetDpiForMonitorFunction>(::GetProcAddress(shcore, "GetDpiForMonitor"))
+        : NULL;
+
+    QGuiApplication *application = qobject_cast<QGuiApplication*>(QCoreApplication::instance());
+    if (application == NULL) {
+      return;
+    }
+    for (QScreen *screen : QGuiApplication::screens()) {
+      WatchScreen(screen);
+    }
+    QObject::connect(application, &QGuiApplication::screenAdded, [this](QScreen *screen) {
+      clear();
+      WatchScreen(screen);
+    });
+    QObject::connect(application, &QGuiApplication::screenRemoved, [this](QScreen *) {
+      clear();
+    });
   }
 
-  return mode;
+  void WatchScreen(QScreen *screen) {
+    QObject::connect(screen, &QScreen::logicalDotsPerInchChanged, [this](qreal) {
+      clear();
+    });
+  }
+
+  QPair<int, int> Lookup(HMONITOR monitor) const {
+    UINT x = 0, y = 0;
+    // MDT_EFFECTIVE_DPI, as seen by this process with its DPI awareness
+    if (m_getDpiForMonitor != NULL && SUCCEEDED(m_getDpiForMonitor(monitor, 0, &x, &y))) {
+      return qMakePair(int(x), int(y));
+    }
+    HDC hdc = ::GetDC(NULL);
+    QPair<int, int> result(::GetDeviceCaps(hdc, LOGPIXELSX), ::GetDeviceCaps(hdc, LOGPIXELSY));
+    ::ReleaseDC(NULL, hdc);
+    return result;
+  }
+
+  GetDpiForMonitorFunction m_getDpiForMonitor;
+  QHash<HMONITOR, QPair<int, int> > m_dpi;
+};
+
+// where a <base> tag can go without changing the document mode: after a
+// byte order mark and a doctype, if there are any
+static int BaseTagPosition(const QByteArray &html) {
+  int position = html.startsWith("\xEF\xBB\xBF") ? 3 : 0;
+  int start = position;
+  while (start < html.size() && isspace(uchar(html.at(start)))) {
+    ++start;
+  }
+  if (html.size() - start > 9 && qstrnicmp(html.constData() + start, "<!doctype", 9) == 0) {
+    int end = html.indexOf('>', start);
+    if (end >= 0) {
+      position = end + 1;
+    }
+  }
+  return position;
 }
 
-static void SetBrowserFeatureControl() {
-  // http://msdn.microsoft.com/en-us/library/ee330720(v=vs.85).aspx
-  DWORD emulationMode = GetBrowserEmulationMode();
+// {5C1F8F3E-2B7A-4D61-9A0E-316C47D28B15}
+static const CLSID CLSID_NativeBrowserSchemeProtocol =
+  { 0x5c1f8f3e, 0x2b7a, 0x4d61, { 0x9a, 0x0e, 0x31, 0x6c, 0x47, 0xd2, 0x8b, 0x15 } };
 
-  if (emulationMode > 0) {
-    // FeatureControl settings are per-process
+// Wakes the protocol up on the engine's thread through IInternetProtocolSink::Switch,
+// which may be called from any thread.
+class WinSchemeRequest : public SchemeRequest {
+public:
+  WinSchemeRequest(const QUrl &url, IInternetProtocolSink *sink)
+    : SchemeRequest(url), m_sink(sink) {
+  }
 
-    wchar_t fileName[MAX_PATH + 1];
-    {   DWORD size;
-        if ((size = GetModuleFileNameW(NULL, fileName, MAX_PATH)) == 0)
-        {
-            qCritical() << "SetBrowserFeatureControl: cannot get current module path.";
-            return;
-        }
-        fileName[size] = L'\0';
-        wstring filename(fileName);
-        size_t sep_pos = filename.find_last_of('\\');
-        if (sep_pos != wstring::npos)
-        {
-            memcpy(fileName, filename.c_str()+sep_pos+1, sizeof(filename[0]) * (filename.length() - sep_pos + 1));
-        }
+  void detach() {
+    QMutexLocker lock(&m_sinkMutex);
+    m_sink.Release();
+  }
+
+protected:
+  virtual void finished() override {
+    QMutexLocker lock(&m_sinkMutex);
+    if (m_sink) {
+      PROTOCOLDATA data;
+      ZeroMemory(&data, sizeof(PROTOCOLDATA));
+      data.grfFlags = PI_FORCE_ASYNC;
+      m_sink->Switch(&data);
     }
+  }
+
+private:
+  QMutex m_sinkMutex;
+  CComPtr<IInternetProtocolSink> m_sink;
+};
 
-    // Windows Internet Explorer 8 and later. The FEATURE_BROWSER_EMULATION feature defines the default emulation mode for Internet
-    // Explorer and supports the following values.
-    // Webpages containing standards-based !DOCTYPE directives are displayed in IE10 Standards mode.
-    SetBrowserFeatureControlKey(L"FEATURE_BROWSER_EMULATION", fileName, emulationMode);
-
-    // Internet Explorer 8 or later. The FEATURE_AJAX_CONNECTIONEVENTS feature enables events that occur when the value of the online
-    // property of the navigator object changes, such as when the user chooses to work offline. For more information, see the ononline
-    // and onoffline events.
-    // Default: DISABLED
-//    SetBrowserFeatureControlKey(L"FEATURE_AJAX_CONNECTIONEVENTS", fileName, 1);
-
-    // Internet Explorer 9. Internet Explorer 9 optimized the performance of window-drawing routines that involve clipping regions associated
-    // with child windows. This helped improve the performance of certain window drawing operations. However, certain applications hosting the
-    // WebBrowser Control rely on the previous behavior and do not function correctly when these optimizations are enabled. The
-    // FEATURE_ENABLE_CLIPCHILDREN_OPTIMIZATION feature can disable these optimizations.
-    // Default: ENABLED
-    // SetBrowserFeatureControlKey(L"FEATURE_ENABLE_CLIPCHILDREN_OPTIMIZATION", fileName, 1);
-
-    // Internet Explorer 8 and later. By default, Internet Explorer reduces memory leaks caused by circular references between Internet Explorer
-    // and the Microsoft JScript engine, especially in scenarios where a webpage defines an expando and the page is refreshed. If a legacy
-    // application no longer functions with these changes, the FEATURE_MANAGE_SCRIPT_CIRCULAR_REFS feature can disable these improvements.
-    // Default: ENABLED
-    // SetBrowserFeatureControlKey(L"FEATURE_MANAGE_SCRIPT_CIRCULAR_REFS", fileName, 1);
-
-    // Windows Internet Explorer 8. When enabled, the FEATURE_DOMSTORAGE feature allows Internet Explorer and applications hosting the WebBrowser
-    // Control to use the Web Storage API. For more information, see Introduction to Web Storage.
-    // Default: ENABLED
-    // SetBrowserFeatureControlKey(L"FEATURE_DOMSTORAGE ", fileName, 1);
-
-    // Internet Explorer 9. The FEATURE_GPU_RENDERING feature enables Internet Explorer to use a graphics processing unit (GPU) to render content.
-    // This dramatically improves performance for webpages that are rich in graphics.
-    // Default: DISABLED
-//    SetBrowserFeatureControlKey(L"FEATURE_GPU_RENDERING ", fileName, 1);
-
-    // Internet Explorer 9. By default, the WebBrowser Control uses Microsoft DirectX to render webpages, which might cause problems for
-    // applications that use the Draw method to create bitmaps from certain webpages. In Internet Explorer 9, this method returns a bitmap
-    // (in a Windows Graphics Device Interface (GDI) wrapper) instead of a GDI metafile representation of the webpage. When the
-    // FEATURE_IVIEWOBJECTDRAW_DMLT9_WITH_GDI feature is enabled, the following conditions cause the Draw method to use GDI instead of DirectX
-    // to create the resulting representation. The GDI representation will contain text records and vector data, but is not guaranteed to be
-    // similar to the same represenation returned in earlier versions of the browser:
-    //    The device context passed to the Draw method points to an enhanced metafile.
-    //    The webpage is not displayed in IE9 Standards mode.
-    // By default, this feature is ENABLED for applications hosting the WebBrowser Control. This feature is ignored by Internet Explorer and
-    // Windows Explorer. To enable this feature by using the registry, add the name of your executable file to the following setting.
-//    SetBrowserFeatureControlKey(L"FEATURE_IVIEWOBJECTDRAW_DMLT9_WITH_GDI  ", fileName, 0);
-
-    // Windows 8 introduces a new input model that is different from the Windows 7 input model. In order to provide the broadest compatibility
-    // for legacy applications, the WebBrowser Control for Windows 8 emulates the Windows 7 mouse, touch, and pen input model (also known as the
-    // legacy input model). When the legacy input model is in effect, the following conditions are true:
-    //    Windows pointer messages are not processed by the Trident rendering engine (mshtml.dll).
-    //    Document Object Model (DOM) pointer and gesture events do not fire.
-    //    Mouse and touch messages are dispatched according to the Windows 7 input model.
-    //    Touch selection follows the Windows 7 model ("drag to select") instead of the Windows 8 model ("tap to select").
-    //    Hardware accelerated panning and zooming is disabled.
-    //    The Zoom and Pan Cascading Style Sheets (CSS) properties are ignored.
-    // The FEATURE_NINPUT_LEGACYMODE feature control determines whether the legacy input model is enabled
-    // Default: ENABLED
-//    SetBrowserFeatureControlKey(L"FEATURE_NINPUT_LEGACYMODE", fileName, 0);
-
-    // Internet Explorer 7 consolidated HTTP compression and data manipulation into a centralized component in order to improve performance and
-    // to provide greater consistency between transfer encodings (such as HTTP no-cache headers). For compatibility reasons, the original
-    // implementation was left in place. When the FEATURE_DISABLE_LEGACY_COMPRESSION feature is disabled, the original compression implementation
-    // is used.
-    // Default: ENABLED
-    // SetBrowserFeatureControlKey(L"FEATURE_DISABLE_LEGACY_COMPRESSION", fileName, 1);
-
-    // When the FEATURE_LOCALMACHINE_LOCKDOWN feature is enabled, Internet Explorer applies security restrictions on content loaded from the
-    // user's local machine, which helps prevent malicious behavior involving local files:
-    //    Scripts, Microsoft ActiveX controls, and binary behaviors are not allowed to run.
-    //    Object safety settings cannot be overridden.
-    //    Cross-domain data actions require confirmation from the user.
-    // Default: DISABLED
-    // SetBrowserFeatureControlKey(L"FEATURE_LOCALMACHINE_LOCKDOWN", fileName, 0);
-
-    // Internet Explorer 7 and later. When enabled, the FEATURE_BLOCK_LMZ_??? feature allows ??? stored in the Local Machine zone to be
-    // loaded only by webpages loaded from the Local Machine zone or by webpages hosted by sites in the Trusted Sites list. For more information,
-    // see Security and Compatibility in Internet Explorer 7.
-    // Default: DISABLED
-    //    FEATURE_BLOCK_LMZ_IMG can block images that try to load from the user's local file system. To opt in, add your process name and set
-    //                          the value to 0x00000001.
-    //    FEATURE_BLOCK_LMZ_OBJECT can block objects that try to load from the user's local file system. To opt in, add your process name and
-    //                          set the value to 0x00000001.
-    //    FEATURE_BLOCK_LMZ_SCRIPT can block script access from the user's local file system. To opt in, add your process name and set the value
-    //                          to 0x00000001.
-    // SetBrowserFeatureControlKey(L"FEATURE_BLOCK_LMZ_OBJECT", fileName, 0);
-    // SetBrowserFeatureControlKey(L"FEATURE_BLOCK_LMZ_OBJECT", fileName, 0);
-    // SetBrowserFeatureControlKey(L"FEATURE_BLOCK_LMZ_SCRIPT", fileName, 0);
-
-    // Internet Explorer 8 and later. When enabled, the FEATURE_DISABLE_NAVIGATION_SOUNDS feature disables the sounds played when you open a
-    // link in a webpage.
-    // Default: DISABLED
-    SetBrowserFeatureControlKey(L"FEATURE_DISABLE_NAVIGATION_SOUNDS", fileName, 1);
-
-    // Windows Internet Explorer 7 and later. Prior to Internet Explorer 7, href attributes of a objects supported the javascript prototcol;
-    // this allowed webpages to execute script when the user clicked a link. For security reasons, this support was disabled in Internet
-    // Explorer 7. For more information, see Event 1034 - Cross-Domain Barrier and Script URL Mitigation.
-    // When enabled, the FEATURE_SCRIPTURL_MITIGATION feature allows the href attribute of a objects to support the javascript prototcol.
-    // Default: DISABLED
-//    SetBrowserFeatureControlKey(L"FEATURE_SCRIPTURL_MITIGATION", fileName, 1);
-
-    // For Windows 8 and later, the FEATURE_SPELLCHECKING feature controls this behavior for Internet Explorer and for applications hosting
-    // the web browser control (WebOC). When fully enabled, this feature automatically corrects grammar issues and identifies misspelled words
-    // for the conditions described earlier.
-    //    (DWORD) 00000000 - Features are disabled.
-    //    (DWORD) 00000001 - Features are enabled for the conditions described earlier. (This is the default value.)
-    //    (DWORD) 00000002 - Features are enabled, but only for elements that specifically set the spellcheck attribute to true.
-//    SetBrowserFeatureControlKey(L"FEATURE_SPELLCHECKING", fileName, 0);
-
-    // When enabled, the FEATURE_STATUS_BAR_THROTTLING feature limits the frequency of status bar updates to one update every 200 milliseconds.
-    // Default: DISABLED
-//    SetBrowserFeatureControlKey(L"FEATURE_STATUS_BAR_THROTTLING", fileName, 1);
-
-    // Internet Explorer 7 or later. When enabled, the FEATURE_TABBED_BROWSING feature enables tabbed browsing navigation shortcuts and
-    // notifications. For more information, see Tabbed Browsing for Developers.
-    // Default: DISABLED
-    // SetBrowserFeatureControlKey(L"FEATURE_TABBED_BROWSING", fileName, 1);
-
-    // When enabled, the FEATURE_VALIDATE_NAVIGATE_URL feature control prevents Windows Internet Explorer from navigating to a badly formed URL.
-    // Default: DISABLED
-//    SetBrowserFeatureControlKey(L"FEATURE_VALIDATE_NAVIGATE_URL", fileName, 1);
-
-    // When enabled,the FEATURE_WEBOC_DOCUMENT_ZOOM feature allows HTML dialog boxes to inherit the zoom state of the parent window.
-    // Default: DISABLED
-//    SetBrowserFeatureControlKey(L"FEATURE_WEBOC_DOCUMENT_ZOOM", fileName, 1);
-
-    // The FEATURE_WEBOC_POPUPMANAGEMENT feature allows applications hosting the WebBrowser Control to receive the default Internet Explorer
-    // pop-up window management behavior.
-    // Default: ENABLED
-//    SetBrowserFeatureControlKey(L"FEATURE_WEBOC_POPUPMANAGEMENT", fileName, 0);
-
-    // Applications hosting the WebBrowser Control should ensure that window resizing and movement events are handled appropriately for the
-    // needs of the application. By default, these events are ignored if the WebBrowser Control is not hosted in a proper container. When enabled,
-    // the FEATURE_WEBOC_MOVESIZECHILD feature allows these events to affect the parent window of the application hosting the WebBrowser Control.
-    // Because this can lead to unpredictable results, it is not considered desirable behavior.
-    // Default: DISABLED
-    // SetBrowserFeatureControlKey(L"FEATURE_WEBOC_MOVESIZECHILD", fileName, 0);
-
-    // The FEATURE_ADDON_MANAGEMENT feature enables applications hosting the WebBrowser Control
-    // to respect add-on management selections made using the Add-on Manager feature of Internet Explorer.
-    // Add-ons disabled by the user or by administrative group policy will also be disabled in applications that enable this feature.
-//    SetBrowserFeatureControlKey(L"FEATURE_ADDON_MANAGEMENT", fileName, 0);
-
-    // Internet Explorer 10. When enabled, the FEATURE_WEBSOCKET feature allows script to create and use WebSocket objects.
-    // The WebSocketobject allows websites to request data across domains from your browser by using the WebSocket protocol.
-    // Default: ENABLED
-//    SetBrowserFeatureControlKey(L"FEATURE_WEBSOCKET", fileName, 1);
-
-    // When enabled, the FEATURE_WINDOW_RESTRICTIONS feature adds several restrictions to the size and behavior of popup windows:
-    //    Popup windows must appear in the visible display area.
-    //    Popup windows are forced to have status and address bars.
-    //    Popup windows must have minimum sizes.
-    //    Popup windows cannot cover important areas of the parent window.
-    // When enabled, this feature can be configured differently for each security zone by using the URLACTION_FEATURE_WINDOW_RESTRICTIONS URL
-    // action flag.
-    // Default: ENABLED
-//    SetBrowserFeatureControlKey(L"FEATURE_WINDOW_RESTRICTIONS", fileName, 0);
-
-    // Internet Explorer 7 and later. The FEATURE_XMLHTTP feature enables or disables the native XMLHttpRequest object.
-    // Default: ENABLED
-    // SetBrowserFeatureControlKey(L"FEATURE_XMLHTTP", fileName, 1);
+// Asynchronous pluggable protocol answering one request from SchemeHandlers.
+// Start() hands the request over and returns; Continue() runs once the
+// handler replied and reports the whole document at once.
+class WinSchemeProtocol : public IInternetProtocol {
+public:
+  WinSchemeProtocol() : m_refCount(1), m_position(0) {
+  }
+
+  virtual HRESULT STDMETHODCALLTYPE QueryInterface(REFIID riid, void **ppvObject) override {
+    if (riid == __uuidof(IUnknown) || riid == __uuidof(IInternetProtocolRoot) || riid == __uuidof(IInternetProtocol)) {
+      *ppvObject = static_cast<IInternetProtocol*>(this);
+      AddRef();
+      return S_OK;
+    }
+    *ppvObject = NULL;
+    return E_NOINTERFACE;
   }
-}
+
+  virtual ULONG STDMETHODCALLTYPE AddRef(void) override {
+    return InterlockedIncrement(&m_refCount);
+  }
+
+  virtual ULONG STDMETHODCALLTYPE Release(void) override {
+    LONG count = InterlockedDecrement(&m_refCount);
+    if (count == 0) {
+      delete this;
+    }
+    return count;
+  }
+
+  virtual HRESULT STDMETHODCALLTYPE Start(LPCWSTR szUrl, IInternetProtocolSink *pOIProtSink, IInternetBindInfo *, DWORD, HANDLE_PTR) override {
+    m_sink = pOIProtSink;
+    m_request = QSharedPointer<WinSchemeRequest>(new WinSchemeRequest(QUrl(QString::fromWCharArray(szUrl)), pOIProtSink));
+    SchemeHandlers::start(m_request);
+    return S_OK;
+  }
+
+  virtual HRESULT STDMETHODCALLTYPE Continue(PROTOCOLDATA *) override {
+    if (!m_request || !m_sink || m_request->isCancelled() || !m_request->isFinished()) {
+      return S_OK;
+    }
+    if (m_request->status() != 200) {
+      m_sink->ReportResult(INET_E_OBJECT_NOT_FOUND, m_request->status(), NULL);
+      return S_OK;
+    }
+    m_data = m_request->data();
+    m_position = 0;
+    wstring mime_type = QString::fromLatin1(m_request->mimeType()).toStdWString();
+    m_sink->ReportProgress(BINDSTATUS_VERIFIEDMIMETYPEAVAILABLE, mime_type.c_str());
+    ULONG size = ULONG(m_data.size());
+    m_sink->ReportData(BSCF_FIRSTDATANOTIFICATION | BSCF_LASTDATANOTIFICATION | BSCF_DATAFULLYAVAILABLE, size, size);
+    m_sink->ReportResult(S_OK, 200, NULL);
+    return S_OK;
+  }
+
+  virtual HRESULT STDMETHODCALLTYPE Abort(HRESULT hrReason, DWORD) override {
+    if (m_request) {
+      m_request->detach();
+      m_request->cancel();
+    }
+    if (m_sink) {
+      m_sink->ReportResult(hrReason, 0, NULL);
+    }
+    return S_OK;
+  }
+
+  virtual HRESULT STDMETHODCALLTYPE Terminate(DWORD) override {
+    if (m_request) {
+      m_request->detach();
+      m_request.clear();
+    }
+    m_sink.Release();
+    return S_OK;
+  }
+
+  virtual HRESULT STDMETHODCALLTYPE Suspend(void) override {
+    return E_NOTIMPL;
+  }
+
+  virtual HRESULT STDMETHODCALLTYPE Resume(void) override {
+    return E_NOTIMPL;
+  }
+
+  virtual HRESULT STDMETHODCALLTYPE Read(void *pv, ULONG cb, ULONG *pcbRead) override {
+    ULONG read = ULONG(qMin<qint64>(cb, m_data.size() - m_position));
+    memcpy(pv, m_data.constData() + m_position, read);
+    m_position += read;
+    if (pcbRead) {
+      *pcbRead = read;
+    }
+    return m_position < m_data.size() ? S_OK : S_FALSE;
+  }
+
+  virtual HRESULT STDMETHODCALLTYPE Seek(LARGE_INTEGER, DWORD, ULARGE_INTEGER *) override {
+    return E_FAIL;
+  }
+
+  virtual HRESULT STDMETHODCALLTYPE LockRequest(DWORD) override {
+    return S_OK;
+  }
+
+  virtual HRESULT STDMETHODCALLTYPE UnlockRequest(void) override {
+    return S_OK;
+  }
+
+private:
+  ~WinSchemeProtocol() {
+    if (m_request) {
+      m_request->detach();
+    }
+  }
+
+  LONG m_refCount;
+  CComPtr<IInternetProtocolSink> m_sink;
+  QSharedPointer<WinSchemeRequest> m_request;
+  QByteArray m_data;
+  qint64 m_position;
+};
+
+// Creates the protocol for the URL monikers; one static instance serves
+// every scheme it is registered for, for the life of the process.
+template <class Protocol>
+class WinProtocolFactory : public IClassFactory {
+public:
+  virtual HRESULT STDMETHODCALLTYPE QueryInterface(REFIID riid, void **ppvObject) override {
+    if (riid == __uuidof(IUnknown) || riid == __uuidof(IClassFactory)) {
+      *ppvObject = static_cast<IClassFactory*>(this);
+      return S_OK;
+    }
+    *ppvObject = NULL;
+    return E_NOINTERFACE;
+  }
+
+  virtual ULONG STDMETHODCALLTYPE AddRef(void) override {
+    return 1;
+  }
+
+  virtual ULONG STDMETHODCALLTYPE Release(void) override {
+    return 1;
+  }
+
+  virtual HRESULT STDMETHODCALLTYPE CreateInstance(IUnknown *pUnkOuter, REFIID riid, void **ppvObject) override {
+    if (pUnkOuter) {
+      *ppvObject = NULL;
+      return CLASS_E_NOAGGREGATION;
+    }
+    Protocol *protocol = new Protocol();
+    HRESULT hr = protocol->QueryInterface(riid, ppvObject);
+    protocol->Release();
+    return hr;
+  }
+
+  virtual HRESULT STDMETHODCALLTYPE LockServer(BOOL) override {
+    return S_OK;
+  }
+};
 
 } // anonymous
 
@@ -331,16 +558,24 @@ class WinNativeBrowserImpl
 {
 public:
     WinNativeBrowserImpl(HWND _mainWindow)
-        : m_DWebBrowserEvents2_conn_id(0)
-        , document_start_emited(false)
-        , load_progress_crunch(new QTimer(this))
+        : m_controlWindow(NULL)
+        , m_filterWindow(NULL)
+        , m_documentWindow(NULL)
+        , m_DWebBrowserEvents2_conn_id(0)
+        , m_htmlPending(false)
+        , m_htmlDocumentEvents_conn_id(0)
     {
-        load_progress_crunch->setSingleShot(true);
         m_comRefCount = 0;
         m_mainWindow = _mainWindow;
+        ::SetRect(&m_objectRect, 0, 0, 0, 0);
+        {
+            QMutexLocker lock(&InstancesMutex());
+            Instances().append(this);
+        }
 
-        // enable current IE core use
-        SetBrowserFeatureControl();
+        // enable current IE core use, done once per process
+        static RegistryFeatureStore registry;
+        BrowserFeatureControl::initialize(&registry);
 
         CreateBrowserObject();
 
@@ -350,18 +585,59 @@ public:
 
     virtual ~WinNativeBrowserImpl()
     {
+        {
+            QMutexLocker lock(&InstancesMutex());
+            Instances().removeOne(this);
+        }
+        if (m_documentWindow != NULL)
+            ::RemoveWindowSubclass(m_documentWindow, &DocumentWindowProc, 0);
+        UnadviseHtmlDocument();
         CloseBrowserObject();
-        delete load_progress_crunch;
     }
 
     virtual void navigate(const QString &_url) override
     {
         QString new_url(_url.isEmpty() ? "about:blank" : _url);
-        current_url_host = QUrl::fromUserInput(new_url).host();
+        m_htmlPending = false;
+        m_html = QByteArray();
+        UnadviseHtmlDocument();
         bstr_t url(new_url.toStdWString().c_str());
         variant_t flags(navNoHistory);
-        document_start_emited = false;
-        m_webBrowser->Navigate(url, &flags, NULL, NULL, NULL);
+        HRESULT hr = m_webBrowser->Navigate(url, &flags, NULL, NULL, NULL);
+        if (FAILED(hr))
+        {
+            EventLog::record(EventLog::NavigateFailed, instanceId(), new_url, hr);
+            onNavigateFailed();
+        }
+    }
+
+    virtual void navigateToHtml(const QByteArray &html, const QUrl &base_url) override
+    {
+        // the document is streamed into the about:blank document once it is ready
+        UnadviseHtmlDocument();
+        m_html = html;
+        m_htmlBase = base_url;
+        m_htmlPending = true;
+        bstr_t url(L"about:blank");
+        variant_t flags(navNoHistory);
+        HRESULT hr = m_webBrowser->Navigate(url, &flags, NULL, NULL, NULL);
+        if (FAILED(hr))
+        {
+            m_htmlPending = false;
+            m_html = QByteArray();
+            EventLog::record(EventLog::NavigateFailed, instanceId(), hr);
+            onNavigateFailed();
+        }
+    }
+
+    virtual void reparent(WId window) override
+    {
+        m_mainWindow = reinterpret_cast<HWND>(window);
+        HWND control = GetControlWindow();
+        if (control != NULL)
+        {
+            ::SetParent(control, m_mainWindow);
+        }
     }
 
     QString location() const
@@ -384,7 +660,7 @@ public:
             m_webBrowser->Stop();
     }
 
-    virtual QSize sizeHint() const override
+    virtual QSize contentSize() const override
     {
         QSize result;
         if (m_webBrowser == 0)
@@ -417,6 +693,97 @@ public:
         return result;
     }
 
+    virtual QByteArray serializeDocument() const override
+    {
+        // the live DOM, the engine keeps no copy of the source it received
+        CComPtr<IHTMLDocument3> document3;
+        CComPtr<IHTMLDocument2> html = Document();
+        if (html != 0)
+            html.QueryInterface(&document3);
+        CComPtr<IHTMLElement> root;
+        if (document3 != 0)
+            document3->get_documentElement(&root);
+        bstr_t outer;
+        if (root == 0 || FAILED(root->get_outerHTML(outer.GetAddress())) || outer.length() == 0)
+            return QByteArray();
+        // a BOM outranks the page's own charset declaration, the doctype
+        // keeps standards mode
+        QByteArray result("\xEF\xBB\xBF");
+        CComPtr<IHTMLDocument5> document5;
+        html.QueryInterface(&document5);
+        bstr_t mode;
+        if (document5 != 0 && SUCCEEDED(document5->get_compatMode(mode.GetAddress())) && mode.length() && wcscmp(mode, L"CSS1Compat") == 0)
+            result += "<!DOCTYPE html>";
+        return result + QString::fromWCharArray(outer, int(outer.length())).toUtf8();
+    }
+
+    virtual QPoint scrollPosition() const override
+    {
+        CComPtr<IHTMLDocument2> html = Document();
+        if (html == 0)
+        {
+            return QPoint();
+        }
+        // standards mode scrolls the root element, quirks mode the body
+        QPoint result;
+        CComPtr<IHTMLDocument3> document3;
+        html.QueryInterface(&document3);
+        CComPtr<IHTMLElement> root;
+        if (document3 != 0)
+            document3->get_documentElement(&root);
+        CComPtr<IHTMLElement> body;
+        html->get_body(&body);
+        IHTMLElement *elements[] = { root, body };
+        for (IHTMLElement *element : elements)
+        {
+            CComPtr<IHTMLElement2> element2;
+            if (element == NULL || FAILED(element->QueryInterface(IID_IHTMLElement2, reinterpret_cast<void**>(&element2))))
+                continue;
+            long x = 0, y = 0;
+            element2->get_scrollLeft(&x);
+            element2->get_scrollTop(&y);
+            result.setX(qMax(result.x(), int(x)));
+            result.setY(qMax(result.y(), int(y)));
+        }
+        return result;
+    }
+
+    virtual void setScrollPosition(const QPoint &position) override
+    {
+        CComPtr<IHTMLDocument2> html = Document();
+        CComPtr<IHTMLWindow2> window;
+        if (html != 0)
+            html->get_parentWindow(&window);
+        if (window != 0)
+            window->scrollTo(position.x(), position.y());
+    }
+
+    virtual void applyLifecycleState(NativeBrowser::LifecycleState state) override
+    {
+        if (state == NativeBrowser::Active)
+        {
+            // back in place, the document is visible and timers run at full rate again
+            m_oleObject->DoVerb(OLEIVERB_INPLACEACTIVATE, NULL, this, -1, m_mainWindow, &m_objectRect);
+            HWND control = GetControlWindow();
+            if (control != NULL)
+                ::ShowWindow(control, SW_SHOW);
+            return;
+        }
+        // a hidden document is not painted and the engine (IE10 and later)
+        // slows its timers down to once a second; it cannot pause script,
+        // Frozen is the same here, Stop() would cut off a running load
+        m_oleObject->DoVerb(OLEIVERB_HIDE, NULL, this, -1, m_mainWindow, &m_objectRect);
+    }
+
+    virtual void applyLoadProfile(NativeBrowser::LoadProfile) override
+    {
+        // the engine asks for DISPID_AMBIENT_DLCONTROL again, the host CSS is
+        // read when the next document is created
+        CComPtr<IOleControl> control;
+        if (m_oleObject != 0 && SUCCEEDED(m_oleObject.QueryInterface(&control)))
+            control->OnAmbientPropertyChange(DISPID_AMBIENT_DLCONTROL);
+    }
+
     virtual void setSize(const QSize& size) override
     {
         ::SetRect(&m_objectRect, 0, 0, size.width(), size.height());
@@ -435,14 +802,54 @@ public:
         }
     }
 
+    // false for a subresource the blocklist covers, window is where the
+    // engine shows the binding UI of the request; documents were already
+    // decided in BeforeNavigate2. Runs on URLMon's binding threads, so it
+    // only touches what the browsers share under the instances lock
+    static bool AllowsRequest(HWND window, const QString &url)
+    {
+        QSharedPointer<const RequestBlocklist> blocklist = requestBlocklist();
+        if (!blocklist || window == NULL)
+            return true;
+        QMutexLocker lock(&InstancesMutex());
+        for (WinNativeBrowserImpl *browser : Instances())
+        {
+            HWND control = browser->m_filterWindow;
+            if (control == NULL || (window != control && !::IsChild(control, window)))
+                continue;
+            if (browser->m_navigations.remove(url))
+                return true;
+            bool blocked = blocklist->isBlocked(url);
+            // the counters belong to the GUI thread, a browser destroyed
+            // meanwhile drops the call
+            QMetaObject::invokeMethod(browser, "countRequest", Qt::QueuedConnection,
+                                      Q_ARG(QString, url), Q_ARG(bool, blocked));
+            return !blocked;
+        }
+        // requests of no browser of ours, downloads for instance, pass
+        return true;
+    }
+
 private:
+    static QList<WinNativeBrowserImpl*> &Instances()
+    {
+        static QList<WinNativeBrowserImpl*> instances;
+        return instances;
+    }
+
+    // guards Instances() and the browsers' m_filterWindow and m_navigations
+    static QMutex &InstancesMutex()
+    {
+        static QMutex mutex;
+        return mutex;
+    }
 
 
     void CreateBrowserObject()
     {
         HRESULT hr = ::OleCreate(CLSID_WebBrowser, IID_IOleObject, OLERENDER_DRAW, 0, this, this, (void**)&m_oleObject);
         if(FAILED(hr))
-            qCritical() << "WinNativeBrowserImpl: OleCreate() failed";
+            EventLog::record(EventLog::EngineCreateFailed, instanceId(), hr);
 
         hr = m_oleObject->SetClientSite(this);
         hr = OleSetContainedObject(m_oleObject, TRUE);
@@ -451,11 +858,13 @@ private:
         ::SetRect(&posRect, -300, -300, 300, 300);
         hr = m_oleObject->DoVerb(OLEIVERB_INPLACEACTIVATE,NULL, this, -1, m_mainWindow, &posRect);
         if(FAILED(hr))
-            qCritical() << "WinNativeBrowserImpl: DoVerb(OLEIVERB_INPLACEACTIVATE) failed";
+            EventLog::record(EventLog::EngineCreateFailed, instanceId(), hr);
+        // publishes the window WinRequestFilter knows the browser by
+        GetControlWindow();
 
         hr = m_oleObject.QueryInterface(&m_webBrowser);
         if(FAILED(hr))
-            qCritical() << "WinNativeBrowserImpl: QueryInterface(IWebBrowser) failed";
+            EventLog::record(EventLog::EngineCreateFailed, instanceId(), hr);
 
         AdviseWebBrowser(__uuidof(DWebBrowserEvents2), &m_DWebBrowserEvents2_conn_id);
     }
@@ -473,6 +882,88 @@ private:
         m_oleObject->SetClientSite(NULL);
     }
 
+    CComPtr<IHTMLDocument2> Document() const
+    {
+        CComPtr<IHTMLDocument2> html;
+        if (m_webBrowser == 0)
+            return html;
+        CComPtr<IDispatch> disp;
+        m_webBrowser->get_Document(&disp);
+        if (disp != 0)
+            disp.QueryInterface(&html);
+        return html;
+    }
+
+    bool LoadPendingHtml()
+    {
+        QByteArray html = m_html;
+        m_html = QByteArray();
+        m_htmlPending = false;
+
+        CComPtr<IDispatch> disp;
+        m_webBrowser->get_Document(&disp);
+        CComPtr<IPersistStreamInit> persist;
+        if (disp != 0)
+            disp.QueryInterface(&persist);
+        if (persist == 0)
+        {
+            EventLog::record(EventLog::HtmlLoadFailed, instanceId(), E_NOINTERFACE);
+            return false;
+        }
+
+        QByteArray base_tag;
+        if (m_htmlBase.isValid())
+        {
+            base_tag = "<base href=\"" + m_htmlBase.toEncoded().replace('"', "%22") + "\">";
+        }
+        CComPtr<IStream> stream;
+        stream.Attach(new ByteArrayStream(html, base_tag, BaseTagPosition(html)));
+        HRESULT hr = persist->InitNew();
+        if (SUCCEEDED(hr))
+            hr = persist->Load(stream);
+        if (FAILED(hr))
+        {
+            EventLog::record(EventLog::HtmlLoadFailed, instanceId(), hr);
+            return false;
+        }
+
+        // Load() returns while the document is still being parsed and its
+        // subresources load, it is complete once its readyState says so
+        hr = disp.QueryInterface(&m_htmlDocument);
+        if (SUCCEEDED(hr))
+            hr = AtlAdvise(m_htmlDocument, static_cast<DWebBrowserEvents2*>(this), __uuidof(HTMLDocumentEvents2), &m_htmlDocumentEvents_conn_id);
+        if (FAILED(hr))
+        {
+            m_htmlDocument = NULL;
+            EventLog::record(EventLog::EngineAdviseFailed, instanceId(), hr);
+            return false;
+        }
+        CheckHtmlReadyState();
+        return true;
+    }
+
+    // finishes the load of navigateToHtml() once the streamed document is complete
+    void CheckHtmlReadyState()
+    {
+        bstr_t state;
+        if (m_htmlDocument == 0 || FAILED(m_htmlDocument->get_readyState(state.GetAddress())) || state != bstr_t(L"complete"))
+            return;
+        UnadviseHtmlDocument();
+        CountDocumentWindow();
+        onDocumentComplete(true);
+    }
+
+    void UnadviseHtmlDocument()
+    {
+        if (m_htmlDocument == 0)
+            return;
+        HRESULT hr = AtlUnadvise(m_htmlDocument, __uuidof(HTMLDocumentEvents2), m_htmlDocumentEvents_conn_id);
+        if (FAILED(hr))
+            EventLog::record(EventLog::EngineUnadviseFailed, instanceId(), hr);
+        m_htmlDocument = NULL;
+        m_htmlDocumentEvents_conn_id = 0;
+    }
+
     void AdviseWebBrowser(const IID& iid, DWORD *connection_id)
     {
         if(m_webBrowser == NULL) {
@@ -486,17 +977,19 @@ private:
             hr = pCPC->FindConnectionPoint(iid, &pCP);
             if (SUCCEEDED(hr)) {
                 hr = pCP->Advise(static_cast<DWebBrowserEvents2*>(this), connection_id);
+                if (FAILED(hr))
+                    EventLog::record(EventLog::EngineAdviseFailed, instanceId(), hr);
                 pCP->Release();
             }
             else
             {
-                qCritical() << "WinNativeBrowserImpl: Advise iWebBrowser2->FindConnectionPoint(IID, IConnectionPoint) failed";
+                EventLog::record(EventLog::EngineAdviseFailed, instanceId(), hr);
             }
             pCPC->Release();
         }
         else
         {
-            qCritical() << "WinNativeBrowserImpl: Advise iWebBrowser2->QueryInterface(IID_IConnectionPointContainer, IConnectionPointContainer) failed";
+            EventLog::record(EventLog::EngineAdviseFailed, instanceId(), hr);
         }
     }
 
@@ -513,38 +1006,33 @@ private:
             hr = pCPC->FindConnectionPoint(iid, &pCP);
             if (SUCCEEDED(hr)) {
                 hr = pCP->Unadvise(connection_id);
+                if (FAILED(hr))
+                    EventLog::record(EventLog::EngineUnadviseFailed, instanceId(), hr);
                 pCP->Release();
             }
             else
             {
-                qCritical() << "WinNativeBrowserImpl: Unadvise iWebBrowser2->FindConnectionPoint(IID, IConnectionPoint) failed";
+                EventLog::record(EventLog::EngineUnadviseFailed, instanceId(), hr);
             }
             pCPC->Release();
         }
         else
         {
-            qCritical() << "WinNativeBrowserImpl: Unadvise iWebBrowser2->QueryInterface(IID_IConnectionPointContainer, IConnectionPointContainer) failed";
+            EventLog::record(EventLog::EngineUnadviseFailed, instanceId(), hr);
         }
     }
 
     RECT PixelToHiMetric(const RECT& _rc)
     {
-        static bool s_initialized = false;
-        static int s_pixelsPerInchX, s_pixelsPerInchY;
-        if(!s_initialized)
-        {
-            HDC hdc = ::GetDC(NULL);
-            s_pixelsPerInchX = ::GetDeviceCaps(hdc, LOGPIXELSX);
-            s_pixelsPerInchY = ::GetDeviceCaps(hdc, LOGPIXELSY);
-            ::ReleaseDC(NULL, hdc);
-            s_initialized = true;
-        }
+        // the resolution of the monitor the browser is on right now
+        int pixelsPerInchX, pixelsPerInchY;
+        MonitorDpiCache::instance().dpiFor(m_mainWindow, &pixelsPerInchX, &pixelsPerInchY);
 
         RECT rc;
-        rc.left = MulDiv(2540, _rc.left, s_pixelsPerInchX);
-        rc.top = MulDiv(2540, _rc.top, s_pixelsPerInchY);
-        rc.right = MulDiv(2540, _rc.right, s_pixelsPerInchX);
-        rc.bottom = MulDiv(2540, _rc.bottom, s_pixelsPerInchY);
+        rc.left = MulDiv(2540, _rc.left, pixelsPerInchX);
+        rc.top = MulDiv(2540, _rc.top, pixelsPerInchY);
+        rc.right = MulDiv(2540, _rc.right, pixelsPerInchX);
+        rc.bottom = MulDiv(2540, _rc.bottom, pixelsPerInchY);
         return rc;
     }
 
@@ -558,7 +1046,7 @@ private:
             (*ppvObject) = static_cast<IOleInPlaceSite*>(this);
         } else if(riid == __uuidof(IDocHostUIHandler)) {
             (*ppvObject) = static_cast<IDocHostUIHandler*>(this);
-        } else if(riid == __uuidof(DWebBrowserEvents2)) {
+        } else if(riid == __uuidof(DWebBrowserEvents2) || riid == __uuidof(HTMLDocumentEvents2)) {
             (*ppvObject) = static_cast<DWebBrowserEvents2*>(this);
         } else if(riid == __uuidof(IDispatch)) {
             (*ppvObject) = static_cast<IDispatch*>(this);
@@ -661,12 +1149,18 @@ private:
             return NULL;
 
         m_oleInPlaceObject->GetWindow(&m_controlWindow);
+        QMutexLocker lock(&InstancesMutex());
+        m_filterWindow = m_controlWindow;
         return m_controlWindow;
     }
 
     virtual HRESULT STDMETHODCALLTYPE OnInPlaceDeactivate(void) override
     {
         m_controlWindow = NULL;
+        {
+            QMutexLocker lock(&InstancesMutex());
+            m_filterWindow = NULL;
+        }
         m_oleInPlaceObject = NULL;
 
         return S_OK;
@@ -853,14 +1347,11 @@ private:
 
     virtual HRESULT STDMETHODCALLTYPE GetHostInfo(DOCHOSTUIINFO *pInfo) override
     {
-        const OLECHAR* szCSS = L"a:link{ color:blue; } a:visited{ color:blue; }";
-
-        #define CCHMAX 256
-        size_t cchLengthCSS;
+        wstring css = L"a:link{ color:blue; } a:visited{ color:blue; }";
+        css += profileStyleSheet(loadProfile()).toStdWString();
 
-        HRESULT hr = StringCchLengthW(szCSS, CCHMAX, &cchLengthCSS);
-        OLECHAR* pCSSBuffer = (OLECHAR*)CoTaskMemAlloc((cchLengthCSS + 1) * sizeof(OLECHAR));
-        hr = StringCchCopyW(pCSSBuffer, cchLengthCSS + 1, szCSS);
+        OLECHAR* pCSSBuffer = (OLECHAR*)CoTaskMemAlloc((css.size() + 1) * sizeof(OLECHAR));
+        StringCchCopyW(pCSSBuffer, css.size() + 1, css.c_str());
 
         pInfo->cbSize = sizeof(DOCHOSTUIINFO);
         pInfo->dwFlags = DOCHOSTUIFLAG_NO3DBORDER | DOCHOSTUIFLAG_NO3DOUTERBORDER;
@@ -993,51 +1484,71 @@ private:
             return DISP_E_UNKNOWNINTERFACE;
         }
 
+        CpuTimeScope cpu(this);
         switch (dispIdMember)
         {
+        case DISPID_AMBIENT_DLCONTROL:
+            if (pVarResult)
+            {
+                pVarResult->vt = VT_I4;
+                pVarResult->lVal = DownloadControlFlags();
+            }
+            break;
         case DISPID_BEFORENAVIGATE2:
         {
             QString navigate_url = QString::fromWCharArray(pDispParams->rgvarg[5].pvarVal->bstrVal);
-            QString navigate_url_host = QUrl::fromUserInput(navigate_url).host();
-            if (current_url_host != navigate_url_host)
+            bool top_frame = IsTopFrame(pDispParams->rgvarg[6].pdispVal);
+            if (!onBeforeNavigate(navigate_url, top_frame))
             {
-                if (!document_start_emited && navigate_url != "about:blank")
-                {
-                    // skip navigate
-                    *pDispParams->rgvarg[0].pboolVal = VARIANT_TRUE;
-                    if (navigate_url_host != "ieframe.dll")
-                    {
-                        onExternalNavigate(navigate_url);
-                    }
-                }
+                // skip navigate
+                *pDispParams->rgvarg[0].pboolVal = VARIANT_TRUE;
+                break;
             }
-            else
+            if (top_frame)
+                UnadviseHtmlDocument();
+            // WinRequestFilter lets the document through unchecked
+            QMutexLocker lock(&InstancesMutex());
+            if (top_frame)
+                m_navigations.clear();
+            m_navigations.insert(navigate_url);
+            break;
+        }
+        case DISPID_NAVIGATECOMPLETE2:
+            onNavigateComplete(IsTopFrame(pDispParams->rgvarg[1].pdispVal));
+            break;
+        case DISPID_NAVIGATEERROR:
+            onNavigateError(IsTopFrame(pDispParams->rgvarg[4].pdispVal));
+            break;
+        case DISPID_DOCUMENTCOMPLETE:
+        {
+            bool top_frame = IsTopFrame(pDispParams->rgvarg[1].pdispVal);
+            // the about:blank document is complete, the HTML is streamed into
+            // it and CheckHtmlReadyState() reports the load complete
+            if (top_frame && m_htmlPending)
             {
-                if (!document_start_emited)
-                {
-                    document_start_emited = true;
-                    load_progress_crunch->disconnect(this);
-                    connect(load_progress_crunch, SIGNAL(timeout()), this, SLOT(navigateNotStarted()));
-                    load_progress_crunch->start(5000);
-                    onLoadStart();
-                }
+                if (LoadPendingHtml())
+                    break;
+                onNavigateError(true);
             }
+            // the streamed document does not report here reliably, its readyState does
+            if (top_frame && m_htmlDocument != 0)
+                break;
+            if (top_frame)
+                CountDocumentWindow();
+            onDocumentComplete(top_frame);
             break;
         }
+        case DISPID_HTMLDOCUMENTEVENTS2_ONREADYSTATECHANGE:
+            CheckHtmlReadyState();
+            break;
         case DISPID_NEWWINDOW3:
             *pDispParams->rgvarg[3].pboolVal = VARIANT_TRUE;
-            onExternalNavigate(QString::fromWCharArray(pDispParams->rgvarg[0].bstrVal));
+            onNewWindow(QString::fromWCharArray(pDispParams->rgvarg[0].bstrVal));
             break;
         case DISPID_PROGRESSCHANGE:
         {
             LONG nProgressMax = pDispParams->rgvarg[0].lVal;
             LONG nProgress = pDispParams->rgvarg[1].lVal;
-            if (load_progress_crunch->isActive())
-            {
-                load_progress_crunch->disconnect(this);
-                connect(load_progress_crunch, SIGNAL(timeout()), this, SLOT(navigateFinished()));
-                load_progress_crunch->start(600);
-            }
             onProgress(nProgress, nProgressMax);
             break;
         }
@@ -1046,19 +1557,61 @@ private:
         return S_OK;
     }
 
-    void navigateNotStarted() override
+    // what the engine may download and run for the load profile; silent
+    // like put_Silent(), which an answered DLCONTROL would otherwise undo
+    long DownloadControlFlags() const
+    {
+        int features = loadFeatures(loadProfile());
+        long flags = DLCTL_SILENT;
+        if (features & LoadImages)
+            flags |= DLCTL_DLIMAGES;
+        if (features & LoadPlugins)
+            flags |= DLCTL_VIDEOS | DLCTL_BGSOUNDS;
+        else
+            flags |= DLCTL_NO_JAVA | DLCTL_NO_RUNACTIVEXCTLS | DLCTL_NO_DLACTIVEXCTLS;
+        if (!(features & LoadScripts))
+            flags |= DLCTL_NO_SCRIPTS | DLCTL_NO_BEHAVIORS | DLCTL_NO_CLIENTPULL;
+        return flags;
+    }
+
+    // painting and input of the document happen in its own window, its
+    // messages are counted towards cpuTime()
+    void CountDocumentWindow()
+    {
+        HWND control = GetControlWindow();
+        HWND view = control != NULL ? ::FindWindowEx(control, NULL, L"Shell DocObject View", NULL) : NULL;
+        HWND server = view != NULL ? ::FindWindowEx(view, NULL, L"Internet Explorer_Server", NULL) : NULL;
+        if (server == NULL || server == m_documentWindow)
+            return;
+        if (m_documentWindow != NULL)
+            ::RemoveWindowSubclass(m_documentWindow, &DocumentWindowProc, 0);
+        m_documentWindow = server;
+        ::SetWindowSubclass(m_documentWindow, &DocumentWindowProc, 0, reinterpret_cast<DWORD_PTR>(this));
+    }
+
+    static LRESULT CALLBACK DocumentWindowProc(HWND hwnd, UINT message, WPARAM wParam, LPARAM lParam, UINT_PTR, DWORD_PTR data)
     {
-        stop();
-        current_url_host = QUrl::fromUserInput(location()).host();
-        document_start_emited = false;
-        onLoadFinish(false);
+        WinNativeBrowserImpl *self = reinterpret_cast<WinNativeBrowserImpl*>(data);
+        if (message == WM_NCDESTROY)
+        {
+            ::RemoveWindowSubclass(hwnd, &DocumentWindowProc, 0);
+            self->m_documentWindow = NULL;
+            return ::DefSubclassProc(hwnd, message, wParam, lParam);
+        }
+        CpuTimeScope cpu(self);
+        return ::DefSubclassProc(hwnd, message, wParam, lParam);
     }
 
-    void navigateFinished() override
+    // events of frames carry the frame's IWebBrowser2, compare identities
+    bool IsTopFrame(IDispatch *frame) const
     {
-        current_url_host = QUrl::fromUserInput(location()).host();
-        document_start_emited = false;
-        onLoadFinish(true);
+        if (frame == NULL || m_webBrowser == NULL)
+            return false;
+        CComPtr<IUnknown> frameUnknown;
+        CComPtr<IUnknown> topUnknown;
+        frame->QueryInterface(IID_IUnknown, reinterpret_cast<void**>(&frameUnknown));
+        m_webBrowser->QueryInterface(IID_IUnknown, reinterpret_cast<void**>(&topUnknown));
+        return frameUnknown == topUnknown;
     }
 
 private:
@@ -1069,13 +1622,164 @@ private:
     CComPtr<IWebBrowser2> m_webBrowser;
     CComPtr<IOleInPlaceObject> m_oleInPlaceObject;
     HWND m_controlWindow;
+    // m_controlWindow for WinRequestFilter
+    HWND m_filterWindow;
+    HWND m_documentWindow;
     DWORD m_DWebBrowserEvents2_conn_id;
-    QString current_url_host;
-    bool document_start_emited;
-    QTimer *load_progress_crunch;
+    bool m_htmlPending;
+    QByteArray m_html;
+    QUrl m_htmlBase;
+    // the document navigateToHtml() streamed in, until it is complete
+    CComPtr<IHTMLDocument2> m_htmlDocument;
+    DWORD m_htmlDocumentEvents_conn_id;
+    // documents allowed in BeforeNavigate2 whose request has not started
+    QSet<QString> m_navigations;
+};
+
+namespace {
+
+// {8E3A51C2-64D0-4F7B-B1A9-0C25D7E4F396}
+static const CLSID CLSID_NativeBrowserRequestFilter =
+  { 0x8e3a51c2, 0x64d0, 0x4f7b, { 0xb1, 0xa9, 0x0c, 0x25, 0xd7, 0xe4, 0xf3, 0x96 } };
+
+// Namespace handler for http and https that sees every request of the
+// engine, images, scripts, style sheets and XHRs included, which
+// BeforeNavigate2 never reports. Requests the blocklist covers fail right
+// in Start(), all others go back to the default handler, so the rest of
+// IInternetProtocol is never called.
+class WinRequestFilter : public IInternetProtocol {
+public:
+  WinRequestFilter() : m_refCount(1) {
+  }
+
+  virtual HRESULT STDMETHODCALLTYPE QueryInterface(REFIID riid, void **ppvObject) override {
+    if (riid == __uuidof(IUnknown) || riid == __uuidof(IInternetProtocolRoot) || riid == __uuidof(IInternetProtocol)) {
+      *ppvObject = static_cast<IInternetProtocol*>(this);
+      AddRef();
+      return S_OK;
+    }
+    *ppvObject = NULL;
+    return E_NOINTERFACE;
+  }
+
+  virtual ULONG STDMETHODCALLTYPE AddRef(void) override {
+    return InterlockedIncrement(&m_refCount);
+  }
+
+  virtual ULONG STDMETHODCALLTYPE Release(void) override {
+    LONG count = InterlockedDecrement(&m_refCount);
+    if (count == 0) {
+      delete this;
+    }
+    return count;
+  }
+
+  virtual HRESULT STDMETHODCALLTYPE Start(LPCWSTR szUrl, IInternetProtocolSink *pOIProtSink, IInternetBindInfo *, DWORD, HANDLE_PTR) override {
+    if (WinNativeBrowserImpl::AllowsRequest(BindingWindow(pOIProtSink), QString::fromWCharArray(szUrl))) {
+      return INET_E_USE_DEFAULT_PROTOCOLHANDLER;
+    }
+    return INET_E_RESOURCE_NOT_FOUND;
+  }
+
+  virtual HRESULT STDMETHODCALLTYPE Continue(PROTOCOLDATA *) override {
+    return E_NOTIMPL;
+  }
+
+  virtual HRESULT STDMETHODCALLTYPE Abort(HRESULT, DWORD) override {
+    return E_NOTIMPL;
+  }
+
+  virtual HRESULT STDMETHODCALLTYPE Terminate(DWORD) override {
+    return S_OK;
+  }
+
+  virtual HRESULT STDMETHODCALLTYPE Suspend(void) override {
+    return E_NOTIMPL;
+  }
+
+  virtual HRESULT STDMETHODCALLTYPE Resume(void) override {
+    return E_NOTIMPL;
+  }
+
+  virtual HRESULT STDMETHODCALLTYPE Read(void *, ULONG, ULONG *) override {
+    return E_NOTIMPL;
+  }
+
+  virtual HRESULT STDMETHODCALLTYPE Seek(LARGE_INTEGER, DWORD, ULARGE_INTEGER *) override {
+    return E_NOTIMPL;
+  }
+
+  virtual HRESULT STDMETHODCALLTYPE LockRequest(DWORD) override {
+    return S_OK;
+  }
+
+  virtual HRESULT STDMETHODCALLTYPE UnlockRequest(void) override {
+    return S_OK;
+  }
+
+private:
+  ~WinRequestFilter() {
+  }
+
+  // the engine shows binding UI in the browser's own window
+  static HWND BindingWindow(IInternetProtocolSink *sink) {
+    HWND window = NULL;
+    CComPtr<IServiceProvider> provider;
+    CComPtr<IWindowForBindingUI> binding_ui;
+    if (sink != NULL
+        && SUCCEEDED(sink->QueryInterface(IID_IServiceProvider, reinterpret_cast<void**>(&provider)))
+        && SUCCEEDED(provider->QueryService(IID_IWindowForBindingUI, IID_IWindowForBindingUI, reinterpret_cast<void**>(&binding_ui)))) {
+      binding_ui->GetWindow(IID_IHttpSecurity, &window);
+    }
+    return window;
+  }
+
+  LONG m_refCount;
 };
 
+} // anonymous
+
 NativeBrowserImpl* NativeBrowserImpl::createNewInstance(WId browserwindow)
 {
     return new WinNativeBrowserImpl(reinterpret_cast<HWND>(browserwindow));
 }
+
+void NativeBrowserImpl::installRequestFilter()
+{
+    // once per process, every request passes the filter from then on
+    static WinProtocolFactory<WinRequestFilter> factory;
+    static bool registered = false;
+    if (registered)
+        return;
+    registered = true;
+
+    CComPtr<IInternetSession> session;
+    HRESULT hr = CoInternetGetSession(0, &session, 0);
+    const wchar_t *schemes[] = { L"http", L"https" };
+    for (const wchar_t *scheme : schemes)
+    {
+        if (SUCCEEDED(hr))
+            hr = session->RegisterNameSpace(&factory, CLSID_NativeBrowserRequestFilter, scheme, 0, NULL, 0);
+        if (FAILED(hr))
+            EventLog::record(EventLog::SchemeRegisterFailed, 0, QString::fromWCharArray(scheme), hr);
+    }
+}
+
+void NativeBrowserImpl::registerScheme(const QString &scheme)
+{
+    static WinProtocolFactory<WinSchemeProtocol> factory;
+    static QSet<QString> registered;
+    if (registered.contains(scheme))
+        return;
+
+    CComPtr<IInternetSession> session;
+    HRESULT hr = CoInternetGetSession(0, &session, 0);
+    if (SUCCEEDED(hr))
+        hr = session->RegisterNameSpace(&factory, CLSID_NativeBrowserSchemeProtocol, scheme.toStdWString().c_str(), 0, NULL, 0);
+    if (FAILED(hr))
+    {
+        EventLog::record(EventLog::SchemeRegisterFailed, 0, scheme, hr);
+        return;
+    }
+    registered.insert(scheme);
+}
@@ -0,0 +1,246 @@
+#include "nativebrowsermetrics.h"
+
+#include <QCoreApplication>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QLocalServer>
+#include <QLocalSocket>
+#include <QSaveFile>
+
+namespace {
+
+struct MetricInfo
+{
+    const char *name;
+    const char *help;
+};
+
+// indexed by NativeBrowserMetrics::Counter
+static const MetricInfo counter_info[NativeBrowserMetrics::CounterCount] = {
+    { "navigations_requested", "Navigations requested with load() or setHtml()." },
+    { "navigations_started", "Navigations the engine started loading." },
+    { "navigations_succeeded", "Navigations that finished successfully." },
+    { "navigations_failed", "Navigations that finished with an error." },
+    { "navigations_timed_out", "Navigations finished by the fallback timer." },
+    { "navigations_abandoned", "Navigations superseded or cancelled before they finished." },
+    { "navigations_saved", "Requests answered without an engine navigation." },
+    { "external_navigations", "Navigations handed to externalNavigate." },
+    { "new_window_requests", "Pages asking for a new window." },
+    { "requests_checked", "Requests checked against the request blocklist." },
+    { "requests_blocked", "Requests blocked by the request blocklist." },
+    { "progress_events", "Progress events reported by the engines." },
+    { "backends_created", "Engine backends created." },
+    { "engine_cpu_seconds", "GUI-thread CPU time spent in the engines." },
+};
+
+static const MetricInfo gauge_info[NativeBrowserMetrics::GaugeCount] = {
+    { "live_backends", "Engine backends alive, pooled ones included." },
+};
+
+static const MetricInfo histogram_info[NativeBrowserMetrics::HistogramCount] = {
+    { "load_seconds", "load() to finish of successful navigations." },
+    { "failed_load_seconds", "load() to finish of failed navigations." },
+    { "queue_wait_seconds", "Time navigations waited for a LoadScheduler slot." },
+};
+
+static const char prefix[] = "nativebrowser_";
+
+static QByteArray Seconds(qint64 nsecs)
+{
+    return QByteArray::number(double(nsecs) / 1e9, 'g', 9);
+}
+
+// reset by the destructor, the metrics go with the application
+static NativeBrowserMetrics *metrics = 0;
+
+} // anonymous
+
+const int NativeBrowserMetrics::bucket_bounds[NativeBrowserMetrics::BucketCount - 1] = {
+    10, 25, 50, 100, 250, 500, 1000, 2500, 5000, 10000, 30000
+};
+
+NativeBrowserMetrics *NativeBrowserMetrics::instance()
+{
+    if (!metrics)
+    {
+        metrics = new NativeBrowserMetrics(QCoreApplication::instance());
+    }
+    return metrics;
+}
+
+NativeBrowserMetrics::NativeBrowserMetrics(QObject *parent)
+    : QObject(parent)
+    , server(0)
+    , server_format(Prometheus)
+{
+    for (int i = 0; i < GaugeCount; ++i)
+        gauges[i].store(0, std::memory_order_relaxed);
+    reset();
+}
+
+NativeBrowserMetrics::~NativeBrowserMetrics()
+{
+    if (metrics == this)
+        metrics = 0;
+}
+
+void NativeBrowserMetrics::observe(Histogram histogram, qint64 nsecs)
+{
+    if (nsecs < 0)
+        return;
+    int bucket = 0;
+    while (bucket < BucketCount - 1 && nsecs > qint64(bucket_bounds[bucket]) * 1000000)
+        ++bucket;
+    HistogramSlots &histogram_slots = histograms[histogram];
+    histogram_slots.buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+    histogram_slots.count.fetch_add(1, std::memory_order_relaxed);
+    histogram_slots.sum.fetch_add(nsecs, std::memory_order_relaxed);
+}
+
+quint64 NativeBrowserMetrics::counter(Counter counter) const
+{
+    return counters[counter].load(std::memory_order_relaxed);
+}
+
+qint64 NativeBrowserMetrics::gauge(Gauge gauge) const
+{
+    return gauges[gauge].load(std::memory_order_relaxed);
+}
+
+quint64 NativeBrowserMetrics::histogramCount(Histogram histogram) const
+{
+    return histograms[histogram].count.load(std::memory_order_relaxed);
+}
+
+QByteArray NativeBrowserMetrics::toPrometheus() const
+{
+    QByteArray text;
+    for (int i = 0; i < CounterCount; ++i)
+    {
+        QByteArray name = prefix + QByteArray(counter_info[i].name) + "_total";
+        quint64 value = counter(Counter(i));
+        text += "# HELP " + name + ' ' + counter_info[i].help + '\n';
+        text += "# TYPE " + name + " counter\n";
+        text += name + ' ' + (i == EngineCpuTime ? Seconds(qint64(value)) : QByteArray::number(value)) + '\n';
+    }
+    for (int i = 0; i < GaugeCount; ++i)
+    {
+        QByteArray name = prefix + QByteArray(gauge_info[i].name);
+        text += "# HELP " + name + ' ' + gauge_info[i].help + '\n';
+        text += "# TYPE " + name + " gauge\n";
+        text += name + ' ' + QByteArray::number(gauge(Gauge(i))) + '\n';
+    }
+    for (int i = 0; i < HistogramCount; ++i)
+    {
+        const HistogramSlots &histogram_slots = histograms[i];
+        QByteArray name = prefix + QByteArray(histogram_info[i].name);
+        text += "# HELP " + name + ' ' + histogram_info[i].help + '\n';
+        text += "# TYPE " + name + " histogram\n";
+        // buckets are cumulative in the exposition format
+        quint64 cumulative = 0;
+        for (int bucket = 0; bucket < BucketCount; ++bucket)
+        {
+            cumulative += histogram_slots.buckets[bucket].load(std::memory_order_relaxed);
+            QByteArray bound = bucket < BucketCount - 1 ? Seconds(qint64(bucket_bounds[bucket]) * 1000000) : QByteArray("+Inf");
+            text += name + "_bucket{le=\"" + bound + "\"} " + QByteArray::number(cumulative) + '\n';
+        }
+        text += name + "_sum " + Seconds(histogram_slots.sum.load(std::memory_order_relaxed)) + '\n';
+        text += name + "_count " + QByteArray::number(histogram_slots.count.load(std::memory_order_relaxed)) + '\n';
+    }
+    return text;
+}
+
+QJsonObject NativeBrowserMetrics::toJson() const
+{
+    QJsonObject counter_values;
+    for (int i = 0; i < CounterCount; ++i)
+        counter_values[counter_info[i].name] = double(counter(Counter(i)));
+    QJsonObject gauge_values;
+    for (int i = 0; i < GaugeCount; ++i)
+        gauge_values[gauge_info[i].name] = double(gauge(Gauge(i)));
+    QJsonObject histogram_values;
+    for (int i = 0; i < HistogramCount; ++i)
+    {
+        const HistogramSlots &histogram_slots = histograms[i];
+        QJsonArray buckets;
+        for (int bucket = 0; bucket < BucketCount; ++bucket)
+        {
+            QJsonObject entry;
+            entry["le_ms"] = bucket < BucketCount - 1 ? QJsonValue(bucket_bounds[bucket]) : QJsonValue("+Inf");
+            entry["count"] = double(histogram_slots.buckets[bucket].load(std::memory_order_relaxed));
+            buckets.append(entry);
+        }
+        QJsonObject histogram;
+        histogram["buckets"] = buckets;
+        histogram["count"] = double(histogram_slots.count.load(std::memory_order_relaxed));
+        histogram["sum_ns"] = double(histogram_slots.sum.load(std::memory_order_relaxed));
+        histogram_values[histogram_info[i].name] = histogram;
+    }
+
+    QJsonObject result;
+    result["counters"] = counter_values;
+    result["gauges"] = gauge_values;
+    result["histograms"] = histogram_values;
+    return result;
+}
+
+QByteArray NativeBrowserMetrics::dump(Format format) const
+{
+    if (format == Json)
+        return QJsonDocument(toJson()).toJson(QJsonDocument::Compact);
+    return toPrometheus();
+}
+
+bool NativeBrowserMetrics::writeFile(const QString &file, Format format) const
+{
+    QSaveFile output(file);
+    if (!output.open(QIODevice::WriteOnly))
+        return false;
+    output.write(dump(format));
+    return output.commit();
+}
+
+bool NativeBrowserMetrics::listen(const QString &name, Format format)
+{
+    delete server;
+    server = 0;
+    if (name.isEmpty())
+        return true;
+    server_format = format;
+    server = new QLocalServer(this);
+    connect(server, SIGNAL(newConnection()), this, SLOT(serveConnections()));
+    // a server of a crashed process may have left the name behind
+    QLocalServer::removeServer(name);
+    if (!server->listen(name))
+    {
+        delete server;
+        server = 0;
+        return false;
+    }
+    return true;
+}
+
+void NativeBrowserMetrics::reset()
+{
+    for (int i = 0; i < CounterCount; ++i)
+        counters[i].store(0, std::memory_order_relaxed);
+    for (int i = 0; i < HistogramCount; ++i)
+    {
+        HistogramSlots &histogram_slots = histograms[i];
+        for (int bucket = 0; bucket < BucketCount; ++bucket)
+            histogram_slots.buckets[bucket].store(0, std::memory_order_relaxed);
+        histogram_slots.count.store(0, std::memory_order_relaxed);
+        histogram_slots.sum.store(0, std::memory_order_relaxed);
+    }
+}
+
+void NativeBrowserMetrics::serveConnections()
+{
+    while (server && server->hasPendingConnection())
+    {
+        QLocalSocket *socket = server->nextPendingConnection();
+        connect(socket, SIGNAL(disconnected()), socket, SLOT(deleteLater()));
+        socket->write(dump(server_format));
+        socket->disconnectFromServer();
+    }
+}
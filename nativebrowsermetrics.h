@@ -0,0 +1,117 @@
+#ifndef NATIVEBROWSERMETRICS_H
+#define NATIVEBROWSERMETRICS_H
+
+#include <QByteArray>
+#include <QJsonObject>
+#include <QObject>
+
+#include <atomic>
+
+class QLocalServer;
+
+// Process-wide counters and load time histograms of all browsers, updated
+// by NativeBrowserImpl as its engine reports events. Updates are relaxed
+// atomic increments on fixed slots, nothing is allocated or locked, so they
+// can stay on in production. The registry is read on demand: as Prometheus
+// text or JSON, written to a file or served on a local socket for an agent
+// to scrape.
+class NativeBrowserMetrics : public QObject
+{
+    Q_OBJECT
+    Q_DISABLE_COPY(NativeBrowserMetrics)
+public:
+    enum Counter
+    {
+        NavigationsRequested,  // load() and setHtml()
+        NavigationsStarted,    // the engine started loading
+        NavigationsSucceeded,
+        NavigationsFailed,
+        NavigationsTimedOut,   // finished by the fallback timer, failed or not
+        NavigationsAbandoned,  // superseded or cancelled before they finished
+        NavigationsSaved,      // collapsed, debounced or fresh, no engine navigation
+        ExternalNavigations,   // handed to externalNavigate
+        NewWindowRequests,     // pages asking for a window, also external
+        RequestsChecked,       // against the request blocklist
+        RequestsBlocked,
+        ProgressEvents,        // from the engine, before coalescing
+        BackendsCreated,
+        EngineCpuTime,         // CpuTimeScope time of all browsers, ns
+        CounterCount
+    };
+
+    enum Gauge
+    {
+        LiveBackends,
+        GaugeCount
+    };
+
+    enum Histogram
+    {
+        LoadTime,       // load() to finished, successful navigations
+        FailedLoadTime, // load() to finished, failed ones
+        QueueWait,      // load() to navigate, time spent in LoadScheduler
+        HistogramCount
+    };
+
+    enum Format
+    {
+        Prometheus,
+        Json
+    };
+
+    static NativeBrowserMetrics *instance();
+
+    void increment(Counter counter, quint64 amount = 1)
+    {
+        counters[counter].fetch_add(amount, std::memory_order_relaxed);
+    }
+    void add(Gauge gauge, qint64 delta)
+    {
+        gauges[gauge].fetch_add(delta, std::memory_order_relaxed);
+    }
+    // nanoseconds, negative ones are ignored
+    void observe(Histogram histogram, qint64 nsecs);
+
+    quint64 counter(Counter counter) const;
+    qint64 gauge(Gauge gauge) const;
+    quint64 histogramCount(Histogram histogram) const;
+
+    QByteArray toPrometheus() const;
+    QJsonObject toJson() const;
+    QByteArray dump(Format format) const;
+
+    // replaces file in one step, a scraper never sees half a dump
+    bool writeFile(const QString &file, Format format = Prometheus) const;
+    // every connection to the local socket name gets a dump and is closed;
+    // an empty name stops serving
+    bool listen(const QString &name, Format format = Prometheus);
+
+    // zeroes counters and histograms, gauges keep their value
+    void reset();
+
+    // upper bounds of the histogram buckets, in ms, the last one is +Inf
+    static const int BucketCount = 12;
+    static const int bucket_bounds[BucketCount - 1];
+
+private slots:
+    void serveConnections();
+
+private:
+    explicit NativeBrowserMetrics(QObject *parent = 0);
+    ~NativeBrowserMetrics();
+
+    struct HistogramSlots
+    {
+        std::atomic<quint64> buckets[BucketCount];
+        std::atomic<quint64> count;
+        std::atomic<qint64> sum; // ns
+    };
+
+    std::atomic<quint64> counters[CounterCount];
+    std::atomic<qint64> gauges[GaugeCount];
+    HistogramSlots histograms[HistogramCount];
+    QLocalServer *server;
+    Format server_format;
+};
+
+#endif // NATIVEBROWSERMETRICS_H
@@ -0,0 +1,162 @@
+#include "nativebrowserpool.h"
+
+#include <QCoreApplication>
+#include <QTimer>
+#include <QWidget>
+
+#include "nativebrowserimpl.h"
+
+namespace {
+
+// reset by the destructor, the pool goes with the application
+static NativeBrowserPool *pool = 0;
+
+} // anonymous
+
+NativeBrowserPool *NativeBrowserPool::instance()
+{
+    if (!pool)
+    {
+        pool = new NativeBrowserPool(QCoreApplication::instance());
+    }
+    return pool;
+}
+
+NativeBrowserPool::NativeBrowserPool(QObject *parent)
+    : QObject(parent)
+    , host(0)
+    , warm_timer(new QTimer(this))
+    , maximum_size(0)
+    , warm_count(0)
+    , shut_down(!QCoreApplication::instance())
+    , hit_count(0)
+    , miss_count(0)
+{
+    // one backend per event loop iteration, so warming never stalls the UI
+    warm_timer->setInterval(0);
+    connect(warm_timer, SIGNAL(timeout()), this, SLOT(warmUp()));
+    if (QCoreApplication::instance())
+    {
+        // backends must go before the window system does
+        connect(QCoreApplication::instance(), SIGNAL(aboutToQuit()), this, SLOT(shutDown()));
+    }
+}
+
+NativeBrowserPool::~NativeBrowserPool()
+{
+    clear();
+    if (pool == this)
+        pool = 0;
+}
+
+void NativeBrowserPool::setMaximumSize(int size)
+{
+    maximum_size = qMax(0, size);
+    warm_count = qMin(warm_count, maximum_size);
+    while (idle.size() > maximum_size)
+    {
+        delete idle.takeLast();
+    }
+}
+
+int NativeBrowserPool::maximumSize() const
+{
+    return maximum_size;
+}
+
+void NativeBrowserPool::setWarmCount(int count)
+{
+    warm_count = qBound(0, count, maximum_size);
+    scheduleWarmUp();
+}
+
+int NativeBrowserPool::warmCount() const
+{
+    return warm_count;
+}
+
+int NativeBrowserPool::size() const
+{
+    return idle.size();
+}
+
+quint64 NativeBrowserPool::hits() const
+{
+    return hit_count;
+}
+
+quint64 NativeBrowserPool::misses() const
+{
+    return miss_count;
+}
+
+void NativeBrowserPool::clear()
+{
+    warm_timer->stop();
+    qDeleteAll(idle);
+    idle.clear();
+    delete host;
+    host = 0;
+}
+
+void NativeBrowserPool::shutDown()
+{
+    shut_down = true;
+    clear();
+}
+
+void NativeBrowserPool::warmUp()
+{
+    // only platform backends are parked, the next scheduleWarmUp() goes on
+    if (shut_down || idle.size() >= warm_count || NativeBrowserImpl::hasInstanceFactory())
+    {
+        warm_timer->stop();
+        return;
+    }
+    idle.append(NativeBrowserImpl::createDetachedInstance(hostWindow()));
+}
+
+NativeBrowserImpl *NativeBrowserPool::acquire()
+{
+    if (shut_down)
+        return 0;
+    if (idle.isEmpty())
+    {
+        if (maximum_size > 0)
+            ++miss_count;
+        return 0;
+    }
+    ++hit_count;
+    NativeBrowserImpl *backend = idle.takeLast();
+    scheduleWarmUp();
+    return backend;
+}
+
+bool NativeBrowserPool::release(NativeBrowserImpl *backend)
+{
+    // browsers destroyed after aboutToQuit delete their backend right away
+    if (shut_down || backend->replaced || idle.size() >= maximum_size)
+        return false;
+    backend->detach(this, hostWindow());
+    idle.append(backend);
+    return true;
+}
+
+QWidget *NativeBrowserPool::hostWindow()
+{
+    Q_ASSERT(!shut_down);
+    if (!host)
+    {
+        host = new QWidget();
+        host->setAttribute(Qt::WA_DontShowOnScreen);
+        host->resize(800, 600);
+        host->winId();
+    }
+    return host;
+}
+
+void NativeBrowserPool::scheduleWarmUp()
+{
+    if (!shut_down && idle.size() < warm_count && !warm_timer->isActive())
+        warm_timer->start();
+}
@@ -0,0 +1,69 @@
+#ifndef NATIVEBROWSERPOOL_H
+#define NATIVEBROWSERPOOL_H
+
+#include <QList>
+#include <QObject>
+
+class NativeBrowserImpl;
+class QTimer;
+class QWidget;
+
+// Keeps engine backends ready so a new NativeBrowser does not have to create
+// one on the GUI thread while it is being shown. Backends are created ahead
+// of time when the event loop is idle and parked in a hidden window; a
+// destroyed NativeBrowser gives its backend back, reset to about:blank.
+// The pool is empty and disabled until setMaximumSize() is called.
+class NativeBrowserPool : public QObject
+{
+    Q_OBJECT
+    Q_DISABLE_COPY(NativeBrowserPool)
+public:
+    static NativeBrowserPool *instance();
+
+    // idle backends kept at most, released ones beyond it are destroyed
+    void setMaximumSize(int size);
+    int maximumSize() const;
+
+    // idle backends to create ahead of time, at most maximumSize()
+    void setWarmCount(int count);
+    int warmCount() const;
+
+    int size() const;
+
+    // browsers that got a pooled backend vs. had to create their own
+    quint64 hits() const;
+    quint64 misses() const;
+
+public slots:
+    void clear();
+
+private slots:
+    void warmUp();
+    // the application quits: the pool is emptied and takes nothing back,
+    // so no backend outlives the window system
+    void shutDown();
+
+private:
+    friend class NativeBrowserImpl;
+    explicit NativeBrowserPool(QObject *parent = 0);
+    ~NativeBrowserPool();
+
+    // returns 0 on a miss
+    NativeBrowserImpl *acquire();
+    // takes the backend back, false if it has to be destroyed instead
+    bool release(NativeBrowserImpl *backend);
+
+    QWidget *hostWindow();
+    void scheduleWarmUp();
+
+    QList<NativeBrowserImpl *> idle;
+    QWidget *host;
+    QTimer *warm_timer;
+    int maximum_size;
+    int warm_count;
+    bool shut_down;
+    quint64 hit_count;
+    quint64 miss_count;
+};
+
+#endif // NATIVEBROWSERPOOL_H
@@ -0,0 +1,178 @@
+#include "navigationhistory.h"
+
+NavigationHistory::NavigationHistory()
+    : current(-1)
+    , maximum_count(50)
+    , next_id(0)
+    , budget(0)
+    , snapshot_bytes(0)
+    , evicted_snapshots(0)
+{
+}
+
+void NavigationHistory::push(const QString &url)
+{
+    if (current >= 0 && items[current].url == url)
+        return;
+    while (items.size() > current + 1)
+        removeSnapshot(items.takeLast().id);
+    Item item;
+    item.id = ++next_id;
+    item.url = url;
+    items.append(item);
+    while (items.size() > maximum_count)
+        removeSnapshot(items.takeFirst().id);
+    current = items.size() - 1;
+}
+
+void NavigationHistory::clear()
+{
+    items.clear();
+    snapshots.clear();
+    lru.clear();
+    snapshot_bytes = 0;
+    current = -1;
+}
+
+int NavigationHistory::count() const
+{
+    return items.size();
+}
+
+int NavigationHistory::currentIndex() const
+{
+    return current;
+}
+
+void NavigationHistory::setCurrentIndex(int index)
+{
+    if (index >= 0 && index < items.size())
+        current = index;
+}
+
+bool NavigationHistory::canGoBack() const
+{
+    return current > 0;
+}
+
+bool NavigationHistory::canGoForward() const
+{
+    return current >= 0 && current < items.size() - 1;
+}
+
+NavigationHistoryEntry NavigationHistory::entry(int index) const
+{
+    NavigationHistoryEntry result;
+    if (index < 0 || index >= items.size())
+        return result;
+    const Item &item = items[index];
+    result.url = item.url;
+    result.scroll = item.scroll;
+    result.has_snapshot = snapshots.contains(item.id);
+    return result;
+}
+
+QList<NavigationHistoryEntry> NavigationHistory::entries() const
+{
+    QList<NavigationHistoryEntry> result;
+    result.reserve(items.size());
+    for (int i = 0; i < items.size(); ++i)
+        result.append(entry(i));
+    return result;
+}
+
+void NavigationHistory::setCurrentUrl(const QString &url)
+{
+    if (current >= 0)
+        items[current].url = url;
+}
+
+void NavigationHistory::setCurrentScroll(const QPoint &scroll)
+{
+    if (current >= 0)
+        items[current].scroll = scroll;
+}
+
+void NavigationHistory::setMaximumCount(int count)
+{
+    maximum_count = qMax(1, count);
+    int dropped = items.size() - maximum_count;
+    if (dropped <= 0)
+        return;
+    for (int i = 0; i < dropped; ++i)
+        removeSnapshot(items.takeFirst().id);
+    current = qMax(0, current - dropped);
+}
+
+int NavigationHistory::maximumCount() const
+{
+    return maximum_count;
+}
+
+void NavigationHistory::setSnapshotBudget(qint64 bytes)
+{
+    budget = qMax(Q_INT64_C(0), bytes);
+    trimSnapshots();
+}
+
+qint64 NavigationHistory::snapshotBudget() const
+{
+    return budget;
+}
+
+qint64 NavigationHistory::snapshotBytes() const
+{
+    return snapshot_bytes;
+}
+
+quint64 NavigationHistory::evictedSnapshots() const
+{
+    return evicted_snapshots;
+}
+
+void NavigationHistory::setCurrentSnapshot(const QByteArray &document)
+{
+    if (current < 0)
+        return;
+    quint64 id = items[current].id;
+    removeSnapshot(id);
+    if (document.isEmpty() || document.size() > budget)
+        return;
+    // implicitly shared, the engine's copy is not duplicated
+    snapshots.insert(id, document);
+    lru.append(id);
+    snapshot_bytes += document.size();
+    trimSnapshots();
+}
+
+QByteArray NavigationHistory::snapshot(int index)
+{
+    if (index < 0 || index >= items.size())
+        return QByteArray();
+    quint64 id = items[index].id;
+    QHash<quint64, QByteArray>::const_iterator found = snapshots.constFind(id);
+    if (found == snapshots.constEnd())
+        return QByteArray();
+    lru.removeOne(id);
+    lru.append(id);
+    return found.value();
+}
+
+void NavigationHistory::removeSnapshot(quint64 id)
+{
+    QHash<quint64, QByteArray>::iterator found = snapshots.find(id);
+    if (found == snapshots.end())
+        return;
+    snapshot_bytes -= found.value().size();
+    snapshots.erase(found);
+    lru.removeOne(id);
+}
+
+void NavigationHistory::trimSnapshots()
+{
+    while (snapshot_bytes > budget && !lru.isEmpty())
+    {
+        removeSnapshot(lru.first());
+        ++evicted_snapshots;
+    }
+}
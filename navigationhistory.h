@@ -0,0 +1,91 @@
+#ifndef NAVIGATIONHISTORY_H
+#define NAVIGATIONHISTORY_H
+
+#include <QByteArray>
+#include <QHash>
+#include <QList>
+#include <QPoint>
+#include <QString>
+
+// One page of a NativeBrowser's back/forward history.
+struct NavigationHistoryEntry
+{
+    NavigationHistoryEntry()
+        : has_snapshot(false)
+    {}
+
+    QString url;       // where the page ended up, redirects included
+    QPoint scroll;     // where it was scrolled when it was left
+    bool has_snapshot; // its document is in the snapshot cache
+};
+
+// Bounded back/forward list of the pages a browser loaded, with a cache of
+// their serialized documents so going back can show a page before the
+// engine fetched it again. Snapshots share one memory budget and the least
+// recently used ones are evicted first; an entry without a snapshot is
+// loaded from its URL.
+class NavigationHistory
+{
+public:
+    NavigationHistory();
+
+    // the page loaded after the current one; entries after the current one
+    // are dropped, the oldest one too when the list is full. A reload of
+    // the current URL only refreshes its entry.
+    void push(const QString &url);
+    void clear();
+
+    int count() const;
+    // -1 while the history is empty
+    int currentIndex() const;
+    void setCurrentIndex(int index);
+    bool canGoBack() const;
+    bool canGoForward() const;
+
+    NavigationHistoryEntry entry(int index) const;
+    QList<NavigationHistoryEntry> entries() const;
+    // the current entry redirected or was loaded again
+    void setCurrentUrl(const QString &url);
+    void setCurrentScroll(const QPoint &scroll);
+
+    // oldest entries are dropped beyond it, at least 1
+    void setMaximumCount(int count);
+    int maximumCount() const;
+
+    // bytes all snapshots may take together, 0 disables the cache
+    void setSnapshotBudget(qint64 bytes);
+    qint64 snapshotBudget() const;
+    qint64 snapshotBytes() const;
+    quint64 evictedSnapshots() const;
+
+    // replaces the snapshot of the current entry; one larger than the
+    // budget is not kept
+    void setCurrentSnapshot(const QByteArray &document);
+    // empty if there is none, makes it the most recently used one
+    QByteArray snapshot(int index);
+
+private:
+    struct Item
+    {
+        quint64 id;
+        QString url;
+        QPoint scroll;
+    };
+
+    void removeSnapshot(quint64 id);
+    // evicts least recently used snapshots until they fit the budget
+    void trimSnapshots();
+
+    QList<Item> items;
+    int current;
+    int maximum_count;
+    quint64 next_id;
+    // by Item::id, lru holds the ids least recently used first
+    QHash<quint64, QByteArray> snapshots;
+    QList<quint64> lru;
+    qint64 budget;
+    qint64 snapshot_bytes;
+    quint64 evicted_snapshots;
+};
+
+#endif // NAVIGATIONHISTORY_H
@@ -0,0 +1,305 @@
+#include "navigationpolicy.h"
+
+namespace {
+
+static const int NO_ACTION = -1;
+
+static bool IsAuthorityEnd(QChar c)
+{
+    return c == QLatin1Char('/') || c == QLatin1Char('\\')
+        || c == QLatin1Char('?') || c == QLatin1Char('#');
+}
+
+static bool IsValidHostPattern(const QString &host)
+{
+    return !host.isEmpty()
+        && !host.contains(QLatin1Char('*'))
+        && !host.startsWith(QLatin1Char('.'))
+        && !host.endsWith(QLatin1Char('.'))
+        && !host.contains(QLatin1String(".."));
+}
+
+} // anonymous
+
+NavigationPolicy::NavigationPolicy()
+{
+    clear();
+    current_action = Allow;
+    rule_count = 1;
+}
+
+bool NavigationPolicy::addRule(const QString &pattern, Action action)
+{
+    QString rule = pattern.trimmed();
+    if (rule == QLatin1String("$current"))
+    {
+        if (current_action == NO_ACTION)
+            ++rule_count;
+        current_action = action;
+        return true;
+    }
+    if (rule == QLatin1String("$site"))
+    {
+        if (site_action == NO_ACTION)
+            ++rule_count;
+        site_action = action;
+        return true;
+    }
+
+    int slash = rule.indexOf(QLatin1Char('/'));
+    QString host = (slash < 0 ? rule : rule.left(slash)).toLower();
+    QString path = slash < 0 ? QString() : rule.mid(slash);
+    bool subdomains = host.startsWith(QLatin1String("*."));
+    if (subdomains)
+        host.remove(0, 2);
+    if (!IsValidHostPattern(host) || (subdomains && !path.isEmpty()))
+        return false;
+
+    int node = 0;
+    int end = host.size();
+    while (end > 0)
+    {
+        int start = host.lastIndexOf(QLatin1Char('.'), end - 1) + 1;
+        node = addChild(node, host.mid(start, end - start));
+        end = start - 1;
+    }
+
+    Node &target = nodes[node];
+    if (subdomains)
+    {
+        if (target.subdomain_action == NO_ACTION)
+            ++rule_count;
+        target.subdomain_action = action;
+    }
+    else if (path.isEmpty())
+    {
+        if (target.host_action == NO_ACTION)
+            ++rule_count;
+        target.host_action = action;
+    }
+    else
+    {
+        int index = 0;
+        while (index < target.paths.size() && target.paths.at(index).prefix.size() > path.size())
+            ++index;
+        for (int i = index; i < target.paths.size() && target.paths.at(i).prefix.size() == path.size(); ++i)
+        {
+            if (target.paths.at(i).prefix == path)
+            {
+                target.paths[i].action = action;
+                return true;
+            }
+        }
+        PathRule path_rule;
+        path_rule.prefix = path;
+        path_rule.action = action;
+        target.paths.insert(index, path_rule);
+        ++rule_count;
+    }
+    return true;
+}
+
+void NavigationPolicy::clear()
+{
+    nodes.clear();
+    nodes.append(Node());
+    current_action = NO_ACTION;
+    site_action = NO_ACTION;
+    default_action = External;
+    rule_count = 0;
+}
+
+int NavigationPolicy::ruleCount() const
+{
+    return rule_count;
+}
+
+void NavigationPolicy::setDefaultAction(Action action)
+{
+    default_action = action;
+}
+
+NavigationPolicy::Action NavigationPolicy::defaultAction() const
+{
+    return Action(default_action);
+}
+
+NavigationPolicy::Action NavigationPolicy::decide(const QString &url, const QString &current_host) const
+{
+    QStringRef host = hostOf(url);
+    int action = matchHost(url, host);
+    if (action != NO_ACTION)
+        return Action(action);
+    if (current_action != NO_ACTION && host.compare(current_host, Qt::CaseInsensitive) == 0)
+        return Action(current_action);
+    if (site_action != NO_ACTION && !host.isEmpty())
+    {
+        QStringRef site = registrableDomain(host);
+        QStringRef current_site = registrableDomain(QStringRef(&current_host));
+        if (site.compare(current_site, Qt::CaseInsensitive) == 0)
+            return Action(site_action);
+    }
+    return Action(default_action);
+}
+
+QStringRef NavigationPolicy::hostOf(const QString &url)
+{
+    int scheme_end = url.indexOf(QLatin1String("://"));
+    if (scheme_end <= 0)
+        return QStringRef();
+    for (int i = 0; i < scheme_end; ++i)
+    {
+        QChar c = url.at(i);
+        if (!c.isLetterOrNumber() && c != QLatin1Char('+') && c != QLatin1Char('-') && c != QLatin1Char('.'))
+            return QStringRef();
+    }
+
+    int start = scheme_end + 3;
+    int end = start;
+    while (end < url.size() && !IsAuthorityEnd(url.at(end)))
+        ++end;
+    for (int i = end - 1; i >= start; --i)
+    {
+        if (url.at(i) == QLatin1Char('@'))
+        {
+            start = i + 1; // user info
+            break;
+        }
+    }
+
+    if (start < end && url.at(start) == QLatin1Char('['))
+    {
+        int close = url.indexOf(QLatin1Char(']'), start);
+        if (close < 0 || close > end)
+            return QStringRef();
+        return QStringRef(&url, start + 1, close - start - 1);
+    }
+    for (int i = start; i < end; ++i)
+    {
+        if (url.at(i) == QLatin1Char(':'))
+        {
+            end = i; // port
+            break;
+        }
+    }
+    if (end > start && url.at(end - 1) == QLatin1Char('.'))
+        --end; // fully qualified
+    return QStringRef(&url, start, end - start);
+}
+
+QStringRef NavigationPolicy::pathOf(const QString &url, const QStringRef &host)
+{
+    int start = host.position() + host.size();
+    while (start < url.size() && !IsAuthorityEnd(url.at(start)))
+        ++start; // port
+    int end = start;
+    while (end < url.size() && url.at(end) != QLatin1Char('?') && url.at(end) != QLatin1Char('#'))
+        ++end;
+    return QStringRef(&url, start, end - start);
+}
+
+QStringRef NavigationPolicy::registrableDomain(const QStringRef &host)
+{
+    // positions of the last three dots, last one first
+    int dots[3];
+    int found = 0;
+    for (int i = host.size() - 1; i >= 0 && found < 3; --i)
+    {
+        if (host.at(i) == QLatin1Char('.'))
+            dots[found++] = i;
+    }
+    if (found < 2 || host.at(host.size() - 1).isDigit())
+        return host; // two labels at most, or an IPv4 address
+
+    int last_label_size = host.size() - dots[0] - 1;
+    int second_label_size = dots[0] - dots[1] - 1;
+    int start;
+    if (last_label_size == 2 && second_label_size <= 3)
+    {
+        // country code second level domain such as co.uk
+        if (found < 3)
+            return host;
+        start = dots[2] + 1;
+    }
+    else
+    {
+        start = dots[1] + 1;
+    }
+    return QStringRef(host.string(), host.position() + start, host.size() - start);
+}
+
+int NavigationPolicy::child(int node, const QStringRef &label) const
+{
+    const QVector<Child> &children = nodes.at(node).children;
+    int low = 0;
+    int high = children.size();
+    while (low < high)
+    {
+        int middle = (low + high) / 2;
+        int order = label.compare(children.at(middle).label, Qt::CaseInsensitive);
+        if (order == 0)
+            return children.at(middle).node;
+        if (order < 0)
+            high = middle;
+        else
+            low = middle + 1;
+    }
+    return -1;
+}
+
+int NavigationPolicy::addChild(int node, const QString &label)
+{
+    int existing = child(node, QStringRef(&label));
+    if (existing >= 0)
+        return existing;
+
+    Child entry;
+    entry.label = label;
+    entry.node = nodes.size();
+    nodes.append(Node());
+
+    QVector<Child> &children = nodes[node].children;
+    int index = 0;
+    while (index < children.size()
+           && QString::compare(children.at(index).label, label, Qt::CaseInsensitive) < 0)
+        ++index;
+    children.insert(index, entry);
+    return entry.node;
+}
+
+int NavigationPolicy::matchHost(const QString &url, const QStringRef &host) const
+{
+    if (host.isEmpty())
+        return NO_ACTION;
+
+    int best = NO_ACTION;
+    int node = 0;
+    int end = host.size();
+    while (end > 0)
+    {
+        // a label is left, so subdomain rules of this node apply
+        if (nodes.at(node).subdomain_action != NO_ACTION)
+            best = nodes.at(node).subdomain_action;
+        int start = end;
+        while (start > 0 && host.at(start - 1) != QLatin1Char('.'))
+            --start;
+        node = child(node, QStringRef(host.string(), host.position() + start, end - start));
+        if (node < 0)
+            return best;
+        end = start - 1;
+    }
+
+    const Node &match = nodes.at(node);
+    if (!match.paths.isEmpty())
+    {
+        QStringRef path = pathOf(url, host);
+        for (const PathRule &rule : match.paths)
+        {
+            if (path.startsWith(rule.prefix))
+                return rule.action;
+        }
+    }
+    if (match.host_action != NO_ACTION)
+        return match.host_action;
+    return best;
+}
@@ -0,0 +1,89 @@
+#ifndef NAVIGATIONPOLICY_H
+#define NAVIGATIONPOLICY_H
+
+#include <QString>
+#include <QStringRef>
+#include <QVector>
+
+// Decides whether the engine may follow a navigation, hands it to
+// externalNavigate, or drops it. Rules are compiled into a trie of host
+// labels, last label first, so a decision walks the URL's host once and
+// does not allocate. Patterns:
+//
+//   example.com          that host only
+//   *.example.com        any subdomain of example.com, not example.com itself
+//   example.com/reports  that host, paths starting with /reports
+//   $current             the host of the page being loaded or shown
+//   $site                the registrable domain of that page, approximated
+//                        as its last two labels (three under a two-letter
+//                        country code with a short second level, co.uk)
+//
+// A host rule wins over $current, which wins over $site; among host rules
+// the longest path prefix, then the most specific host wins. URLs no rule
+// matches get defaultAction().
+class NavigationPolicy
+{
+public:
+    enum Action
+    {
+        Allow,
+        External,
+        Block
+    };
+
+    // $current is allowed, everything else is external
+    NavigationPolicy();
+
+    // false if the pattern is malformed, a later rule for the same pattern
+    // replaces the earlier one
+    bool addRule(const QString &pattern, Action action);
+    void clear();
+    int ruleCount() const;
+
+    void setDefaultAction(Action action);
+    Action defaultAction() const;
+
+    Action decide(const QString &url, const QString &current_host) const;
+
+    // host part of an absolute URL, without port or user info; empty for
+    // URLs without one (about:, data:, javascript:)
+    static QStringRef hostOf(const QString &url);
+    // path of url up to the query or fragment, host as returned by hostOf()
+    static QStringRef pathOf(const QString &url, const QStringRef &host);
+    static QStringRef registrableDomain(const QStringRef &host);
+
+private:
+    struct Child
+    {
+        QString label;
+        int node;
+    };
+
+    struct PathRule
+    {
+        QString prefix;
+        int action;
+    };
+
+    struct Node
+    {
+        Node() : host_action(-1), subdomain_action(-1) {}
+
+        QVector<Child> children; // sorted by label
+        int host_action;
+        int subdomain_action;
+        QVector<PathRule> paths; // longest prefix first
+    };
+
+    int child(int node, const QStringRef &label) const;
+    int addChild(int node, const QString &label);
+    int matchHost(const QString &url, const QStringRef &host) const;
+
+    QVector<Node> nodes;
+    int current_action;
+    int site_action;
+    int default_action;
+    int rule_count;
+};
+
+#endif // NAVIGATIONPOLICY_H
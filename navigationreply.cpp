@@ -0,0 +1,102 @@
+#include "navigationreply.h"
+
+#include <QMetaObject>
+#include <QTimer>
+
+#include "nativebrowser.h"
+
+NavigationReply::NavigationReply(NativeBrowser *browser, const QString &url, qint64 load_called, int timeout)
+    : QObject(browser)
+    , browser(browser)
+    , requested_url(url)
+    , load_called(load_called)
+    , timeout_timer(new QTimer(this))
+    , navigation_result(Pending)
+    , decided_result(Pending)
+{
+    timeout_timer->setSingleShot(true);
+    connect(timeout_timer, SIGNAL(timeout()), this, SLOT(timedOut()));
+    if (timeout > 0)
+        timeout_timer->start(timeout);
+}
+
+NavigationReply::~NavigationReply()
+{
+}
+
+QString NavigationReply::url() const
+{
+    return requested_url;
+}
+
+NavigationReply::Result NavigationReply::result() const
+{
+    return navigation_result;
+}
+
+bool NavigationReply::isFinished() const
+{
+    return navigation_result != Pending;
+}
+
+QString NavigationReply::finalUrl() const
+{
+    return final_url;
+}
+
+bool NavigationReply::redirectedExternally() const
+{
+    return !external_url.isEmpty();
+}
+
+QString NavigationReply::externalUrl() const
+{
+    return external_url;
+}
+
+NavigationTiming NavigationReply::timing() const
+{
+    return navigation_timing;
+}
+
+void NavigationReply::cancel()
+{
+    if (isFinished() || !browser)
+        return;
+    browser->cancelNavigation(this, Cancelled);
+}
+
+void NavigationReply::timedOut()
+{
+    if (isFinished() || !browser)
+        return;
+    browser->cancelNavigation(this, TimedOut);
+}
+
+qint64 NavigationReply::loadCalled() const
+{
+    return load_called;
+}
+
+void NavigationReply::finish(Result result, const NavigationTiming &timing, const QString &final_url)
+{
+    if (isFinished())
+        return;
+    timeout_timer->stop();
+    navigation_result = decided_result != Pending ? decided_result : result;
+    navigation_timing = timing;
+    this->final_url = final_url;
+    // never before navigate() returned it, and the browser going away
+    // must not take the reply along before the signal went out
+    setParent(0);
+    QMetaObject::invokeMethod(this, "deliverFinished", Qt::QueuedConnection);
+}
+
+void NavigationReply::deliverFinished()
+{
+    QPointer<NavigationReply> self(this);
+    emit finished();
+    // the handler may have deleted it already
+    if (self)
+        deleteLater();
+}
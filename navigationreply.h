@@ -0,0 +1,94 @@
+#ifndef NAVIGATIONREPLY_H
+#define NAVIGATIONREPLY_H
+
+#include <QObject>
+#include <QPointer>
+#include <QString>
+
+#include "navigationtiming.h"
+
+class NativeBrowser;
+class QTimer;
+
+// Per-navigation settings for NativeBrowser::navigate().
+struct NavigationOptions
+{
+    NavigationOptions()
+        : timeout(0)
+        , start_timeout(-1)
+        , idle_timeout(-1)
+    {}
+
+    int timeout;       // for the whole navigation in ms, 0 for none
+    int start_timeout; // replace the browser's load timeouts for this
+    int idle_timeout;  // navigation only, -1 keeps them
+};
+
+// How one navigation started with NativeBrowser::navigate() ended. It is
+// resolved exactly once and emits finished() from the event loop after
+// that, never before navigate() returned; a navigation superseded by the
+// next one, or one whose browser goes away, resolves as Cancelled.
+// The reply deletes itself once finished() returned: read it in the
+// handler, or a queued one, and do not keep the pointer. The caller may
+// delete it earlier.
+class NavigationReply : public QObject
+{
+    Q_OBJECT
+    Q_DISABLE_COPY(NavigationReply)
+public:
+    enum Result
+    {
+        Pending,
+        Succeeded,
+        Failed,
+        Cancelled,
+        TimedOut
+    };
+
+    virtual ~NavigationReply();
+
+    QString url() const;
+    Result result() const;
+    bool isFinished() const;
+
+    // where the browser ended up, after redirects
+    QString finalUrl() const;
+    // the page was handed to externalNavigate instead of being loaded
+    bool redirectedExternally() const;
+    QString externalUrl() const;
+
+    // the navigation's timeline, as far as it got
+    NavigationTiming timing() const;
+
+public slots:
+    // stops the navigation if it is still running
+    void cancel();
+
+signals:
+    void finished();
+
+private slots:
+    void timedOut();
+    void deliverFinished();
+
+private:
+    friend class NativeBrowser;
+    NavigationReply(NativeBrowser *browser, const QString &url, qint64 load_called, int timeout);
+
+    qint64 loadCalled() const;
+    void finish(Result result, const NavigationTiming &timing, const QString &final_url);
+
+    QPointer<NativeBrowser> browser;
+    QString requested_url;
+    qint64 load_called;
+    QTimer *timeout_timer;
+    Result navigation_result;
+    // decided by cancel(), timeout or an external redirect, reported once
+    // the browser has recorded the timeline
+    Result decided_result;
+    QString final_url;
+    QString external_url;
+    NavigationTiming navigation_timing;
+};
+
+#endif // NAVIGATIONREPLY_H
@@ -0,0 +1,125 @@
+#include "navigationstatemachine.h"
+
+NavigationStateMachine::NavigationStateMachine()
+    : current(Idle)
+    , failed(false)
+    , activity(false)
+    , last_success(false)
+    , start_timeout(5000)
+    , idle_timeout(5000)
+    , timer_interval(0)
+{
+}
+
+void NavigationStateMachine::setTimeouts(int start_msecs, int idle_msecs)
+{
+    start_timeout = start_msecs;
+    idle_timeout = idle_msecs;
+}
+
+int NavigationStateMachine::requested()
+{
+    // a navigation still in flight is superseded without a finish
+    current = Requested;
+    failed = false;
+    activity = false;
+    return restartTimer(start_timeout);
+}
+
+int NavigationStateMachine::started(bool top_frame)
+{
+    // frames and redirects of a running load do not start a new one
+    if (!top_frame || current == Loading)
+        return NoAction;
+    current = Loading;
+    failed = false;
+    activity = false;
+    return EmitStarted | restartTimer(start_timeout);
+}
+
+int NavigationStateMachine::progress()
+{
+    if (current != Loading)
+        return NoAction;
+    activity = true;
+    return restartTimer(idle_timeout);
+}
+
+int NavigationStateMachine::navigateComplete(bool)
+{
+    // a committing frame counts as activity, completion is decided elsewhere
+    if (current != Loading)
+        return NoAction;
+    activity = true;
+    return restartTimer(idle_timeout);
+}
+
+int NavigationStateMachine::navigateError(bool top_frame)
+{
+    if (current != Loading)
+        return NoAction;
+    activity = true;
+    if (top_frame)
+        failed = true;
+    // the engine still completes the (error) document, wait for it
+    return restartTimer(idle_timeout);
+}
+
+int NavigationStateMachine::documentComplete(bool top_frame)
+{
+    if (current != Loading)
+        return NoAction;
+    if (!top_frame)
+    {
+        activity = true;
+        return restartTimer(idle_timeout);
+    }
+    return finish(!failed);
+}
+
+int NavigationStateMachine::finished(bool success)
+{
+    if (current != Loading)
+        return NoAction;
+    return finish(success && !failed);
+}
+
+int NavigationStateMachine::refused()
+{
+    if (current != Requested)
+        return NoAction;
+    return finish(false);
+}
+
+int NavigationStateMachine::timeout()
+{
+    if (current == Idle)
+        return NoAction;
+    if (current == Requested || !activity)
+    {
+        // the engine never got going
+        return StopEngine | finish(false);
+    }
+    return finish(!failed);
+}
+
+int NavigationStateMachine::cancelled()
+{
+    if (current == Loading)
+        return finish(false);
+    current = Idle;
+    return StopTimer;
+}
+
+int NavigationStateMachine::restartTimer(int msecs)
+{
+    timer_interval = msecs;
+    return msecs > 0 ? RestartTimer : StopTimer;
+}
+
+int NavigationStateMachine::finish(bool success)
+{
+    current = Idle;
+    last_success = success;
+    return EmitFinished | StopTimer;
+}
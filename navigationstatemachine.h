@@ -0,0 +1,73 @@
+#ifndef NAVIGATIONSTATEMACHINE_H
+#define NAVIGATIONSTATEMACHINE_H
+
+// Decides when a navigation has started and finished from the engine's
+// events. Backends feed it what their engine reports (start, progress,
+// navigate/document complete, errors, each tagged with whether it concerns
+// the top frame); the fallback timer is only needed when an engine goes
+// silent. Every input returns a set of Action flags for the caller to carry
+// out, so sequences can be replayed without an engine or an event loop.
+class NavigationStateMachine
+{
+public:
+    enum State
+    {
+        Idle,
+        Requested, // navigate() issued, engine has not started yet
+        Loading
+    };
+
+    enum Action
+    {
+        NoAction     = 0x00,
+        EmitStarted  = 0x01,
+        EmitFinished = 0x02, // with succeeded()
+        StopEngine   = 0x04,
+        RestartTimer = 0x08, // with timerInterval()
+        StopTimer    = 0x10
+    };
+
+    NavigationStateMachine();
+
+    // start: how long a started load may go without any engine activity
+    // idle: how long a load may stay silent after activity was seen
+    void setTimeouts(int start_msecs, int idle_msecs);
+    int startTimeout() const { return start_timeout; }
+    int idleTimeout() const { return idle_timeout; }
+
+    State state() const { return current; }
+    bool isLoading() const { return current == Loading; }
+    bool succeeded() const { return last_success; }
+    int timerInterval() const { return timer_interval; }
+
+    // arms the start timeout, which also covers an engine that never
+    // starts the navigation
+    int requested();
+    int started(bool top_frame);
+    int progress();
+    int navigateComplete(bool top_frame);
+    int navigateError(bool top_frame);
+    int documentComplete(bool top_frame);
+    // the engine reported the end of the load by itself
+    int finished(bool success);
+    // the navigation was turned down before the engine started it, it
+    // finishes failed
+    int refused();
+    int timeout();
+    // the caller gave up on the navigation, a running load finishes failed
+    int cancelled();
+
+private:
+    int restartTimer(int msecs);
+    int finish(bool success);
+
+    State current;
+    bool failed;
+    bool activity;
+    bool last_success;
+    int start_timeout;
+    int idle_timeout;
+    int timer_interval;
+};
+
+#endif // NAVIGATIONSTATEMACHINE_H
@@ -0,0 +1,36 @@
+#include "navigationtiming.h"
+
+#include <QElapsedTimer>
+
+namespace {
+
+struct MonotonicClock
+{
+    MonotonicClock()
+    {
+        timer.start();
+    }
+
+    QElapsedTimer timer;
+};
+
+} // anonymous
+
+NavigationTiming::NavigationTiming()
+    : id(0)
+    , success(false)
+    , load_profile(0)
+    , load_called(-1)
+    , navigate_issued(-1)
+    , engine_started(-1)
+    , first_progress(-1)
+    , last_progress(-1)
+    , finished(-1)
+{
+}
+
+qint64 NavigationTiming::now()
+{
+    static MonotonicClock clock;
+    return clock.timer.nsecsElapsed();
+}
@@ -0,0 +1,32 @@
+#ifndef NAVIGATIONTIMING_H
+#define NAVIGATIONTIMING_H
+
+#include <QMetaType>
+#include <QString>
+
+// Timeline of one navigation. Timestamps are nanoseconds on the monotonic
+// clock returned by now(), -1 when the navigation never got to that point
+// (e.g. no load() for navigations the page started itself, or no finish
+// for a navigation superseded by the next one).
+struct NavigationTiming
+{
+    NavigationTiming();
+
+    quint64 id;
+    QString url;
+    bool success;
+    int load_profile; // NativeBrowser::LoadProfile the navigation started with
+
+    qint64 load_called;     // NativeBrowser::load()
+    qint64 navigate_issued; // backend asked to navigate, after any LoadScheduler wait
+    qint64 engine_started;  // engine reported the start, loadStarted
+    qint64 first_progress;
+    qint64 last_progress;
+    qint64 finished;        // loadFinished
+
+    static qint64 now();
+};
+
+Q_DECLARE_METATYPE(NavigationTiming)
+
+#endif // NAVIGATIONTIMING_H
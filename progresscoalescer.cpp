@@ -0,0 +1,78 @@
+#include "progresscoalescer.h"
+
+#include <QTimer>
+
+namespace {
+
+static const int NO_PROGRESS = -1;
+
+} // anonymous
+
+ProgressCoalescer::ProgressCoalescer(QObject *parent)
+    : QObject(parent)
+    , timer(new QTimer(this))
+    , pending(NO_PROGRESS)
+    , delivered(NO_PROGRESS)
+    , raw_events(0)
+    , delivered_events(0)
+{
+    timer->setSingleShot(true);
+    timer->setInterval(16);
+    connect(timer, SIGNAL(timeout()), this, SLOT(intervalElapsed()));
+}
+
+void ProgressCoalescer::setInterval(int msecs)
+{
+    timer->setInterval(msecs);
+}
+
+int ProgressCoalescer::interval() const
+{
+    return timer->interval();
+}
+
+void ProgressCoalescer::post(int progress)
+{
+    ++raw_events;
+    if (timer->isActive())
+    {
+        // inside the current frame, keep only the latest value
+        pending = progress;
+        return;
+    }
+    pending = NO_PROGRESS;
+    deliver(progress);
+}
+
+void ProgressCoalescer::flush()
+{
+    timer->stop();
+    if (pending != NO_PROGRESS)
+    {
+        int progress = pending;
+        pending = NO_PROGRESS;
+        deliver(progress);
+    }
+}
+
+void ProgressCoalescer::reset()
+{
+    timer->stop();
+    pending = NO_PROGRESS;
+    delivered = NO_PROGRESS;
+}
+
+void ProgressCoalescer::intervalElapsed()
+{
+    flush();
+}
+
+void ProgressCoalescer::deliver(int progress)
+{
+    if (progress == delivered)
+        return;
+    delivered = progress;
+    ++delivered_events;
+    timer->start();
+    emit this->progress(progress);
+}
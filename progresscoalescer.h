@@ -0,0 +1,49 @@
+#ifndef PROGRESSCOALESCER_H
+#define PROGRESSCOALESCER_H
+
+#include <QObject>
+
+class QTimer;
+
+// Throttles a stream of progress percentages to at most one delivery per
+// interval (one display frame by default). The first value of a burst is
+// delivered at once, the rest of the burst collapses into its latest value,
+// which is delivered when the interval ends. Values equal to the last
+// delivered one are dropped.
+class ProgressCoalescer : public QObject
+{
+    Q_OBJECT
+    Q_DISABLE_COPY(ProgressCoalescer)
+public:
+    explicit ProgressCoalescer(QObject *parent = 0);
+
+    void setInterval(int msecs);
+    int interval() const;
+
+    void post(int progress);
+    // delivers a pending value right away
+    void flush();
+    // drops a pending value and forgets the last delivered one
+    void reset();
+
+    quint64 rawEvents() const { return raw_events; }
+    quint64 deliveredEvents() const { return delivered_events; }
+    quint64 collapsedEvents() const { return raw_events - delivered_events; }
+
+signals:
+    void progress(int progress);
+
+private slots:
+    void intervalElapsed();
+
+private:
+    void deliver(int progress);
+
+    QTimer *timer;
+    int pending;
+    int delivered;
+    quint64 raw_events;
+    quint64 delivered_events;
+};
+
+#endif // PROGRESSCOALESCER_H
@@ -0,0 +1,460 @@
+#include "requestblocklist.h"
+
+#include <QByteArray>
+#include <QFile>
+#include <QList>
+#include <QMap>
+#include <QSet>
+#include <QUrl>
+#include <QVector>
+
+#include <cstring>
+
+#include "navigationpolicy.h"
+
+// The compiled file is these sections back to back, in the byte order of
+// the machine that compiled it: Header, bloom filter words, Nodes (the
+// children of a node are consecutive and sorted by label), Paths, strings.
+struct RequestBlocklist::Header
+{
+    char magic[4];
+    quint32 version;
+    quint32 rule_count;
+    quint32 bloom_words;  // a power of two
+    quint32 bloom_hashes;
+    quint32 node_count;
+    quint32 path_count;
+    quint32 strings_size; // padded to 4 bytes
+};
+
+struct RequestBlocklist::Node
+{
+    quint32 label_offset;
+    quint16 label_size;
+    quint16 flags;
+    quint32 first_child;
+    quint32 child_count;
+    quint32 first_path;
+    quint32 path_count;
+};
+
+struct RequestBlocklist::Path
+{
+    quint32 offset;
+    quint32 size;
+};
+
+namespace {
+
+static const char BLOCKLIST_MAGIC[4] = { 'N', 'B', 'B', 'L' };
+static const quint32 BLOCKLIST_VERSION = 1;
+static const quint16 BLOCKS_HOST = 0x01;
+
+static const quint32 BLOOM_BITS_PER_HOST = 10;
+static const quint32 BLOOM_HASHES = 7;
+static const quint32 FNV_OFFSET = 2166136261u;
+static const quint32 FNV_PRIME = 16777619u;
+
+static inline ushort FoldAscii(ushort c)
+{
+    return c >= 'A' && c <= 'Z' ? ushort(c + ('a' - 'A')) : c;
+}
+
+// hosts are hashed last character first, so the hash of every suffix of a
+// host is a step on the way to the hash of the whole host
+static inline quint32 HashStep(quint32 hash, ushort c)
+{
+    return (hash ^ FoldAscii(c)) * FNV_PRIME;
+}
+
+static quint32 HashHost(const QByteArray &host)
+{
+    quint32 hash = FNV_OFFSET;
+    for (int i = host.size() - 1; i >= 0; --i)
+        hash = HashStep(hash, uchar(host.at(i)));
+    return hash;
+}
+
+static inline quint32 SecondHash(quint32 hash)
+{
+    return (((hash >> 16) | (hash << 16)) * 0x85ebca6bu) | 1;
+}
+
+static void BloomAdd(QVector<quint32> &bloom, quint32 hash)
+{
+    quint32 mask = quint32(bloom.size()) * 32 - 1;
+    quint32 step = SecondHash(hash);
+    for (quint32 i = 0; i < BLOOM_HASHES; ++i)
+    {
+        quint32 bit = (hash + i * step) & mask;
+        bloom[bit >> 5] |= 1u << (bit & 31);
+    }
+}
+
+struct BuildNode
+{
+    BuildNode() : blocks_host(false) {}
+
+    QMap<QByteArray, int> children;
+    bool blocks_host;
+    QList<QByteArray> paths;
+};
+
+// host and path of one text rule, false for comments and malformed lines
+static bool ParseRule(QString line, QByteArray &host, QByteArray &path)
+{
+    int comment = line.indexOf(QLatin1Char('#'));
+    if (comment >= 0)
+        line.truncate(comment);
+    line = line.trimmed();
+    if (line.isEmpty() || line.startsWith(QLatin1Char('!')))
+        return false;
+
+    // hosts file: address, then the host
+    for (int i = 0; i < line.size(); ++i)
+    {
+        if (line.at(i).isSpace())
+        {
+            line = line.mid(i).trimmed();
+            break;
+        }
+    }
+
+    if (line.startsWith(QLatin1String("||")))
+        line.remove(0, 2);
+    if (line.endsWith(QLatin1Char('^')))
+        line.chop(1);
+
+    int slash = line.indexOf(QLatin1Char('/'));
+    QString host_part = slash < 0 ? line : line.left(slash);
+    host = QUrl::toAce(host_part.toLower());
+    if (host.isEmpty() || host.startsWith('.') || host.endsWith('.')
+            || host.contains("..") || host.contains('*') || host.size() > 0xffff)
+        return false;
+    // hosts files map it to the loopback address, it is not a rule
+    if (host == "localhost")
+        return false;
+    path = slash < 0 ? QByteArray() : line.mid(slash).toUtf8();
+    return true;
+}
+
+static void Append(QByteArray &data, const void *value, int size)
+{
+    data.append(reinterpret_cast<const char *>(value), size);
+}
+
+} // anonymous
+
+RequestBlocklist::RequestBlocklist()
+    : file(0)
+    , header(0)
+    , bloom(0)
+    , nodes(0)
+    , paths(0)
+    , strings(0)
+{
+}
+
+RequestBlocklist::~RequestBlocklist()
+{
+    close();
+}
+
+bool RequestBlocklist::open(const QString &file_name)
+{
+    close();
+    file = new QFile(file_name);
+    if (!file->open(QIODevice::ReadOnly))
+    {
+        close();
+        return false;
+    }
+    qint64 size = file->size();
+    uchar *data = size > 0 ? file->map(0, size) : 0;
+    if (!data || !attach(data, size))
+    {
+        close();
+        return false;
+    }
+    return true;
+}
+
+void RequestBlocklist::close()
+{
+    header = 0;
+    bloom = 0;
+    nodes = 0;
+    paths = 0;
+    strings = 0;
+    delete file; // unmaps
+    file = 0;
+}
+
+bool RequestBlocklist::isOpen() const
+{
+    return header != 0;
+}
+
+int RequestBlocklist::ruleCount() const
+{
+    return header ? int(header->rule_count) : 0;
+}
+
+bool RequestBlocklist::attach(const uchar *data, qint64 size)
+{
+    if (size < qint64(sizeof(Header)))
+        return false;
+    const Header *candidate = reinterpret_cast<const Header *>(data);
+    if (memcmp(candidate->magic, BLOCKLIST_MAGIC, sizeof(BLOCKLIST_MAGIC)) != 0
+            || candidate->version != BLOCKLIST_VERSION
+            || candidate->bloom_words == 0
+            || (candidate->bloom_words & (candidate->bloom_words - 1)) != 0
+            || candidate->node_count == 0)
+        return false;
+
+    qint64 expected = qint64(sizeof(Header))
+            + qint64(candidate->bloom_words) * sizeof(quint32)
+            + qint64(candidate->node_count) * sizeof(Node)
+            + qint64(candidate->path_count) * sizeof(Path)
+            + qint64(candidate->strings_size);
+    if (expected != size)
+        return false;
+
+    const uchar *section = data + sizeof(Header);
+    const quint32 *bloom_section = reinterpret_cast<const quint32 *>(section);
+    section += candidate->bloom_words * sizeof(quint32);
+    const Node *node_section = reinterpret_cast<const Node *>(section);
+    section += candidate->node_count * sizeof(Node);
+    const Path *path_section = reinterpret_cast<const Path *>(section);
+    section += candidate->path_count * sizeof(Path);
+
+    // checked once here so lookups can trust every offset
+    for (quint32 i = 0; i < candidate->node_count; ++i)
+    {
+        const Node &node = node_section[i];
+        if (quint64(node.label_offset) + node.label_size > candidate->strings_size
+                || quint64(node.first_child) + node.child_count > candidate->node_count
+                || quint64(node.first_path) + node.path_count > candidate->path_count)
+            return false;
+    }
+    for (quint32 i = 0; i < candidate->path_count; ++i)
+    {
+        if (quint64(path_section[i].offset) + path_section[i].size > candidate->strings_size)
+            return false;
+    }
+
+    header = candidate;
+    bloom = bloom_section;
+    nodes = node_section;
+    paths = path_section;
+    strings = reinterpret_cast<const char *>(section);
+    return true;
+}
+
+bool RequestBlocklist::isBlocked(const QString &url) const
+{
+    if (!header)
+        return false;
+    QStringRef host = NavigationPolicy::hostOf(url);
+    if (!mayBlockHost(host))
+        return false;
+
+    int node = 0;
+    int end = host.size();
+    while (end > 0)
+    {
+        int start = end;
+        while (start > 0 && host.at(start - 1) != QLatin1Char('.'))
+            --start;
+        node = child(node, host, start, end);
+        if (node < 0)
+            return false;
+        // rules cover their host and its subdomains
+        if (nodes[node].flags & BLOCKS_HOST)
+            return true;
+        if (nodes[node].path_count > 0 && pathBlocked(nodes[node], url, host))
+            return true;
+        end = start - 1;
+    }
+    return false;
+}
+
+bool RequestBlocklist::mayBlockHost(const QStringRef &host) const
+{
+    if (!header || host.isEmpty())
+        return false;
+    quint32 mask = header->bloom_words * 32 - 1;
+    quint32 hash = FNV_OFFSET;
+    for (int i = host.size() - 1; i >= -1; --i)
+    {
+        if (i < 0 || host.at(i) == QLatin1Char('.'))
+        {
+            // hash is the one of the suffix after this position
+            quint32 step = SecondHash(hash);
+            quint32 hits = 0;
+            for (; hits < header->bloom_hashes; ++hits)
+            {
+                quint32 bit = (hash + hits * step) & mask;
+                if (!(bloom[bit >> 5] & (1u << (bit & 31))))
+                    break;
+            }
+            if (hits == header->bloom_hashes)
+                return true;
+        }
+        if (i >= 0)
+            hash = HashStep(hash, host.at(i).unicode());
+    }
+    return false;
+}
+
+int RequestBlocklist::child(int node, const QStringRef &host, int start, int end) const
+{
+    int size = end - start;
+    quint32 low = nodes[node].first_child;
+    quint32 high = low + nodes[node].child_count;
+    while (low < high)
+    {
+        quint32 middle = low + (high - low) / 2;
+        const Node &candidate = nodes[middle];
+        const char *label = strings + candidate.label_offset;
+        int common = qMin(size, int(candidate.label_size));
+        int order = 0;
+        for (int i = 0; i < common && order == 0; ++i)
+            order = int(FoldAscii(host.at(start + i).unicode())) - int(uchar(label[i]));
+        if (order == 0)
+            order = size - int(candidate.label_size);
+        if (order == 0)
+            return int(middle);
+        if (order < 0)
+            high = middle;
+        else
+            low = middle + 1;
+    }
+    return -1;
+}
+
+bool RequestBlocklist::pathBlocked(const Node &node, const QString &url, const QStringRef &host) const
+{
+    QStringRef path = NavigationPolicy::pathOf(url, host);
+    for (quint32 p = node.first_path; p < node.first_path + node.path_count; ++p)
+    {
+        const Path &rule = paths[p];
+        if (quint32(path.size()) < rule.size)
+            continue;
+        const char *prefix = strings + rule.offset;
+        quint32 i = 0;
+        while (i < rule.size && path.at(int(i)).unicode() == uchar(prefix[i]))
+            ++i;
+        if (i == rule.size)
+            return true;
+    }
+    return false;
+}
+
+int RequestBlocklist::compile(const QStringList &rules, QIODevice *output)
+{
+    QVector<BuildNode> build(1);
+    QSet<QByteArray> hosts;
+    int rule_count = 0;
+    for (const QString &line : rules)
+    {
+        QByteArray host, path;
+        if (!ParseRule(line, host, path))
+            continue;
+
+        int node = 0;
+        int end = host.size();
+        while (end > 0)
+        {
+            int start = host.lastIndexOf('.', end - 1) + 1;
+            QByteArray label = host.mid(start, end - start);
+            int next = build.at(node).children.value(label, -1);
+            if (next < 0)
+            {
+                next = build.size();
+                build.append(BuildNode());
+                build[node].children.insert(label, next);
+            }
+            node = next;
+            end = start - 1;
+        }
+        if (path.isEmpty())
+            build[node].blocks_host = true;
+        else if (!build.at(node).paths.contains(path))
+            build[node].paths.append(path);
+        hosts.insert(host);
+        ++rule_count;
+    }
+
+    // breadth first, so the children of every node are consecutive
+    QVector<int> order;
+    QVector<QByteArray> labels;
+    QVector<int> position(build.size(), -1);
+    order.append(0);
+    labels.append(QByteArray());
+    position[0] = 0;
+    for (int i = 0; i < order.size(); ++i)
+    {
+        const BuildNode &node = build.at(order.at(i));
+        for (QMap<QByteArray, int>::const_iterator it = node.children.begin(); it != node.children.end(); ++it)
+        {
+            position[it.value()] = order.size();
+            order.append(it.value());
+            labels.append(it.key());
+        }
+    }
+
+    QByteArray string_data;
+    QVector<Node> flat(order.size());
+    QVector<Path> flat_paths;
+    for (int i = 0; i < order.size(); ++i)
+    {
+        const BuildNode &source = build.at(order.at(i));
+        Node &node = flat[i];
+        node.label_offset = quint32(string_data.size());
+        node.label_size = quint16(labels.at(i).size());
+        string_data.append(labels.at(i));
+        node.flags = source.blocks_host ? BLOCKS_HOST : 0;
+        node.first_child = source.children.isEmpty() ? 0 : quint32(position.at(source.children.begin().value()));
+        node.child_count = quint32(source.children.size());
+        node.first_path = quint32(flat_paths.size());
+        node.path_count = quint32(source.paths.size());
+        for (const QByteArray &prefix : source.paths)
+        {
+            Path path;
+            path.offset = quint32(string_data.size());
+            path.size = quint32(prefix.size());
+            string_data.append(prefix);
+            flat_paths.append(path);
+        }
+    }
+    while (string_data.size() % 4)
+        string_data.append('\0');
+
+    quint32 bloom_bits = 1024;
+    while (bloom_bits < quint32(hosts.size()) * BLOOM_BITS_PER_HOST)
+        bloom_bits *= 2;
+    QVector<quint32> bloom_data(int(bloom_bits / 32), 0);
+    for (const QByteArray &host : hosts)
+        BloomAdd(bloom_data, HashHost(host));
+
+    Header file_header;
+    memcpy(file_header.magic, BLOCKLIST_MAGIC, sizeof(BLOCKLIST_MAGIC));
+    file_header.version = BLOCKLIST_VERSION;
+    file_header.rule_count = quint32(rule_count);
+    file_header.bloom_words = quint32(bloom_data.size());
+    file_header.bloom_hashes = BLOOM_HASHES;
+    file_header.node_count = quint32(flat.size());
+    file_header.path_count = quint32(flat_paths.size());
+    file_header.strings_size = quint32(string_data.size());
+
+    QByteArray data;
+    Append(data, &file_header, sizeof(file_header));
+    Append(data, bloom_data.constData(), bloom_data.size() * int(sizeof(quint32)));
+    Append(data, flat.constData(), flat.size() * int(sizeof(Node)));
+    Append(data, flat_paths.constData(), flat_paths.size() * int(sizeof(Path)));
+    data.append(string_data);
+    if (output->write(data) != data.size())
+        return -1;
+    return rule_count;
+}
@@ -0,0 +1,63 @@
+#ifndef REQUESTBLOCKLIST_H
+#define REQUESTBLOCKLIST_H
+
+#include <QString>
+#include <QStringList>
+#include <QStringRef>
+
+class QFile;
+class QIODevice;
+
+// Read-only list of blocked hosts and paths, compiled ahead of time and
+// memory-mapped, so opening it does not parse text rules however many
+// there are. A lookup first tests the suffixes of the URL's host against a
+// bloom filter, most URLs stop there; candidates are confirmed in a trie of
+// host labels, last label first. Lookups do not allocate.
+//
+// Text rules, one per line ('#' and '!' start comments):
+//
+//   example.com           example.com and all its subdomains
+//   example.com/ads/      paths starting with /ads/ on those hosts
+//   ||example.com^        adblock host syntax, same as example.com
+//   0.0.0.0 example.com   hosts file syntax, same as example.com
+class RequestBlocklist
+{
+public:
+    RequestBlocklist();
+    ~RequestBlocklist();
+
+    // maps a file written by compile(), false if it is missing or malformed
+    bool open(const QString &file_name);
+    void close();
+    bool isOpen() const;
+
+    int ruleCount() const;
+
+    bool isBlocked(const QString &url) const;
+    // false when the bloom filter alone rules the host out
+    bool mayBlockHost(const QStringRef &host) const;
+
+    // writes the compiled form of text rules, returns the number of rules
+    // or -1 when it cannot write; malformed lines are skipped
+    static int compile(const QStringList &rules, QIODevice *output);
+
+private:
+    Q_DISABLE_COPY(RequestBlocklist)
+
+    struct Header;
+    struct Node;
+    struct Path;
+
+    bool attach(const uchar *data, qint64 size);
+    int child(int node, const QStringRef &host, int start, int end) const;
+    bool pathBlocked(const Node &node, const QString &url, const QStringRef &host) const;
+
+    QFile *file;
+    const Header *header;
+    const quint32 *bloom;
+    const Node *nodes;
+    const Path *paths;
+    const char *strings;
+};
+
+#endif // REQUESTBLOCKLIST_H
@@ -0,0 +1,70 @@
+#include "resizecoalescer.h"
+
+#include <QTimer>
+
+ResizeCoalescer::ResizeCoalescer(QObject *parent)
+    : QObject(parent)
+    , timer(new QTimer(this))
+    , raw_events(0)
+    , applied_events(0)
+{
+    timer->setSingleShot(true);
+    timer->setInterval(16);
+    connect(timer, SIGNAL(timeout()), this, SLOT(intervalElapsed()));
+}
+
+void ResizeCoalescer::setInterval(int msecs)
+{
+    timer->setInterval(msecs);
+}
+
+int ResizeCoalescer::interval() const
+{
+    return timer->interval();
+}
+
+void ResizeCoalescer::post(const QSize &size)
+{
+    ++raw_events;
+    if (timer->isActive())
+    {
+        // inside the current frame, keep only the latest size
+        pending = size;
+        return;
+    }
+    pending = QSize();
+    apply(size);
+}
+
+void ResizeCoalescer::flush()
+{
+    timer->stop();
+    if (pending.isValid())
+    {
+        QSize size = pending;
+        pending = QSize();
+        apply(size);
+    }
+}
+
+void ResizeCoalescer::reset()
+{
+    timer->stop();
+    pending = QSize();
+    applied = QSize();
+}
+
+void ResizeCoalescer::intervalElapsed()
+{
+    flush();
+}
+
+void ResizeCoalescer::apply(const QSize &size)
+{
+    if (size == applied)
+        return;
+    applied = size;
+    ++applied_events;
+    timer->start();
+    emit resize(size);
+}
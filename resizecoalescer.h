@@ -0,0 +1,51 @@
+#ifndef RESIZECOALESCER_H
+#define RESIZECOALESCER_H
+
+#include <QObject>
+#include <QSize>
+
+class QTimer;
+
+// Collapses the resize events of a live window drag into at most one
+// engine resize per interval (one display frame by default). The first size
+// of a burst is applied at once, the rest of the burst collapses into its
+// latest size, which is applied when the interval ends. Sizes equal to the
+// last applied one are dropped.
+class ResizeCoalescer : public QObject
+{
+    Q_OBJECT
+    Q_DISABLE_COPY(ResizeCoalescer)
+public:
+    explicit ResizeCoalescer(QObject *parent = 0);
+
+    void setInterval(int msecs);
+    int interval() const;
+
+    void post(const QSize &size);
+    // applies a pending size right away
+    void flush();
+    // drops a pending size and forgets the last applied one, so the next
+    // size is applied at once even if it is equal
+    void reset();
+
+    quint64 rawEvents() const { return raw_events; }
+    quint64 appliedEvents() const { return applied_events; }
+    quint64 droppedEvents() const { return raw_events - applied_events; }
+
+signals:
+    void resize(const QSize &size);
+
+private slots:
+    void intervalElapsed();
+
+private:
+    void apply(const QSize &size);
+
+    QTimer *timer;
+    QSize pending;
+    QSize applied;
+    quint64 raw_events;
+    quint64 applied_events;
+};
+
+#endif // RESIZECOALESCER_H
@@ -0,0 +1,87 @@
+#include "resourceschemehandler.h"
+
+#include <QDir>
+#include <QFileInfo>
+#include <QMimeType>
+#include <QResource>
+
+namespace {
+
+static int last_archive = 0;
+
+} // anonymous
+
+ResourceSchemeHandler::ResourceSchemeHandler(const QString &root)
+    : resource_root(root)
+{
+}
+
+ResourceSchemeHandler::~ResourceSchemeHandler()
+{
+    closeArchive();
+}
+
+bool ResourceSchemeHandler::openArchive(const QString &rcc_file)
+{
+    QString map_root = QString("/nativebrowser-archive-%1").arg(++last_archive);
+    if (!QResource::registerResource(rcc_file, map_root))
+        return false;
+    closeArchive();
+    archive_file = rcc_file;
+    archive_root = map_root;
+    resource_root = ":" + map_root;
+    return true;
+}
+
+void ResourceSchemeHandler::closeArchive()
+{
+    if (archive_file.isEmpty())
+        return;
+    QResource::unregisterResource(archive_file, archive_root);
+    archive_file.clear();
+    archive_root.clear();
+}
+
+QString ResourceSchemeHandler::root() const
+{
+    return resource_root;
+}
+
+void ResourceSchemeHandler::start(const SchemeRequestPointer &request)
+{
+    QUrl url = request->url();
+    QString relative = QDir::cleanPath("/" + url.host() + "/" + url.path());
+    if (relative.startsWith("/.."))
+    {
+        request->fail(403);
+        return;
+    }
+    QString path = QDir::cleanPath(resource_root + relative);
+    if (path.endsWith('/') || QFileInfo(path).isDir())
+        path = QDir::cleanPath(path + "/index.html");
+
+    QResource resource(path);
+    if (!resource.isValid() || !resource.data())
+    {
+        request->fail(404);
+        return;
+    }
+
+    QByteArray data;
+    if (resource.isCompressed())
+    {
+        data = qUncompress(resource.data(), int(resource.size()));
+    }
+    else if (archive_file.isEmpty())
+    {
+        // compiled-in resource data lives as long as the application
+        data = QByteArray::fromRawData(reinterpret_cast<const char *>(resource.data()), int(resource.size()));
+    }
+    else
+    {
+        // an archive is unmapped by closeArchive(), replies must not point into it
+        data = QByteArray(reinterpret_cast<const char *>(resource.data()), int(resource.size()));
+    }
+    QMimeType mime = mime_database.mimeTypeForFile(path, QMimeDatabase::MatchExtension);
+    request->reply(mime.name().toUtf8(), data);
+}
@@ -0,0 +1,40 @@
+#ifndef RESOURCESCHEMEHANDLER_H
+#define RESOURCESCHEMEHANDLER_H
+
+#include <QMimeDatabase>
+#include <QString>
+
+#include "schemehandler.h"
+
+// Serves a Qt resource directory, compiled into the application or loaded
+// from a binary archive (rcc -binary), which Qt memory-maps. Compiled-in
+// entries stored uncompressed (rcc -no-compress) are handed to the engine
+// without a copy; archive entries are copied, the engine may still read a
+// reply after the archive was replaced or the handler deleted.
+// scheme://host/path maps to root/host/path, scheme:///path to root/path.
+class ResourceSchemeHandler : public SchemeHandler
+{
+public:
+    // root is a resource directory such as ":/ui"
+    explicit ResourceSchemeHandler(const QString &root = QString(":/"));
+    virtual ~ResourceSchemeHandler();
+
+    // maps an archive and serves it instead of the current root, false if
+    // it cannot be read
+    bool openArchive(const QString &rcc_file);
+
+    QString root() const;
+
+    virtual void start(const SchemeRequestPointer &request) override;
+
+private:
+    Q_DISABLE_COPY(ResourceSchemeHandler)
+    void closeArchive();
+
+    QString resource_root;
+    QString archive_file;
+    QString archive_root;
+    QMimeDatabase mime_database;
+};
+
+#endif // RESOURCESCHEMEHANDLER_H
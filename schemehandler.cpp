@@ -0,0 +1,195 @@
+#include "schemehandler.h"
+
+#include <QCoreApplication>
+#include <QMap>
+#include <QMetaObject>
+#include <QMutexLocker>
+#include <QThread>
+
+namespace {
+
+static QMutex handlers_mutex;
+static QMap<QString, SchemeHandler *> handlers;
+
+static SchemeHandler *HandlerFor(const QString &scheme)
+{
+    QMutexLocker lock(&handlers_mutex);
+    return handlers.value(scheme.toLower(), 0);
+}
+
+static bool IsEngineScheme(const QString &scheme)
+{
+    static const char *const engine_schemes[] = {
+        "about", "data", "file", "ftp", "http", "https", "javascript", "res"
+    };
+    for (const char *engine_scheme : engine_schemes)
+    {
+        if (scheme == QLatin1String(engine_scheme))
+            return true;
+    }
+    return false;
+}
+
+} // anonymous
+
+// Moves requests made on an engine thread to the GUI thread.
+class SchemeDispatcher : public QObject
+{
+    Q_OBJECT
+public:
+    static SchemeDispatcher *instance()
+    {
+        static SchemeDispatcher *dispatcher = 0;
+        if (!dispatcher)
+        {
+            // created by the first registration, on the GUI thread
+            dispatcher = new SchemeDispatcher();
+            dispatcher->moveToThread(QCoreApplication::instance()->thread());
+        }
+        return dispatcher;
+    }
+
+    void post(const SchemeRequestPointer &request)
+    {
+        QMutexLocker lock(&queue_mutex);
+        queue.append(request);
+        if (queue.size() == 1)
+            QMetaObject::invokeMethod(this, "dispatch", Qt::QueuedConnection);
+    }
+
+public slots:
+    void dispatch()
+    {
+        QList<SchemeRequestPointer> requests;
+        {
+            QMutexLocker lock(&queue_mutex);
+            requests.swap(queue);
+        }
+        for (const SchemeRequestPointer &request : requests)
+            SchemeHandlers::start(request);
+    }
+
+private:
+    QMutex queue_mutex;
+    QList<SchemeRequestPointer> queue;
+};
+
+SchemeRequest::SchemeRequest(const QUrl &url)
+    : request_url(url)
+    , status_code(0)
+    , done(false)
+    , cancelled(0)
+{
+}
+
+SchemeRequest::~SchemeRequest()
+{
+}
+
+QUrl SchemeRequest::url() const
+{
+    return request_url;
+}
+
+void SchemeRequest::reply(const QByteArray &mime_type, const QByteArray &data)
+{
+    if (finish(200, mime_type, data))
+        finished();
+}
+
+void SchemeRequest::fail(int status)
+{
+    if (finish(status, QByteArray(), QByteArray()))
+        finished();
+}
+
+void SchemeRequest::cancel()
+{
+    cancelled.store(1);
+}
+
+bool SchemeRequest::isCancelled() const
+{
+    return cancelled.load() != 0;
+}
+
+bool SchemeRequest::isFinished() const
+{
+    QMutexLocker lock(&mutex);
+    return done;
+}
+
+int SchemeRequest::status() const
+{
+    QMutexLocker lock(&mutex);
+    return status_code;
+}
+
+QByteArray SchemeRequest::mimeType() const
+{
+    QMutexLocker lock(&mutex);
+    return mime;
+}
+
+QByteArray SchemeRequest::data() const
+{
+    QMutexLocker lock(&mutex);
+    return body;
+}
+
+bool SchemeRequest::finish(int status, const QByteArray &mime_type, const QByteArray &data)
+{
+    QMutexLocker lock(&mutex);
+    if (done)
+        return false; // answered already
+    done = true;
+    status_code = status;
+    mime = mime_type;
+    body = data;
+    return true;
+}
+
+bool SchemeHandlers::registerHandler(const QString &scheme, SchemeHandler *handler)
+{
+    QString name = scheme.toLower();
+    if (name.isEmpty() || IsEngineScheme(name))
+        return false;
+    SchemeDispatcher::instance();
+    QMutexLocker lock(&handlers_mutex);
+    if (handler)
+        handlers.insert(name, handler);
+    else
+        handlers.remove(name);
+    return true;
+}
+
+bool SchemeHandlers::isRegistered(const QString &scheme)
+{
+    return HandlerFor(scheme) != 0;
+}
+
+QStringList SchemeHandlers::schemes()
+{
+    QMutexLocker lock(&handlers_mutex);
+    return handlers.keys();
+}
+
+void SchemeHandlers::start(const SchemeRequestPointer &request)
+{
+    if (QThread::currentThread() != QCoreApplication::instance()->thread())
+    {
+        SchemeDispatcher::instance()->post(request);
+        return;
+    }
+    if (request->isCancelled())
+        return;
+    SchemeHandler *handler = HandlerFor(request->url().scheme());
+    if (!handler)
+    {
+        request->fail(404);
+        return;
+    }
+    handler->start(request);
+}
+
+#include "schemehandler.moc"
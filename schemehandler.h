@@ -0,0 +1,81 @@
+#ifndef SCHEMEHANDLER_H
+#define SCHEMEHANDLER_H
+
+#include <QAtomicInt>
+#include <QByteArray>
+#include <QMutex>
+#include <QSharedPointer>
+#include <QStringList>
+#include <QUrl>
+
+// One request the engine made to a custom scheme. The handler answers it
+// once with reply() or fail(), right away or later and from any thread;
+// backends subclass it to hand the answer to their engine.
+class SchemeRequest
+{
+public:
+    explicit SchemeRequest(const QUrl &url);
+    virtual ~SchemeRequest();
+
+    QUrl url() const;
+
+    // data may point into memory that outlives the request (a mapped
+    // archive, QByteArray::fromRawData), it is not copied
+    void reply(const QByteArray &mime_type, const QByteArray &data);
+    void fail(int status = 404);
+
+    // the engine no longer wants the answer, e.g. the load was stopped
+    void cancel();
+    bool isCancelled() const;
+
+    bool isFinished() const;
+    int status() const; // 200 after reply()
+    QByteArray mimeType() const;
+    QByteArray data() const;
+
+protected:
+    // called once, by reply() or fail() and on their thread
+    virtual void finished() = 0;
+
+private:
+    Q_DISABLE_COPY(SchemeRequest)
+    bool finish(int status, const QByteArray &mime_type, const QByteArray &data);
+
+    const QUrl request_url;
+    mutable QMutex mutex;
+    int status_code;
+    QByteArray mime;
+    QByteArray body;
+    bool done;
+    QAtomicInt cancelled;
+};
+
+typedef QSharedPointer<SchemeRequest> SchemeRequestPointer;
+
+// Produces the documents and assets of a custom URL scheme, see
+// NativeBrowser::registerSchemeHandler().
+class SchemeHandler
+{
+public:
+    virtual ~SchemeHandler() {}
+
+    // called on the GUI thread; must not block, slow producers keep the
+    // request and answer it later
+    virtual void start(const SchemeRequestPointer &request) = 0;
+};
+
+// Process-wide scheme -> handler table, read by the engines' threads.
+class SchemeHandlers
+{
+public:
+    // handler 0 unregisters; false for schemes the engines handle themselves
+    static bool registerHandler(const QString &scheme, SchemeHandler *handler);
+    static bool isRegistered(const QString &scheme);
+    static QStringList schemes();
+
+    // hands the request to its handler on the GUI thread, fails it when
+    // the scheme has none
+    static void start(const SchemeRequestPointer &request);
+};
+
+#endif // SCHEMEHANDLER_H
@@ -0,0 +1,15 @@
+QT      *= core testlib
+QT      -= gui
+
+TEMPLATE = app
+TARGET   = tst_browserfeaturecontrol
+CONFIG  += C++11 console testcase
+CONFIG  -= app_bundle
+
+INCLUDEPATH += $$PWD/../..
+
+SOURCES += tst_browserfeaturecontrol.cpp \
+    $$PWD/../../browserfeaturecontrol.cpp
+
+HEADERS += \
+    $$PWD/../../browserfeaturecontrol.h
@@ -0,0 +1,126 @@
+#include <QtTest>
+
+#include "browserfeaturecontrol.h"
+
+namespace {
+
+// Records what would be written to the registry.
+class FakeFeatureStore : public BrowserFeatureStore
+{
+public:
+    FakeFeatureStore()
+        : version("11.0.9600.18860")
+        , writes(0)
+    {}
+
+    virtual QString engineVersion() override { return version; }
+    virtual QString processName() override { return "browser_test.exe"; }
+    virtual bool setFeature(const QString &feature, const QString &process_name, quint32 value) override
+    {
+        ++writes;
+        written[feature] = value;
+        last_process = process_name;
+        return true;
+    }
+
+    QString version;
+    int writes;
+    BrowserFeatureControl::Features written;
+    QString last_process;
+};
+
+} // anonymous
+
+// BrowserFeatureControl keeps process-wide state that cannot be reset, so
+// the functions below run in order and build on each other.
+class TestBrowserFeatureControl : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void emulationModeForVersion_data();
+    void emulationModeForVersion();
+    void setFeaturesBeforeInitialize();
+    void initializeAppliesOnce();
+    void setFeaturesAfterInitialize();
+
+private:
+    FakeFeatureStore store;
+};
+
+void TestBrowserFeatureControl::emulationModeForVersion_data()
+{
+    QTest::addColumn<QString>("version");
+    QTest::addColumn<quint32>("mode");
+    QTest::newRow("ie7") << "7.0.5730.13" << quint32(7000);
+    QTest::newRow("ie8") << "8.0.6001.18702" << quint32(8000);
+    QTest::newRow("ie9") << "9.0.8112.16421" << quint32(9000);
+    QTest::newRow("ie10") << "10.0.9200.16384" << quint32(10000);
+    QTest::newRow("ie11") << "11.0.9600.18860" << quint32(11000);
+    QTest::newRow("newer") << "12.0.1" << quint32(11001);
+    QTest::newRow("ie6") << "6.0.2900.5512" << quint32(0);
+    QTest::newRow("empty") << "" << quint32(0);
+    QTest::newRow("garbage") << "svc.11" << quint32(0);
+}
+
+void TestBrowserFeatureControl::emulationModeForVersion()
+{
+    QFETCH(QString, version);
+    QFETCH(quint32, mode);
+    QCOMPARE(BrowserFeatureControl::emulationModeForVersion(version), mode);
+}
+
+void TestBrowserFeatureControl::setFeaturesBeforeInitialize()
+{
+    BrowserFeatureControl::setStore(&store);
+    BrowserFeatureControl::Features features;
+    features["FEATURE_DISABLE_NAVIGATION_SOUNDS"] = 1;
+    BrowserFeatureControl::setFeatures(features);
+    // kept until the first browser is created
+    QCOMPARE(store.writes, 0);
+    QCOMPARE(BrowserFeatureControl::features(), features);
+    QCOMPARE(BrowserFeatureControl::emulationMode(), quint32(0));
+}
+
+void TestBrowserFeatureControl::initializeAppliesOnce()
+{
+    // the injected store wins over the platform default
+    FakeFeatureStore platform_store;
+    QVERIFY(BrowserFeatureControl::initialize(&platform_store));
+    QCOMPARE(platform_store.writes, 0);
+    QCOMPARE(store.writes, 2);
+    QCOMPARE(store.written.value("FEATURE_DISABLE_NAVIGATION_SOUNDS"), quint32(1));
+    QCOMPARE(store.written.value("FEATURE_BROWSER_EMULATION"), quint32(11000));
+    QCOMPARE(store.last_process, QString("browser_test.exe"));
+    QCOMPARE(BrowserFeatureControl::emulationMode(), quint32(11000));
+
+    // every further browser finds the settings written
+    for (int i = 0; i < 3; ++i)
+        QVERIFY(BrowserFeatureControl::initialize(&platform_store));
+    QCOMPARE(store.writes, 2);
+    QCOMPARE(platform_store.writes, 0);
+}
+
+void TestBrowserFeatureControl::setFeaturesAfterInitialize()
+{
+    // applied right away, an explicit emulation mode replaces the derived one
+    BrowserFeatureControl::Features features;
+    features["FEATURE_GPU_RENDERING"] = 1;
+    features["FEATURE_BROWSER_EMULATION"] = 10001;
+    store.written.clear();
+    BrowserFeatureControl::setFeatures(features);
+    QCOMPARE(store.written, features);
+    QCOMPARE(BrowserFeatureControl::emulationMode(), quint32(10001));
+
+    // without one the engine's mode comes back
+    features.remove("FEATURE_BROWSER_EMULATION");
+    store.written.clear();
+    BrowserFeatureControl::setFeatures(features);
+    QCOMPARE(store.written.value("FEATURE_GPU_RENDERING"), quint32(1));
+    QCOMPARE(store.written.value("FEATURE_BROWSER_EMULATION"), quint32(11000));
+    QCOMPARE(BrowserFeatureControl::emulationMode(), quint32(11000));
+}
+
+QTEST_APPLESS_MAIN(TestBrowserFeatureControl)
+
+#include "tst_browserfeaturecontrol.moc"
@@ -0,0 +1,12 @@
+QT      *= core gui widgets network testlib
+
+TEMPLATE = app
+TARGET   = tst_navigationhistory
+CONFIG  += C++11 console testcase
+CONFIG  -= app_bundle
+
+include(../../nativebrowser.pri)
+
+INCLUDEPATH += $$PWD/../..
+
+SOURCES += tst_navigationhistory.cpp
@@ -0,0 +1,318 @@
+#include <QtTest>
+
+#include <QApplication>
+
+#include "nativebrowser.h"
+#include "nativebrowserimpl.h"
+
+namespace {
+
+// every document serializes to this many bytes, snapshot budgets are
+// multiples of it
+static const int DOCUMENT_SIZE = 100;
+
+static QString Page(const char *name)
+{
+    return QString("http://history.test/") + name;
+}
+
+} // anonymous
+
+// Backend without an engine: every navigation starts and finishes on the
+// next event loop iteration, and the document it shows serializes to a
+// fixed size. What the engine was asked to show is recorded, documents
+// from memory as "html:" and their base URL.
+class HistoryTestBackend : public NativeBrowserImpl
+{
+    Q_OBJECT
+public:
+    static NativeBrowserImpl *create(WId)
+    {
+        return new HistoryTestBackend();
+    }
+
+    static QStringList navigations;
+
+    virtual void navigate(const QString &url) override
+    {
+        navigations << url;
+        show(url, url.toUtf8());
+    }
+
+    virtual void navigateToHtml(const QByteArray &html, const QUrl &base_url) override
+    {
+        navigations << "html:" + base_url.toString();
+        show(base_url.toString(), html);
+    }
+
+    virtual QString location() const override
+    {
+        return current_url;
+    }
+
+    virtual void stop() override
+    {
+        pending = false;
+    }
+
+    virtual void setSize(const QSize &) override
+    {
+    }
+
+    virtual QSize contentSize() const override
+    {
+        return QSize(800, 600);
+    }
+
+    virtual QByteArray serializeDocument() const override
+    {
+        return document;
+    }
+
+private slots:
+    void finishLoad()
+    {
+        if (!pending)
+            return;
+        pending = false;
+        onLoadStart();
+        onLoadFinish(true);
+    }
+
+private:
+    HistoryTestBackend()
+        : pending(false)
+    {
+    }
+
+    void show(const QString &url, const QByteArray &content)
+    {
+        current_url = url;
+        document = content.leftJustified(DOCUMENT_SIZE, ' ', true);
+        pending = true;
+        QMetaObject::invokeMethod(this, "finishLoad", Qt::QueuedConnection);
+    }
+
+    QString current_url;
+    QByteArray document;
+    bool pending;
+};
+
+QStringList HistoryTestBackend::navigations;
+
+// Drives NativeBrowser's back/forward history through HistoryTestBackend.
+class TestNavigationHistory : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void cleanupTestCase();
+    void init();
+    void backAndForward();
+    void newLoadTruncates();
+    void historySizeTrims();
+    void snapshotRestoreRevalidates();
+    void snapshotEviction();
+
+private:
+    // runs the event loop until count more loads finished
+    static void waitForLoads(NativeBrowser &browser, int count);
+    static void load(NativeBrowser &browser, const QString &url);
+    static QStringList urls(const NativeBrowser &browser);
+};
+
+void TestNavigationHistory::initTestCase()
+{
+    NativeBrowserImpl::setInstanceFactory(&HistoryTestBackend::create);
+}
+
+void TestNavigationHistory::cleanupTestCase()
+{
+    NativeBrowserImpl::setInstanceFactory(0);
+}
+
+void TestNavigationHistory::init()
+{
+    HistoryTestBackend::navigations.clear();
+}
+
+void TestNavigationHistory::waitForLoads(NativeBrowser &browser, int count)
+{
+    QSignalSpy finished(&browser, SIGNAL(loadFinished(bool)));
+    QTRY_COMPARE(finished.count(), count);
+    // nothing else follows on its own
+    QTest::qWait(10);
+    QCOMPARE(finished.count(), count);
+}
+
+void TestNavigationHistory::load(NativeBrowser &browser, const QString &url)
+{
+    QSignalSpy finished(&browser, SIGNAL(loadFinished(bool)));
+    browser.load(url);
+    QTRY_COMPARE(finished.count(), 1);
+    QVERIFY(finished.at(0).at(0).toBool());
+}
+
+QStringList TestNavigationHistory::urls(const NativeBrowser &browser)
+{
+    QStringList result;
+    for (const NavigationHistoryEntry &entry : browser.history())
+        result << entry.url;
+    return result;
+}
+
+void TestNavigationHistory::backAndForward()
+{
+    NativeBrowser browser;
+    QCOMPARE(browser.historyIndex(), -1);
+    QVERIFY(!browser.canGoBack());
+    load(browser, Page("a"));
+    load(browser, Page("b"));
+    load(browser, Page("c"));
+    QCOMPARE(urls(browser), QStringList() << Page("a") << Page("b") << Page("c"));
+    QCOMPARE(browser.historyIndex(), 2);
+    QVERIFY(browser.canGoBack());
+    QVERIFY(!browser.canGoForward());
+
+    // without snapshots an entry is loaded from its URL
+    browser.back();
+    QCOMPARE(browser.historyIndex(), 1);
+    waitForLoads(browser, 1);
+    QCOMPARE(HistoryTestBackend::navigations.last(), Page("b"));
+    QCOMPARE(browser.url(), Page("b"));
+    QVERIFY(browser.canGoBack());
+    QVERIFY(browser.canGoForward());
+
+    browser.back();
+    waitForLoads(browser, 1);
+    QCOMPARE(browser.historyIndex(), 0);
+    QVERIFY(!browser.canGoBack());
+
+    // at the ends of the list nothing happens
+    browser.back();
+    QCOMPARE(browser.historyIndex(), 0);
+
+    browser.forward();
+    waitForLoads(browser, 1);
+    QCOMPARE(browser.historyIndex(), 1);
+    QCOMPARE(browser.url(), Page("b"));
+    // moving through the history adds no entries
+    QCOMPARE(browser.history().size(), 3);
+}
+
+void TestNavigationHistory::newLoadTruncates()
+{
+    NativeBrowser browser;
+    load(browser, Page("a"));
+    load(browser, Page("b"));
+    load(browser, Page("c"));
+    browser.goToHistoryIndex(0);
+    waitForLoads(browser, 1);
+
+    // the entries after the current one are dropped
+    load(browser, Page("d"));
+    QCOMPARE(urls(browser), QStringList() << Page("a") << Page("d"));
+    QCOMPARE(browser.historyIndex(), 1);
+    QVERIFY(!browser.canGoForward());
+
+    // loading the current URL again adds no entry
+    load(browser, Page("d"));
+    QCOMPARE(browser.history().size(), 2);
+}
+
+void TestNavigationHistory::historySizeTrims()
+{
+    NativeBrowser browser;
+    QCOMPARE(browser.historySize(), 50);
+    load(browser, Page("a"));
+    load(browser, Page("b"));
+    load(browser, Page("c"));
+
+    // the oldest entries go first, the current one stays current
+    browser.setHistorySize(2);
+    QCOMPARE(urls(browser), QStringList() << Page("b") << Page("c"));
+    QCOMPARE(browser.historyIndex(), 1);
+
+    load(browser, Page("d"));
+    QCOMPARE(urls(browser), QStringList() << Page("c") << Page("d"));
+    QCOMPARE(browser.historyIndex(), 1);
+
+    browser.setHistorySize(0);
+    QCOMPARE(browser.historySize(), 1);
+    QCOMPARE(urls(browser), QStringList() << Page("d"));
+    QCOMPARE(browser.historyIndex(), 0);
+}
+
+void TestNavigationHistory::snapshotRestoreRevalidates()
+{
+    NativeBrowser browser;
+    browser.setHistorySnapshotBudget(10 * DOCUMENT_SIZE);
+    load(browser, Page("a"));
+    load(browser, Page("b"));
+    QVERIFY(browser.history().at(0).has_snapshot);
+    QVERIFY(browser.history().at(1).has_snapshot);
+
+    // the snapshot is shown first, then the page is loaded behind it
+    HistoryTestBackend::navigations.clear();
+    browser.back();
+    waitForLoads(browser, 2);
+    QCOMPARE(HistoryTestBackend::navigations, QStringList() << "html:" + Page("a") << Page("a"));
+    QCOMPARE(browser.historyIndex(), 0);
+    QCOMPARE(urls(browser), QStringList() << Page("a") << Page("b"));
+    // the revalidated page replaced the snapshot
+    QVERIFY(browser.history().at(0).has_snapshot);
+
+    HistoryTestBackend::navigations.clear();
+    browser.forward();
+    waitForLoads(browser, 2);
+    QCOMPARE(HistoryTestBackend::navigations, QStringList() << "html:" + Page("b") << Page("b"));
+    QCOMPARE(browser.historyIndex(), 1);
+}
+
+void TestNavigationHistory::snapshotEviction()
+{
+    NativeBrowser browser;
+    browser.setHistorySnapshotBudget(2 * DOCUMENT_SIZE);
+    load(browser, Page("a"));
+    load(browser, Page("b"));
+    load(browser, Page("c"));
+    // two fit, the least recently used one was evicted
+    QVERIFY(!browser.history().at(0).has_snapshot);
+    QVERIFY(browser.history().at(1).has_snapshot);
+    QVERIFY(browser.history().at(2).has_snapshot);
+
+    // b is used again, a is loaded from its URL and snapshotted anew
+    browser.setHistorySnapshotBudget(3 * DOCUMENT_SIZE);
+    browser.goToHistoryIndex(1);
+    waitForLoads(browser, 2);
+    browser.goToHistoryIndex(0);
+    waitForLoads(browser, 1);
+    QCOMPARE(HistoryTestBackend::navigations.last(), Page("a"));
+    QVERIFY(browser.history().at(0).has_snapshot);
+    QVERIFY(browser.history().at(1).has_snapshot);
+    QVERIFY(browser.history().at(2).has_snapshot);
+
+    // c is the newest entry but the least recently used snapshot
+    browser.setHistorySnapshotBudget(2 * DOCUMENT_SIZE);
+    QVERIFY(browser.history().at(0).has_snapshot);
+    QVERIFY(browser.history().at(1).has_snapshot);
+    QVERIFY(!browser.history().at(2).has_snapshot);
+
+    // 0 disables the cache
+    browser.setHistorySnapshotBudget(0);
+    for (const NavigationHistoryEntry &entry : browser.history())
+        QVERIFY(!entry.has_snapshot);
+}
+
+int main(int argc, char *argv[])
+{
+    // the browsers are never shown, no display is needed
+    if (qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM"))
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+    QApplication app(argc, argv);
+    TestNavigationHistory test;
+    return QTest::qExec(&test, argc, argv);
+}
+
+#include "tst_navigationhistory.moc"
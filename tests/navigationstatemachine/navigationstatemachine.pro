@@ -0,0 +1,15 @@
+QT      *= core testlib
+QT      -= gui
+
+TEMPLATE = app
+TARGET   = tst_navigationstatemachine
+CONFIG  += C++11 console testcase
+CONFIG  -= app_bundle
+
+INCLUDEPATH += $$PWD/../..
+
+SOURCES += tst_navigationstatemachine.cpp \
+    $$PWD/../../navigationstatemachine.cpp
+
+HEADERS += \
+    $$PWD/../../navigationstatemachine.h
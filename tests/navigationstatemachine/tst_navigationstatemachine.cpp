@@ -0,0 +1,216 @@
+#include <QtTest>
+
+#include "navigationstatemachine.h"
+
+// Feeds synthetic engine event sequences to NavigationStateMachine and
+// checks the actions it asks for.
+class TestNavigationStateMachine : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void topFrameCompletes();
+    void subframesDoNotFinish();
+    void topFrameErrorFails();
+    void subframeErrorSucceeds();
+    void engineFinish();
+    void supersededLoad();
+    void timeoutWithoutActivity();
+    void timeoutAfterActivity();
+    void disabledTimeouts();
+    void cancelWhileLoading();
+    void cancelWhileRequested();
+    void timeoutWhileRequested();
+    void refusedWhileRequested();
+    void eventsWhileIdle();
+
+private:
+    // asks machine to navigate and tells it the top frame started, false
+    // if it did not answer as a fresh load should
+    static bool startLoad(NavigationStateMachine &machine);
+};
+
+bool TestNavigationStateMachine::startLoad(NavigationStateMachine &machine)
+{
+    machine.setTimeouts(1000, 200);
+    // the engine has as long to start as a started load to show activity
+    if (machine.requested() != NavigationStateMachine::RestartTimer || machine.timerInterval() != 1000)
+        return false;
+    if (machine.state() != NavigationStateMachine::Requested)
+        return false;
+    if (machine.started(true) != (NavigationStateMachine::EmitStarted | NavigationStateMachine::RestartTimer))
+        return false;
+    return machine.timerInterval() == 1000 && machine.isLoading();
+}
+
+void TestNavigationStateMachine::topFrameCompletes()
+{
+    NavigationStateMachine machine;
+    QVERIFY(startLoad(machine));
+    QCOMPARE(machine.progress(), int(NavigationStateMachine::RestartTimer));
+    QCOMPARE(machine.timerInterval(), 200);
+    QCOMPARE(machine.navigateComplete(true), int(NavigationStateMachine::RestartTimer));
+    QCOMPARE(machine.documentComplete(true), NavigationStateMachine::EmitFinished | NavigationStateMachine::StopTimer);
+    QVERIFY(machine.succeeded());
+    QCOMPARE(machine.state(), NavigationStateMachine::Idle);
+}
+
+void TestNavigationStateMachine::subframesDoNotFinish()
+{
+    NavigationStateMachine machine;
+    QVERIFY(startLoad(machine));
+    // a frame starting inside a running load is not a new load
+    QCOMPARE(machine.started(false), int(NavigationStateMachine::NoAction));
+    QCOMPARE(machine.started(true), int(NavigationStateMachine::NoAction));
+    QCOMPARE(machine.navigateComplete(false), int(NavigationStateMachine::RestartTimer));
+    QCOMPARE(machine.documentComplete(false), int(NavigationStateMachine::RestartTimer));
+    QVERIFY(machine.isLoading());
+    QCOMPARE(machine.documentComplete(true), NavigationStateMachine::EmitFinished | NavigationStateMachine::StopTimer);
+    QVERIFY(machine.succeeded());
+}
+
+void TestNavigationStateMachine::topFrameErrorFails()
+{
+    NavigationStateMachine machine;
+    QVERIFY(startLoad(machine));
+    // the engine still completes its error document
+    QCOMPARE(machine.navigateError(true), int(NavigationStateMachine::RestartTimer));
+    QVERIFY(machine.isLoading());
+    QCOMPARE(machine.documentComplete(true), NavigationStateMachine::EmitFinished | NavigationStateMachine::StopTimer);
+    QVERIFY(!machine.succeeded());
+}
+
+void TestNavigationStateMachine::subframeErrorSucceeds()
+{
+    NavigationStateMachine machine;
+    QVERIFY(startLoad(machine));
+    QCOMPARE(machine.navigateError(false), int(NavigationStateMachine::RestartTimer));
+    QCOMPARE(machine.documentComplete(true), NavigationStateMachine::EmitFinished | NavigationStateMachine::StopTimer);
+    QVERIFY(machine.succeeded());
+}
+
+void TestNavigationStateMachine::engineFinish()
+{
+    NavigationStateMachine machine;
+    QVERIFY(startLoad(machine));
+    QCOMPARE(machine.finished(false), NavigationStateMachine::EmitFinished | NavigationStateMachine::StopTimer);
+    QVERIFY(!machine.succeeded());
+
+    QVERIFY(startLoad(machine));
+    QCOMPARE(machine.finished(true), NavigationStateMachine::EmitFinished | NavigationStateMachine::StopTimer);
+    QVERIFY(machine.succeeded());
+    // a late completion of the finished load changes nothing
+    QCOMPARE(machine.documentComplete(true), int(NavigationStateMachine::NoAction));
+    QCOMPARE(machine.finished(false), int(NavigationStateMachine::NoAction));
+    QVERIFY(machine.succeeded());
+}
+
+void TestNavigationStateMachine::supersededLoad()
+{
+    NavigationStateMachine machine;
+    QVERIFY(startLoad(machine));
+    machine.navigateError(true);
+    // superseded without a finish of its own
+    QCOMPARE(machine.requested(), int(NavigationStateMachine::RestartTimer));
+    QCOMPARE(machine.timerInterval(), 1000);
+    QCOMPARE(machine.state(), NavigationStateMachine::Requested);
+    QCOMPARE(machine.documentComplete(true), int(NavigationStateMachine::NoAction));
+    QCOMPARE(machine.started(true), NavigationStateMachine::EmitStarted | NavigationStateMachine::RestartTimer);
+    // the error of the superseded load does not carry over
+    QCOMPARE(machine.documentComplete(true), NavigationStateMachine::EmitFinished | NavigationStateMachine::StopTimer);
+    QVERIFY(machine.succeeded());
+}
+
+void TestNavigationStateMachine::timeoutWithoutActivity()
+{
+    NavigationStateMachine machine;
+    QVERIFY(startLoad(machine));
+    QCOMPARE(machine.timeout(), NavigationStateMachine::StopEngine | NavigationStateMachine::EmitFinished | NavigationStateMachine::StopTimer);
+    QVERIFY(!machine.succeeded());
+    QCOMPARE(machine.state(), NavigationStateMachine::Idle);
+}
+
+void TestNavigationStateMachine::timeoutAfterActivity()
+{
+    NavigationStateMachine machine;
+    QVERIFY(startLoad(machine));
+    machine.progress();
+    // silent after activity: the engine missed its completion event
+    QCOMPARE(machine.timeout(), NavigationStateMachine::EmitFinished | NavigationStateMachine::StopTimer);
+    QVERIFY(machine.succeeded());
+
+    QVERIFY(startLoad(machine));
+    machine.navigateError(true);
+    QCOMPARE(machine.timeout(), NavigationStateMachine::EmitFinished | NavigationStateMachine::StopTimer);
+    QVERIFY(!machine.succeeded());
+}
+
+void TestNavigationStateMachine::disabledTimeouts()
+{
+    NavigationStateMachine machine;
+    machine.setTimeouts(0, 0);
+    QCOMPARE(machine.requested(), int(NavigationStateMachine::StopTimer));
+    QCOMPARE(machine.started(true), NavigationStateMachine::EmitStarted | NavigationStateMachine::StopTimer);
+    QCOMPARE(machine.progress(), int(NavigationStateMachine::StopTimer));
+}
+
+void TestNavigationStateMachine::cancelWhileLoading()
+{
+    NavigationStateMachine machine;
+    QVERIFY(startLoad(machine));
+    QCOMPARE(machine.cancelled(), NavigationStateMachine::EmitFinished | NavigationStateMachine::StopTimer);
+    QVERIFY(!machine.succeeded());
+    QCOMPARE(machine.state(), NavigationStateMachine::Idle);
+}
+
+void TestNavigationStateMachine::cancelWhileRequested()
+{
+    NavigationStateMachine machine;
+    QCOMPARE(machine.requested(), int(NavigationStateMachine::RestartTimer));
+    QCOMPARE(machine.timerInterval(), 5000);
+    // nothing started, nothing finishes
+    QCOMPARE(machine.cancelled(), int(NavigationStateMachine::StopTimer));
+    QCOMPARE(machine.state(), NavigationStateMachine::Idle);
+}
+
+void TestNavigationStateMachine::timeoutWhileRequested()
+{
+    NavigationStateMachine machine;
+    machine.setTimeouts(1000, 200);
+    machine.requested();
+    // the engine never started the navigation
+    QCOMPARE(machine.timeout(), NavigationStateMachine::StopEngine | NavigationStateMachine::EmitFinished | NavigationStateMachine::StopTimer);
+    QVERIFY(!machine.succeeded());
+    QCOMPARE(machine.state(), NavigationStateMachine::Idle);
+}
+
+void TestNavigationStateMachine::refusedWhileRequested()
+{
+    NavigationStateMachine machine;
+    machine.requested();
+    QCOMPARE(machine.refused(), NavigationStateMachine::EmitFinished | NavigationStateMachine::StopTimer);
+    QVERIFY(!machine.succeeded());
+    QCOMPARE(machine.state(), NavigationStateMachine::Idle);
+
+    // a started load is not refused
+    QVERIFY(startLoad(machine));
+    QCOMPARE(machine.refused(), int(NavigationStateMachine::NoAction));
+    QVERIFY(machine.isLoading());
+}
+
+void TestNavigationStateMachine::eventsWhileIdle()
+{
+    NavigationStateMachine machine;
+    QCOMPARE(machine.progress(), int(NavigationStateMachine::NoAction));
+    QCOMPARE(machine.navigateComplete(true), int(NavigationStateMachine::NoAction));
+    QCOMPARE(machine.navigateError(true), int(NavigationStateMachine::NoAction));
+    QCOMPARE(machine.documentComplete(true), int(NavigationStateMachine::NoAction));
+    QCOMPARE(machine.finished(true), int(NavigationStateMachine::NoAction));
+    QCOMPARE(machine.refused(), int(NavigationStateMachine::NoAction));
+    QCOMPARE(machine.timeout(), int(NavigationStateMachine::NoAction));
+    QCOMPARE(machine.state(), NavigationStateMachine::Idle);
+}
+
+QTEST_APPLESS_MAIN(TestNavigationStateMachine)
+
+#include "tst_navigationstatemachine.moc"
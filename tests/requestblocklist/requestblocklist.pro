@@ -0,0 +1,17 @@
+QT      *= core testlib
+QT      -= gui
+
+TEMPLATE = app
+TARGET   = tst_requestblocklist
+CONFIG  += C++11 console testcase
+CONFIG  -= app_bundle
+
+INCLUDEPATH += $$PWD/../..
+
+SOURCES += tst_requestblocklist.cpp \
+    $$PWD/../../navigationpolicy.cpp \
+    $$PWD/../../requestblocklist.cpp
+
+HEADERS += \
+    $$PWD/../../navigationpolicy.h \
+    $$PWD/../../requestblocklist.h
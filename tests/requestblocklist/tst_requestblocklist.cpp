@@ -0,0 +1,182 @@
+#include <QtTest>
+
+#include <QBuffer>
+#include <QTemporaryFile>
+
+#include "requestblocklist.h"
+
+// Compiles text rules, maps the result and looks URLs up in it.
+class TestRequestBlocklist : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void compileSkipsMalformedRules();
+    void isBlocked_data();
+    void isBlocked();
+    void bloomFilter();
+    void openMissingFile();
+    void openMalformedFile_data();
+    void openMalformedFile();
+    void reopen();
+
+private:
+    QTemporaryFile compiled;
+    QByteArray compiled_data;
+    RequestBlocklist blocklist;
+};
+
+namespace {
+
+static QStringList Rules()
+{
+    return QStringList()
+            << "# host rules"
+            << "example.com"
+            << "Ads.Example.NET"
+            << "example.org/ads/"
+            << "example.org/track"
+            << "||adblock.test^"
+            << "0.0.0.0 hosts.test"
+            << "127.0.0.1 localhost"
+            << "! adblock comment"
+            << ""
+            << "*.wildcard.test"
+            << ".leading.test"
+            << "trailing.test."
+            << "double..dot.test";
+}
+
+} // anonymous
+
+void TestRequestBlocklist::initTestCase()
+{
+    QBuffer buffer(&compiled_data);
+    buffer.open(QIODevice::WriteOnly);
+    QCOMPARE(RequestBlocklist::compile(Rules(), &buffer), 6);
+
+    QVERIFY(compiled.open());
+    QCOMPARE(compiled.write(compiled_data), qint64(compiled_data.size()));
+    compiled.close();
+    QVERIFY(blocklist.open(compiled.fileName()));
+    QVERIFY(blocklist.isOpen());
+}
+
+void TestRequestBlocklist::compileSkipsMalformedRules()
+{
+    // comments, localhost and malformed hosts are not rules
+    QCOMPARE(blocklist.ruleCount(), 6);
+
+    QByteArray data;
+    QBuffer buffer(&data);
+    buffer.open(QIODevice::WriteOnly);
+    QCOMPARE(RequestBlocklist::compile(QStringList() << "# nothing" << "*.a.test" << "a..test", &buffer), 0);
+}
+
+void TestRequestBlocklist::isBlocked_data()
+{
+    QTest::addColumn<QString>("url");
+    QTest::addColumn<bool>("blocked");
+    QTest::newRow("host") << "http://example.com/" << true;
+    QTest::newRow("host without path") << "https://example.com" << true;
+    QTest::newRow("subdomain") << "https://cdn.img.example.com/a.png" << true;
+    QTest::newRow("host case") << "http://WWW.Example.COM/" << true;
+    QTest::newRow("port") << "http://example.com:8080/a.js" << true;
+    QTest::newRow("other host") << "http://example.edu/" << false;
+    QTest::newRow("host suffix") << "http://notexample.com/" << false;
+    QTest::newRow("parent of rule") << "http://example.net/" << false;
+    QTest::newRow("rule folded") << "http://x.ads.example.net/" << true;
+    QTest::newRow("path") << "http://example.org/ads/banner.gif" << true;
+    QTest::newRow("path prefix") << "http://example.org/tracking.js" << true;
+    QTest::newRow("path subdomain") << "http://www.example.org/ads/a" << true;
+    QTest::newRow("other path") << "http://example.org/news/ads/" << false;
+    QTest::newRow("path case") << "http://example.org/ADS/a" << false;
+    QTest::newRow("root path") << "http://example.org/" << false;
+    QTest::newRow("adblock") << "http://adblock.test/x" << true;
+    QTest::newRow("adblock subdomain") << "http://a.adblock.test/" << true;
+    QTest::newRow("hosts file") << "http://hosts.test/" << true;
+    QTest::newRow("hosts file localhost") << "http://localhost/" << false;
+    QTest::newRow("wildcard skipped") << "http://a.wildcard.test/" << false;
+    QTest::newRow("no host") << "about:blank" << false;
+    QTest::newRow("empty") << "" << false;
+}
+
+void TestRequestBlocklist::isBlocked()
+{
+    QFETCH(QString, url);
+    QFETCH(bool, blocked);
+    QCOMPARE(blocklist.isBlocked(url), blocked);
+}
+
+void TestRequestBlocklist::bloomFilter()
+{
+    // no false negatives for the hosts and subdomains of rules
+    QVERIFY(blocklist.mayBlockHost(QString("example.com").midRef(0)));
+    QVERIFY(blocklist.mayBlockHost(QString("a.b.hosts.test").midRef(0)));
+    QVERIFY(!blocklist.mayBlockHost(QStringRef()));
+
+    int passed = 0;
+    for (int i = 0; i < 1000; ++i)
+    {
+        if (blocklist.mayBlockHost(QString("host%1.unlisted.test").arg(i).midRef(0)))
+            ++passed;
+    }
+    QVERIFY2(passed < 50, qPrintable(QString::number(passed)));
+}
+
+void TestRequestBlocklist::openMissingFile()
+{
+    RequestBlocklist missing;
+    QVERIFY(!missing.open(QDir::temp().filePath("nativebrowser-missing.nbbl")));
+    QVERIFY(!missing.isOpen());
+    QCOMPARE(missing.ruleCount(), 0);
+    QVERIFY(!missing.isBlocked("http://example.com/"));
+}
+
+void TestRequestBlocklist::openMalformedFile_data()
+{
+    QTest::addColumn<QByteArray>("data");
+    QTest::newRow("empty") << QByteArray();
+    QTest::newRow("text rules") << QByteArray("example.com\n");
+    QTest::newRow("truncated") << compiled_data.left(compiled_data.size() - 4);
+    QTest::newRow("trailing data") << compiled_data + QByteArray(4, '\0');
+    QByteArray magic = compiled_data;
+    magic[0] = 'X';
+    QTest::newRow("magic") << magic;
+    QByteArray version = compiled_data;
+    version[4] = char(version[4] + 1);
+    QTest::newRow("version") << version;
+}
+
+void TestRequestBlocklist::openMalformedFile()
+{
+    QFETCH(QByteArray, data);
+    QTemporaryFile file;
+    QVERIFY(file.open());
+    file.write(data);
+    file.close();
+
+    RequestBlocklist malformed;
+    QVERIFY(!malformed.open(file.fileName()));
+    QVERIFY(!malformed.isOpen());
+    QVERIFY(!malformed.isBlocked("http://example.com/"));
+}
+
+void TestRequestBlocklist::reopen()
+{
+    // a failed open leaves the list closed, not with the old rules
+    RequestBlocklist list;
+    QVERIFY(list.open(compiled.fileName()));
+    QVERIFY(!list.open(QDir::temp().filePath("nativebrowser-missing.nbbl")));
+    QVERIFY(!list.isBlocked("http://example.com/"));
+    QVERIFY(list.open(compiled.fileName()));
+    QVERIFY(list.isBlocked("http://example.com/"));
+    list.close();
+    QVERIFY(!list.isOpen());
+    QVERIFY(!list.isBlocked("http://example.com/"));
+}
+
+QTEST_APPLESS_MAIN(TestRequestBlocklist)
+
+#include "tst_requestblocklist.moc"
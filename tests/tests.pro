@@ -0,0 +1,7 @@
+TEMPLATE = subdirs
+
+SUBDIRS += \
+    browserfeaturecontrol \
+    navigationhistory \
+    navigationstatemachine \
+    requestblocklist